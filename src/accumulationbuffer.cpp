@@ -0,0 +1,173 @@
+#include <accumulationbuffer.h>
+
+#include <limits>
+
+static GLenum internalFormat(AccumulationBuffer::Format format)
+{
+	switch (format)
+	{
+	case AccumulationBuffer::Format::RGBA16F:
+		return GL_RGBA16F;
+	case AccumulationBuffer::Format::R11G11B10F:
+		return GL_R11F_G11F_B10F;
+	case AccumulationBuffer::Format::RGBA32F:
+	default:
+		return GL_RGBA32F;
+	}
+}
+
+static GLuint createTexture(const glm::uvec2& resolution, GLenum format)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, format, resolution.x, resolution.y);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	return texture;
+}
+
+AccumulationBuffer::AccumulationBuffer(const glm::uvec2& resolution, Format format)
+	: m_front(0), m_resolution(resolution), m_format(format)
+{
+	allocate();
+}
+
+AccumulationBuffer::~AccumulationBuffer()
+{
+	release();
+}
+
+void AccumulationBuffer::allocate()
+{
+	for (Target& target : m_targets)
+	{
+		target.colorTexture = createTexture(m_resolution, internalFormat(m_format));
+		target.sampleCountTexture = createTexture(m_resolution, GL_R32UI);
+		target.momentTexture = createTexture(m_resolution, GL_R32F);
+
+		glGenFramebuffers(1, &target.fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.colorTexture, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, target.sampleCountTexture, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, target.momentTexture, 0);
+
+		GLenum drawBuffers[3] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
+		glDrawBuffers(3, drawBuffers);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	m_errorTexture = createTexture(getErrorResolution(), GL_RG32F);
+
+	m_front = 0;
+	clear();
+}
+
+void AccumulationBuffer::release()
+{
+	for (Target& target : m_targets)
+	{
+		glDeleteFramebuffers(1, &target.fbo);
+		glDeleteTextures(1, &target.colorTexture);
+		glDeleteTextures(1, &target.sampleCountTexture);
+		glDeleteTextures(1, &target.momentTexture);
+	}
+	glDeleteTextures(1, &m_errorTexture);
+}
+
+void AccumulationBuffer::resize(const glm::uvec2& resolution)
+{
+	release();
+	m_resolution = resolution;
+	allocate();
+}
+
+void AccumulationBuffer::setFormat(Format format)
+{
+	if (format == m_format) return;
+
+	release();
+	m_format = format;
+	allocate();
+}
+
+AccumulationBuffer::Format AccumulationBuffer::getFormat() const
+{
+	return m_format;
+}
+
+GLenum AccumulationBuffer::getInternalFormat() const
+{
+	return internalFormat(m_format);
+}
+
+const AccumulationBuffer::Target& AccumulationBuffer::getFront() const
+{
+	return m_targets[m_front];
+}
+
+const AccumulationBuffer::Target& AccumulationBuffer::getBack() const
+{
+	return m_targets[1 - m_front];
+}
+
+GLuint AccumulationBuffer::getErrorTexture() const
+{
+	return m_errorTexture;
+}
+
+glm::uvec2 AccumulationBuffer::getErrorResolution() const
+{
+	return (m_resolution + glm::uvec2(ERROR_TILE_SIZE - 1)) / glm::uvec2(ERROR_TILE_SIZE);
+}
+
+void AccumulationBuffer::swap()
+{
+	m_front = 1 - m_front;
+}
+
+void AccumulationBuffer::clear() const
+{
+	const Target& front = getFront();
+
+	glm::vec4 color = glm::vec4(0.f);
+	glClearTexImage(front.colorTexture, 0, GL_RGBA, GL_FLOAT, &color[0]);
+	uint32_t sampleCount = 0;
+	glClearTexImage(front.sampleCountTexture, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &sampleCount);
+	float moment = 0.f;
+	glClearTexImage(front.momentTexture, 0, GL_RED, GL_FLOAT, &moment);
+
+	clearError();
+}
+
+void AccumulationBuffer::clearError() const
+{
+	glm::vec2 unknownError = glm::vec2(std::numeric_limits<float>::max());
+	glClearTexImage(m_errorTexture, 0, GL_RG, GL_FLOAT, &unknownError[0]);
+}
+
+void AccumulationBuffer::read(std::vector<glm::vec4>& pixels) const
+{
+	const Target& front = getFront();
+	size_t pixelCount = size_t(m_resolution.x) * m_resolution.y;
+
+	// Compute passes write the targets through image stores
+	glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+	pixels.resize(pixelCount);
+	glBindTexture(GL_TEXTURE_2D, front.colorTexture);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, pixels.data());
+
+	std::vector<uint32_t> sampleCounts(pixelCount);
+	glBindTexture(GL_TEXTURE_2D, front.sampleCountTexture);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, sampleCounts.data());
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	for (size_t i = 0; i < pixelCount; ++i)
+	{
+		pixels[i].a = float(sampleCounts[i]);
+	}
+}
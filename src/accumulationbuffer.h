@@ -0,0 +1,75 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <error_handling.h>
+#include <gl/gl.h>
+#include <utils.h>
+
+#include <shaders/pathtracer/error_estimate.h>
+
+#include <vector>
+
+// Ping-pong pair of floating point accumulation targets
+// Each pass reads the running mean and sample count of every pixel from the front target and writes the updated ones to the back target
+class AccumulationBuffer
+{
+public:
+	enum class Format {
+		RGBA32F,
+		RGBA16F,
+		R11G11B10F,
+	};
+
+	struct Target {
+		GLuint fbo;
+		// Running mean of the radiance
+		GLuint colorTexture;
+		// Samples taken by every pixel as R32UI
+		GLuint sampleCountTexture;
+		// Running mean of the squared luminance of the samples as R32F, for estimating their variance
+		GLuint momentTexture;
+	};
+
+private:
+	Target m_targets[2];
+	int m_front;
+
+	// Error of every tile of ERROR_TILE_SIZE^2 pixels as RG32F, written from the front target by the renderer
+	// Red is the mean relative standard error of the tile's pixels, green the sum of their relative MSE
+	GLuint m_errorTexture;
+
+	glm::uvec2 m_resolution;
+	Format m_format;
+
+	void allocate();
+	void release();
+
+public:
+	AccumulationBuffer(const glm::uvec2& resolution, Format format = Format::RGBA32F);
+	~AccumulationBuffer();
+
+	AccumulationBuffer(const AccumulationBuffer&) = delete;
+	AccumulationBuffer& operator=(const AccumulationBuffer&) = delete;
+
+	void resize(const glm::uvec2& resolution);
+	void setFormat(Format format);
+	Format getFormat() const;
+	GLenum getInternalFormat() const;
+
+	// Latest accumulation
+	const Target& getFront() const;
+	// Written by the next pass
+	const Target& getBack() const;
+	GLuint getErrorTexture() const;
+	glm::uvec2 getErrorResolution() const;
+	// Makes the back target the front one once a pass has written it
+	void swap();
+
+	// Discards every sample of the front target, the error of every tile becomes unknown
+	void clear() const;
+	// Forgets the error of every tile, for when the front target changed without a pass
+	void clearError() const;
+
+	// Copies the front target, rows from the bottom, with the sample count of every pixel in alpha
+	void read(std::vector<glm::vec4>& pixels) const;
+};
@@ -0,0 +1,126 @@
+#include <bluenoise.h>
+
+#include <cmath>
+#include <random>
+
+#define TILE_TEXELS (BLUE_NOISE_SIZE * BLUE_NOISE_SIZE)
+
+// Width of the gaussian measuring how clustered the texels are
+#define SIGMA 1.5f
+
+// Energy of every texel due to the set texels around it on the torus
+class EnergyField
+{
+	std::vector<float> m_kernel;
+
+public:
+	std::vector<float> m_energy;
+	std::vector<uint8_t> m_set;
+
+	EnergyField()
+		: m_kernel(TILE_TEXELS), m_energy(TILE_TEXELS, 0.f), m_set(TILE_TEXELS, 0)
+	{
+		for (int y = 0; y < BLUE_NOISE_SIZE; ++y)
+		{
+			for (int x = 0; x < BLUE_NOISE_SIZE; ++x)
+			{
+				int dx = std::min(x, BLUE_NOISE_SIZE - x);
+				int dy = std::min(y, BLUE_NOISE_SIZE - y);
+				m_kernel[y * BLUE_NOISE_SIZE + x] = std::exp(-float(dx * dx + dy * dy) / (2.f * SIGMA * SIGMA));
+			}
+		}
+	}
+
+	void toggle(int texel)
+	{
+		m_set[texel] = !m_set[texel];
+		float sign = m_set[texel] ? 1.f : -1.f;
+
+		// The kernel is centered on texel zero, so each row wraps around in two runs
+		int tx = texel % BLUE_NOISE_SIZE, ty = texel / BLUE_NOISE_SIZE;
+		for (int y = 0; y < BLUE_NOISE_SIZE; ++y)
+		{
+			float* energy = &m_energy[y * BLUE_NOISE_SIZE];
+			const float* kernel = &m_kernel[((y - ty + BLUE_NOISE_SIZE) % BLUE_NOISE_SIZE) * BLUE_NOISE_SIZE];
+			for (int x = 0; x < tx; ++x)
+			{
+				energy[x] += sign * kernel[x - tx + BLUE_NOISE_SIZE];
+			}
+			for (int x = tx; x < BLUE_NOISE_SIZE; ++x)
+			{
+				energy[x] += sign * kernel[x - tx];
+			}
+		}
+	}
+
+	// Set texel with the most energy
+	int tightestCluster() const
+	{
+		int best = -1;
+		for (int i = 0; i < TILE_TEXELS; ++i)
+		{
+			if (m_set[i] && (best < 0 || m_energy[i] > m_energy[best])) best = i;
+		}
+		return best;
+	}
+
+	// Unset texel with the least energy
+	int largestVoid() const
+	{
+		int best = -1;
+		for (int i = 0; i < TILE_TEXELS; ++i)
+		{
+			if (!m_set[i] && (best < 0 || m_energy[i] < m_energy[best])) best = i;
+		}
+		return best;
+	}
+};
+
+std::vector<uint16_t> blueNoiseTile()
+{
+	// Fixed seed, the tile is the same on every run
+	std::mt19937 random(1993);
+
+	// Random initial pattern of a tenth of the texels, relaxed until moving its tightest cluster into its largest void changes nothing
+	EnergyField initial;
+	int initialCount = TILE_TEXELS / 10;
+	for (int count = 0; count < initialCount;)
+	{
+		int texel = int(random() % TILE_TEXELS);
+		if (initial.m_set[texel]) continue;
+
+		initial.toggle(texel);
+		count++;
+	}
+
+	while (true)
+	{
+		int cluster = initial.tightestCluster();
+		initial.toggle(cluster);
+		int gap = initial.largestVoid();
+		initial.toggle(gap);
+		if (gap == cluster) break;
+	}
+
+	std::vector<uint16_t> ranks(TILE_TEXELS);
+
+	// Ranks below the initial pattern, removing its tightest clusters first
+	EnergyField field = initial;
+	for (int rank = initialCount; rank-- > 0;)
+	{
+		int cluster = field.tightestCluster();
+		field.toggle(cluster);
+		ranks[cluster] = uint16_t(rank);
+	}
+
+	// Ranks above, filling the largest voids first
+	field = initial;
+	for (int rank = initialCount; rank < TILE_TEXELS; ++rank)
+	{
+		int gap = field.largestVoid();
+		field.toggle(gap);
+		ranks[gap] = uint16_t(rank);
+	}
+
+	return ranks;
+}
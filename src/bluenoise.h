@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Side of the square blue noise tile, which repeats over the image
+#define BLUE_NOISE_SIZE 64
+// Bits of a rank in the tile, log2(BLUE_NOISE_SIZE * BLUE_NOISE_SIZE)
+#define BLUE_NOISE_RANK_BITS 12
+
+// Void and cluster tile (Ulichney 1993) ranking every texel in [0, BLUE_NOISE_SIZE^2), rows from the bottom
+// Thresholding it at any rank leaves blue noise, so shifting the samples of the pixels by their ranks spreads their error apart
+std::vector<uint16_t> blueNoiseTile();
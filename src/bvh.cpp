@@ -0,0 +1,243 @@
+#include <bvh.h>
+
+#include <algorithm>
+#include <numeric>
+
+// Expands the bounds to contain a point
+void BVH::Bounds::grow(const glm::vec3& point)
+{
+	min = glm::min(min, point);
+	max = glm::max(max, point);
+}
+
+// Expands the bounds to contain another bounding box
+void BVH::Bounds::grow(const Bounds& bounds)
+{
+	min = glm::min(min, bounds.min);
+	max = glm::max(max, bounds.max);
+}
+
+// Gets the half surface area of the bounds, empty bounds have no area
+float BVH::Bounds::area() const
+{
+	glm::vec3 extent = max - min;
+	if (extent.x < 0.f || extent.y < 0.f || extent.z < 0.f) return 0.f;
+
+	return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+}
+
+// Gets the bin a primitive centroid falls into along the split axis
+int BVH::Split::binOf(const glm::vec3& centroid) const
+{
+	return std::min(binCount - 1, int((centroid[axis] - centroidMin) * binScale));
+}
+
+// Builds the hierarchy over primitives with the given bounds
+BVH::BVH(const std::vector<Bounds>& primitiveBounds)
+	: m_primitiveBounds(primitiveBounds)
+{
+	uint32_t primitiveCount = primitiveBounds.size();
+	if (primitiveCount == 0) return;
+
+	m_order.resize(primitiveCount);
+	std::iota(m_order.begin(), m_order.end(), 0);
+
+	m_centroids.resize(primitiveCount);
+	for (uint32_t i = 0; i < primitiveCount; ++i)
+	{
+		m_centroids[i] = (m_primitiveBounds[i].min + m_primitiveBounds[i].max) * 0.5f;
+	}
+
+	// A binary tree with one primitive per leaf has at most 2n - 1 nodes
+	m_nodes.reserve(2 * primitiveCount - 1);
+
+	Node root;
+	root.leftFirst = 0;
+	root.count = primitiveCount;
+	m_nodes.push_back(root);
+
+	updateBounds(0);
+	subdivide(0, 1);
+
+	m_nodes.shrink_to_fit();
+
+	// Release the build data
+	std::vector<Bounds>().swap(m_primitiveBounds);
+	std::vector<glm::vec3>().swap(m_centroids);
+}
+
+// Gets the bounds of a triangle list
+static std::vector<BVH::Bounds> triangleBounds(const std::vector<glm::vec3>& vertices, const std::vector<glm::vec4>& indices)
+{
+	std::vector<BVH::Bounds> bounds(indices.size());
+	for (size_t i = 0; i < indices.size(); ++i)
+	{
+		for (int v = 0; v < 3; ++v)
+		{
+			bounds[i].grow(vertices[int(indices[i][v])]);
+		}
+	}
+
+	return bounds;
+}
+
+// Builds the hierarchy over the triangles [indices] referencing [vertices]
+BVH::BVH(const std::vector<glm::vec3>& vertices, const std::vector<glm::vec4>& indices)
+	: BVH(triangleBounds(vertices, indices))
+{ }
+
+// Gets the bounds of the whole hierarchy
+BVH::Bounds BVH::getBounds() const
+{
+	if (m_nodes.empty()) return Bounds();
+
+	return Bounds { m_nodes[0].min, m_nodes[0].max };
+}
+
+// Gets the number of levels of the hierarchy
+uint32_t BVH::getDepth() const
+{
+	return m_depth;
+}
+
+// Fits the node bounds to the primitives it contains
+void BVH::updateBounds(uint32_t nodeIndex)
+{
+	Node& node = m_nodes[nodeIndex];
+
+	Bounds bounds;
+	for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; ++i)
+	{
+		bounds.grow(m_primitiveBounds[m_order[i]]);
+	}
+
+	node.min = bounds.min;
+	node.max = bounds.max;
+}
+
+// Finds the lowest cost binned SAH split of a node
+BVH::Split BVH::findSplit(const Node& node) const
+{
+	Split best;
+
+	Bounds centroidBounds;
+	for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; ++i)
+	{
+		centroidBounds.grow(m_centroids[m_order[i]]);
+	}
+
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+		if (extent <= 0.f) continue;
+
+		Split split;
+		split.axis = axis;
+		split.centroidMin = centroidBounds.min[axis];
+		split.binScale = binCount / extent;
+
+		// Populate the bins
+		Bounds binBounds[binCount];
+		uint32_t binCounts[binCount] = {};
+		for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; ++i)
+		{
+			uint32_t primitive = m_order[i];
+			int bin = split.binOf(m_centroids[primitive]);
+			binBounds[bin].grow(m_primitiveBounds[primitive]);
+			binCounts[bin]++;
+		}
+
+		// Sweep from both sides to get the area and count left and right of each plane
+		float leftArea[binCount - 1], rightArea[binCount - 1];
+		uint32_t leftCount[binCount - 1], rightCount[binCount - 1];
+		Bounds leftBounds, rightBounds;
+		uint32_t leftSum = 0, rightSum = 0;
+		for (int i = 0; i < binCount - 1; ++i)
+		{
+			leftBounds.grow(binBounds[i]);
+			leftSum += binCounts[i];
+			leftArea[i] = leftBounds.area();
+			leftCount[i] = leftSum;
+
+			rightBounds.grow(binBounds[binCount - 1 - i]);
+			rightSum += binCounts[binCount - 1 - i];
+			rightArea[binCount - 2 - i] = rightBounds.area();
+			rightCount[binCount - 2 - i] = rightSum;
+		}
+
+		for (int i = 0; i < binCount - 1; ++i)
+		{
+			if (leftCount[i] == 0 || rightCount[i] == 0) continue;
+
+			float cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+			if (cost < best.cost)
+			{
+				best = split;
+				best.bin = i + 1;
+				best.cost = cost;
+			}
+		}
+	}
+
+	// Normalize to the expected cost of traversing the node
+	float parentArea = Bounds { node.min, node.max }.area();
+	if (best.axis != -1 && parentArea > 0.f)
+	{
+		best.cost = traversalCost + intersectionCost * best.cost / parentArea;
+	}
+
+	return best;
+}
+
+// Recursively splits a node on level [depth], the root's being 1, while the SAH estimates a split is cheaper than a leaf
+void BVH::subdivide(uint32_t nodeIndex, uint32_t depth)
+{
+	m_depth = std::max(m_depth, depth);
+
+	Node node = m_nodes[nodeIndex];
+	if (node.count <= 1) return;
+
+	Split split = findSplit(node);
+	float leafCost = intersectionCost * node.count;
+
+	if (split.axis == -1 && node.count <= maxLeafSize) return;
+	if (split.cost >= leafCost && node.count <= maxLeafSize) return;
+
+	// Partition the primitives about the split plane
+	uint32_t first = node.leftFirst;
+	uint32_t last = node.leftFirst + node.count;
+	uint32_t middle = first;
+	if (split.axis != -1)
+	{
+		middle = std::partition(m_order.begin() + first, m_order.begin() + last, [&](uint32_t primitive) {
+			return split.binOf(m_centroids[primitive]) < split.bin;
+		}) - m_order.begin();
+	}
+
+	// Coincident centroids, fall back to an even split
+	if (middle == first || middle == last)
+	{
+		middle = first + node.count / 2;
+	}
+
+	uint32_t leftIndex = m_nodes.size();
+
+	Node left;
+	left.leftFirst = first;
+	left.count = middle - first;
+	m_nodes.push_back(left);
+
+	Node right;
+	right.leftFirst = middle;
+	right.count = last - middle;
+	m_nodes.push_back(right);
+
+	m_nodes[nodeIndex].leftFirst = leftIndex;
+	m_nodes[nodeIndex].count = 0;
+
+	updateBounds(leftIndex);
+	updateBounds(leftIndex + 1);
+
+	subdivide(leftIndex, depth + 1);
+	subdivide(leftIndex + 1, depth + 1);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Bounding volume hierarchy over a list of primitives, built with the surface area heuristic
+class BVH
+{
+public:
+	struct Bounds {
+		glm::vec3 min = glm::vec3(std::numeric_limits<float>::infinity());
+		glm::vec3 max = glm::vec3(-std::numeric_limits<float>::infinity());
+
+		void grow(const glm::vec3& point);
+		void grow(const Bounds& bounds);
+		float area() const;
+	};
+
+	// Uploaded as two RGBA32UI texels per node, the shaders reinterpret the bounds as floats
+	struct Node {
+		glm::vec3 min;
+		// Interior nodes: index of the left child, the right child immediately follows it
+		// Leaf nodes: index of the first primitive
+		uint32_t leftFirst;
+
+		glm::vec3 max;
+		// Number of primitives in a leaf, zero for interior nodes
+		uint32_t count;
+
+		bool isLeaf() const { return count > 0; }
+	};
+
+	std::vector<Node> m_nodes;
+
+	// Original index of each primitive, in leaf order
+	std::vector<uint32_t> m_order;
+
+	BVH() {}
+	BVH(const std::vector<Bounds>& primitiveBounds);
+	BVH(const std::vector<glm::vec3>& vertices, const std::vector<glm::vec4>& indices);
+
+	// Permutes the per-primitive data starting at [offset] into leaf order
+	template<typename T>
+	void reorder(std::vector<T>& data, size_t offset = 0) const
+	{
+		if (data.size() < offset + m_order.size()) return;
+
+		std::vector<T> ordered;
+		ordered.reserve(m_order.size());
+		for (uint32_t index : m_order)
+		{
+			ordered.push_back(data[offset + index]);
+		}
+		std::copy(ordered.begin(), ordered.end(), data.begin() + offset);
+	}
+
+	Bounds getBounds() const;
+	// Levels from the root to the deepest leaf, traversal keeps at most this many nodes on its stack
+	uint32_t getDepth() const;
+
+private:
+	// Candidate split along one axis, primitives with a centroid bin below [bin] go left
+	struct Split {
+		int axis = -1;
+		int bin;
+		float centroidMin;
+		float binScale;
+		float cost = std::numeric_limits<float>::infinity();
+
+		int binOf(const glm::vec3& centroid) const;
+	};
+
+	static constexpr int binCount = 16;
+	static constexpr uint32_t maxLeafSize = 8;
+	static constexpr float traversalCost = 1.f;
+	static constexpr float intersectionCost = 1.f;
+
+	std::vector<Bounds> m_primitiveBounds;
+	std::vector<glm::vec3> m_centroids;
+	uint32_t m_depth = 0;
+
+	void updateBounds(uint32_t nodeIndex);
+	void subdivide(uint32_t nodeIndex, uint32_t depth);
+	Split findSplit(const Node& node) const;
+};
@@ -0,0 +1,1344 @@
+#include <cpupathtracer.h>
+#include <shaders/pathtracer/traversal.h>
+#include <shaders/pathtracer/error_estimate.h>
+
+#include <cmath>
+#include <limits>
+
+// Functions mirror their namesakes in the path tracing shaders, see scene.glsl, sampling.glsl, bxdf.glsl and lights.glsl
+
+#define PI     3.14159265358979323f
+#define INV_PI 0.31830988618379067f
+
+// Object types
+#define GEOMETRY 0
+#define LIGHT 1
+
+// Lobes
+#define LOBE_METALLIC   0
+#define LOBE_DIELECTRIC 1
+#define LOBE_DIFFUSE    2
+
+// Microfacet lobes smoother than this are treated as mirrors
+#define SPECULAR_ALPHA 0.001f
+
+// Lights subtending less are sampled by area
+#define MIN_SPHERICAL_SOLID_ANGLE 3e-4f
+
+static const float infinity = std::numeric_limits<float>::infinity();
+
+// Coordinate system transformations
+
+static void coordinateSystem(const glm::vec3& v1, glm::vec3& v2, glm::vec3& v3)
+{
+	if (std::abs(v1.x) > std::abs(v1.y))
+	{
+		v2 = glm::vec3(-v1.z, 0.f, v1.x) / std::sqrt(v1.x * v1.x + v1.z * v1.z);
+	}
+	else
+	{
+		v2 = glm::vec3(0.f, v1.z, -v1.y) / std::sqrt(v1.y * v1.y + v1.z * v1.z);
+	}
+	v3 = glm::cross(v1, v2);
+}
+
+static glm::mat3 localToWorld(const glm::vec3& normal)
+{
+	glm::vec3 tangent, bitangent;
+	coordinateSystem(normal, tangent, bitangent);
+	return glm::mat3(tangent, bitangent, normal);
+}
+
+static glm::mat3 localToWorld(const glm::vec3& normal, glm::vec3 tangent)
+{
+	glm::vec3 bitangent = glm::cross(normal, tangent);
+	// Any frame will do for a tangent along the normal
+	if (glm::dot(bitangent, bitangent) < 1e-12f) return localToWorld(normal);
+
+	bitangent = glm::normalize(bitangent);
+	tangent = glm::cross(bitangent, normal);
+	return glm::mat3(tangent, bitangent, normal);
+}
+
+static glm::mat3 worldToLocal(const glm::vec3& normal, const glm::vec3& tangent)
+{
+	return glm::transpose(localToWorld(normal, tangent));
+}
+
+static glm::mat3 worldToLocal(const glm::vec3& normal)
+{
+	return glm::transpose(localToWorld(normal));
+}
+
+// Local space trigonometry functions
+
+static float cosTheta(const glm::vec3& v)
+{
+	return v.z;
+}
+
+static float cos2Theta(const glm::vec3& v)
+{
+	return v.z * v.z;
+}
+
+static float sin2Theta(const glm::vec3& v)
+{
+	return std::max(0.f, 1.f - cos2Theta(v));
+}
+
+static float sinTheta(const glm::vec3& v)
+{
+	return std::sqrt(sin2Theta(v));
+}
+
+static float tan2Theta(const glm::vec3& v)
+{
+	return sin2Theta(v) / cos2Theta(v);
+}
+
+static float cosPhi(const glm::vec3& v)
+{
+	float sinTheta = ::sinTheta(v);
+	return (sinTheta == 0.f) ? 1.f : glm::clamp(v.x / sinTheta, -1.f, 1.f);
+}
+
+static float sinPhi(const glm::vec3& v)
+{
+	float sinTheta = ::sinTheta(v);
+	return (sinTheta == 0.f) ? 0.f : glm::clamp(v.y / sinTheta, -1.f, 1.f);
+}
+
+static float cos2Phi(const glm::vec3& v)
+{
+	float cosPhi = ::cosPhi(v);
+	return cosPhi * cosPhi;
+}
+
+static float sin2Phi(const glm::vec3& v)
+{
+	float sinPhi = ::sinPhi(v);
+	return sinPhi * sinPhi;
+}
+
+// Sampling functions
+
+static glm::vec3 squareToDiskConcentric(const glm::vec2& xi)
+{
+	glm::vec2 uv = xi * 2.f - glm::vec2(1.f);
+	float x2 = uv.x * uv.x;
+	float y2 = uv.y * uv.y;
+
+	glm::vec2 polar = glm::vec2(0.f);
+	if (x2 > y2)
+	{
+		polar = glm::vec2(uv.x, (PI / 4.f) * uv.y / uv.x);
+	}
+	else if (x2 <= y2 && y2 > 0.f)
+	{
+		polar = glm::vec2(uv.y, (PI / 2.f) - (PI / 4.f) * uv.x / uv.y);
+	}
+
+	return glm::vec3(std::cos(polar.y) * polar.x, std::sin(polar.y) * polar.x, 0.f);
+}
+
+static glm::vec2 squareToUniformDiskPolar(const glm::vec2& xi)
+{
+	float r = std::sqrt(xi.x);
+	float theta = 2.f * PI * xi.y;
+	return glm::vec2(r * std::cos(theta), r * std::sin(theta));
+}
+
+static glm::vec3 squareToHemisphereCosine(const glm::vec2& xi)
+{
+	glm::vec3 hemisphereSample = squareToDiskConcentric(xi);
+	hemisphereSample.z = std::sqrt(std::max(0.f, 1.f - hemisphereSample.x * hemisphereSample.x - hemisphereSample.y * hemisphereSample.y));
+	return hemisphereSample;
+}
+
+// Utility functions
+
+// Owen scrambled Sobol sampler, the same sequence as sample1D() and sample2D() in sampling.glsl
+
+static uint32_t hash(uint32_t x)
+{
+	uint32_t state = x * 747796405u + 2891336453u;
+	uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+static uint32_t hashCombine(uint32_t seed, uint32_t value)
+{
+	return seed ^ (value + 0x9e3779b9u + (seed << 6u) + (seed >> 2u));
+}
+
+static uint32_t reverseBits(uint32_t x)
+{
+	x = (x << 16u) | (x >> 16u);
+	x = ((x & 0x00ff00ffu) << 8u) | ((x & 0xff00ff00u) >> 8u);
+	x = ((x & 0x0f0f0f0fu) << 4u) | ((x & 0xf0f0f0f0u) >> 4u);
+	x = ((x & 0x33333333u) << 2u) | ((x & 0xccccccccu) >> 2u);
+	x = ((x & 0x55555555u) << 1u) | ((x & 0xaaaaaaaau) >> 1u);
+	return x;
+}
+
+static uint32_t nestedUniformScramble(uint32_t x, uint32_t seed)
+{
+	x = reverseBits(x);
+	x += seed;
+	x ^= x * 0x6c50b47cu;
+	x ^= x * 0xb82f1e52u;
+	x ^= x * 0xc7afe638u;
+	x ^= x * 0x8d22f6e6u;
+	return reverseBits(x);
+}
+
+// Point [index] of the first two Sobol dimensions in closed form, see sobol() in sampling.glsl
+static uint32_t sobol(uint32_t index, int dimension)
+{
+	if (dimension == 1)
+	{
+		index ^= (index >> 1u) & 0x55555555u;
+		index ^= (index >> 2u) & 0x33333333u;
+		index ^= (index >> 4u) & 0x0f0f0f0fu;
+		index ^= (index >> 8u) & 0x00ff00ffu;
+		index ^= (index >> 16u) & 0x0000ffffu;
+	}
+	return reverseBits(index);
+}
+
+// [blueNoise] is the blueNoiseTile() in blue noise mode, null otherwise
+static CPUPathTracer::Sampler startSampler(const glm::uvec2& pixel, uint32_t sampleIndex, const uint16_t* blueNoise)
+{
+	return CPUPathTracer::Sampler { blueNoise ? 0 : hash(pixel.x ^ hash(pixel.y)), sampleIndex, 0, pixel, blueNoise };
+}
+
+// Same as blueNoiseOffset() in sampling.glsl
+static uint32_t blueNoiseOffset(const CPUPathTracer::Sampler& sampler, uint32_t component)
+{
+	if (!sampler.blueNoise) return 0;
+
+	uint32_t shift = hash(2u * sampler.dimension + component);
+	glm::uvec2 texel = (sampler.pixel + glm::uvec2(shift, shift >> 16u)) % uint32_t(BLUE_NOISE_SIZE);
+	return uint32_t(sampler.blueNoise[texel.y * BLUE_NOISE_SIZE + texel.x]) << (32 - BLUE_NOISE_RANK_BITS);
+}
+
+static uint32_t nextDimension(CPUPathTracer::Sampler& sampler, uint32_t& index)
+{
+	uint32_t seed = hashCombine(sampler.seed, hash(sampler.dimension++));
+	index = nestedUniformScramble(sampler.index, seed);
+	return seed;
+}
+
+static float toUnitFloat(uint32_t x)
+{
+	return float(x >> 8) * (1.f / 16777216.f);
+}
+
+static float sample1D(CPUPathTracer::Sampler& sampler)
+{
+	uint32_t offset = blueNoiseOffset(sampler, 0);
+	uint32_t index;
+	uint32_t seed = nextDimension(sampler, index);
+	return toUnitFloat(nestedUniformScramble(sobol(index, 0), hashCombine(seed, 0u)) + offset);
+}
+
+static glm::vec2 sample2D(CPUPathTracer::Sampler& sampler)
+{
+	glm::uvec2 offset(blueNoiseOffset(sampler, 0), blueNoiseOffset(sampler, 1));
+	uint32_t index;
+	uint32_t seed = nextDimension(sampler, index);
+	return glm::vec2(toUnitFloat(nestedUniformScramble(sobol(index, 0), hashCombine(seed, 0u)) + offset.x),
+	                 toUnitFloat(nestedUniformScramble(sobol(index, 1), hashCombine(seed, 1u)) + offset.y));
+}
+
+// Same as russianRoulette() in sampling.glsl
+static bool russianRoulette(glm::vec3& throughput, CPUPathTracer::Sampler& sampler)
+{
+	float survival = std::min(1.f, std::max(throughput.r, std::max(throughput.g, throughput.b)));
+	if (sample1D(sampler) >= survival) return false;
+
+	throughput /= survival;
+	return true;
+}
+
+// Same as luminance() in adaptive.glsl
+static float luminance(const glm::vec3& color)
+{
+	return glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+}
+
+static glm::mat3 axisAngle(const glm::vec3& axis, float radians)
+{
+	float s = std::sin(radians);
+	float c = std::cos(radians);
+	float oc = 1.f - c;
+
+	return glm::mat3(
+		oc * axis.x * axis.x + c,          oc * axis.x * axis.y - axis.z * s, oc * axis.z * axis.x + axis.y * s,
+		oc * axis.x * axis.y + axis.z * s, oc * axis.y * axis.y + c,          oc * axis.y * axis.z - axis.x * s,
+		oc * axis.z * axis.x - axis.y * s, oc * axis.y * axis.z + axis.x * s, oc * axis.z * axis.z + c
+		);
+}
+
+// Intersection functions
+
+static bool rectangleIntersect(CPUPathTracer::Ray ray, const glm::mat4& inverseTransform, float& t)
+{
+	float halfLength = 0.5f;
+
+	ray.origin = glm::vec3(inverseTransform * glm::vec4(ray.origin, 1.f));
+	ray.direction = glm::vec3(inverseTransform * glm::vec4(ray.direction, 0.f));
+	float dt = -ray.direction.z;
+
+	// One-sided rectangles only
+	if (dt < 0.f) return false;
+	t = ray.origin.z / dt;
+	if (t < 0.f) return false;
+
+	glm::vec3 p = ray.origin + ray.direction * t;
+
+	return (std::abs(p.x) <= halfLength && std::abs(p.y) <= halfLength);
+}
+
+// Returns the entry distance into the box, or infinity on a miss
+static float boxIntersect(const CPUPathTracer::Ray& ray, const glm::vec3& invDirection, const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+	glm::vec3 t0 = (boxMin - ray.origin) * invDirection;
+	glm::vec3 t1 = (boxMax - ray.origin) * invDirection;
+
+	glm::vec3 tNear = glm::min(t0, t1);
+	glm::vec3 tFar = glm::max(t0, t1);
+
+	float tEnter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.f));
+	float tExit = std::min(std::min(tFar.x, tFar.y), tFar.z);
+
+	return (tEnter <= tExit) ? tEnter : infinity;
+}
+
+// Two-sided Moller-Trumbore test against a precomputed triangle record
+static bool triangleIntersect(const CPUPathTracer::Ray& ray, const Scene::TriangleRecord& triangle, float& t, glm::vec2& barycentric)
+{
+	glm::vec3 p = glm::cross(ray.direction, triangle.edge2);
+	float determinant = glm::dot(triangle.edge1, p);
+	if (determinant == 0.f) return false;
+	float invDeterminant = 1.f / determinant;
+
+	glm::vec3 s = ray.origin - triangle.v0;
+	barycentric.x = glm::dot(s, p) * invDeterminant;
+	if (barycentric.x < 0.f || barycentric.x > 1.f) return false;
+
+	glm::vec3 q = glm::cross(s, triangle.edge1);
+	barycentric.y = glm::dot(ray.direction, q) * invDeterminant;
+	if (barycentric.y < 0.f || barycentric.x + barycentric.y > 1.f) return false;
+
+	t = glm::dot(triangle.edge2, q) * invDeterminant;
+	return t >= 0.f;
+}
+
+// Avoids 0 * inf in the slab test for axis aligned rays
+static glm::vec3 safeInverse(const glm::vec3& direction)
+{
+	glm::vec3 safeDirection = direction;
+	for (int i = 0; i < 3; ++i)
+	{
+		if (std::abs(safeDirection[i]) < 1e-20f) safeDirection[i] = 1e-20f;
+	}
+
+	return 1.f / safeDirection;
+}
+
+// Fresnel equations
+
+static float schlickFresnel(float R0, float cosTheta)
+{
+	return R0 + (1.f - R0) * std::pow(std::max(0.f, 1.f - cosTheta), 5.f);
+}
+
+static float schlickFresnel(float cosTheta)
+{
+	return schlickFresnel(0.05f, cosTheta);
+}
+
+static glm::vec3 schlickFresnel(const glm::vec3& R0, float cosTheta)
+{
+	return R0 + (glm::vec3(1.f) - R0) * std::pow(std::max(0.f, 1.f - cosTheta), 5.f);
+}
+
+// Transmission helper functions
+
+static bool refract(const glm::vec3& inDir, glm::vec3 normal, float eta, float& relativeEta, glm::vec3& outDir)
+{
+	float cosThetaIn = glm::dot(normal, inDir);
+
+	// Flip the orientation if backwards
+	if (cosThetaIn < 0.f)
+	{
+		eta = 1.f / eta;
+		cosThetaIn = -cosThetaIn;
+		normal = -normal;
+	}
+
+	// Find the transmitted direction according to Snell's law
+	float sin2ThetaIn = 1.f - cosThetaIn * cosThetaIn;
+	float sin2ThetaTran = sin2ThetaIn / (eta * eta);
+
+	// Handle total internal reflection
+	if (sin2ThetaTran >= 1.f)
+	{
+		return false;
+	}
+
+	float cosThetaTran = std::sqrt(1.f - sin2ThetaTran);
+
+	outDir = -inDir / eta + (cosThetaIn / eta - cosThetaTran) * normal;
+	relativeEta = eta;
+
+	return true;
+}
+
+// Microfacet helper functions
+
+static float isotropicRoughness2(const glm::vec3& v, const glm::vec2& alpha)
+{
+	return
+		alpha.x * alpha.x * cos2Phi(v)
+		+ alpha.y * alpha.y * sin2Phi(v);
+}
+
+static float trowbridgeReitzDistribution(const glm::vec3& localMicroNormal, const glm::vec2& alpha)
+{
+	float tan2Theta = ::tan2Theta(localMicroNormal);
+	if (std::isinf(tan2Theta)) return 0.f;
+
+	float cos2Theta = ::cos2Theta(localMicroNormal);
+	float cos4Theta = cos2Theta * cos2Theta;
+	float e =
+		(
+		  cos2Phi(localMicroNormal) / (alpha.x * alpha.x)
+		  + sin2Phi(localMicroNormal) / (alpha.y * alpha.y)
+		) * tan2Theta;
+
+	return 1.f / (PI * alpha.x * alpha.y * cos4Theta * (1.f + e) * (1.f + e));
+}
+
+static float trowbridgeReitzLambda(const glm::vec3& v, const glm::vec2& alpha)
+{
+	float tan2Theta = ::tan2Theta(v);
+	if (std::isinf(tan2Theta)) return 0.f;
+
+	return (std::sqrt(1.f + isotropicRoughness2(v, alpha) * tan2Theta) - 1.f) * 0.5f;
+}
+
+static float trowbridgeReitzMasking(const glm::vec3& localOutDir, const glm::vec3& localInDir, const glm::vec2& alpha)
+{
+	return 1.f / (1.f + trowbridgeReitzLambda(localOutDir, alpha) + trowbridgeReitzLambda(localInDir, alpha));
+}
+
+static glm::vec3 trowbridgeReitzSampleNormal(const glm::vec3& localOutDir, const glm::vec2& xi, const glm::vec2& alpha)
+{
+	glm::vec3 hemisphereOutDir = glm::normalize(glm::vec3(alpha.x * localOutDir.x, alpha.y * localOutDir.y, localOutDir.z));
+	if (hemisphereOutDir.z < 0.f) hemisphereOutDir = -hemisphereOutDir;
+
+	glm::vec3 T1 = (hemisphereOutDir.z < 0.99999f) ? glm::normalize(glm::cross(glm::vec3(0.f, 0.f, 1.f), hemisphereOutDir)) : glm::vec3(1.f, 0.f, 0.f);
+	glm::vec3 T2 = glm::cross(hemisphereOutDir, T1);
+
+	glm::vec2 p = squareToUniformDiskPolar(xi);
+
+	float h = std::sqrt(1.f - p.x * p.x);
+	p.y = glm::mix((1.f - hemisphereOutDir.z) / 2.f, h, p.y);
+
+	float pz = std::sqrt(std::max(0.f, 1.f - glm::dot(p, p)));
+
+	glm::vec3 hemisphereNormal = p.x * T1 + p.y * T2 + pz * hemisphereOutDir;
+	return glm::normalize(glm::vec3(alpha.x * hemisphereNormal.x, alpha.y * hemisphereNormal.y, std::max(0.000001f, hemisphereNormal.z)));
+}
+
+static float trowbridgeReitzPdf(const glm::vec3& localOutDir, const glm::vec3& localMicroNormal, const glm::vec2& alpha)
+{
+	float G1 = 1.f / (1.f + trowbridgeReitzLambda(localOutDir, alpha));
+
+	return G1 * trowbridgeReitzDistribution(localMicroNormal, alpha) * std::abs(glm::dot(localOutDir, localMicroNormal)) / std::abs(cosTheta(localOutDir));
+}
+
+static float hemisphereCosinePDF(const glm::vec3& hemisphereSample)
+{
+	return hemisphereSample.z * INV_PI;
+}
+
+// Attenuation functions
+
+static glm::vec3 microfacetAttenuation(const CPUPathTracer::Material& material, const glm::vec3& localOutDir, const glm::vec3& localInDir, const glm::vec2& alpha)
+{
+	float cosThetaOut = std::abs(cosTheta(localOutDir));
+	float cosThetaIn = std::abs(cosTheta(localInDir));
+	glm::vec3 localMicroNormal = localOutDir + localInDir;
+
+	if (cosThetaIn <= 0.f || cosThetaOut <= 0.f) return glm::vec3(0.f);
+	if (localMicroNormal.x == 0.f && localMicroNormal.y == 0.f && localMicroNormal.z == 0.f) return glm::vec3(0.f);
+	localMicroNormal = glm::normalize(localMicroNormal);
+
+	glm::vec3 fresnel = schlickFresnel(material.albedo, std::abs(glm::dot(localOutDir, localMicroNormal)));
+
+	float distribution = trowbridgeReitzDistribution(localMicroNormal, alpha);
+	float masking = trowbridgeReitzMasking(localOutDir, localInDir, alpha);
+
+	return distribution * masking * fresnel / (4.f * cosThetaIn * cosThetaOut);
+}
+
+// BxDF functions
+
+static glm::vec3 diffuseBxDF(const CPUPathTracer::Intersection& intersection, const CPUPathTracer::Material& material, const glm::vec2& xi, const glm::vec3& outDir, glm::vec3& inDir, float& pdf)
+{
+	glm::vec3 normal = intersection.normal;
+	if (glm::dot(normal, outDir) < 0.f)
+	{
+		normal *= -1.f;
+	}
+
+	// Find the entrance direction
+	glm::vec3 localInDir = squareToHemisphereCosine(xi);
+	inDir = localToWorld(normal) * localInDir;
+
+	// Compute the PDF
+	pdf = hemisphereCosinePDF(localInDir);
+
+	return material.albedo * INV_PI;
+}
+
+static glm::vec3 dielectricBxDF(const CPUPathTracer::Intersection& intersection, const CPUPathTracer::Material& material, const glm::vec2& xi, const glm::vec3& outDir, glm::vec3& inDir, float& pdf, CPUPathTracer::Sampler& sampler)
+{
+	glm::vec2 roughness = glm::vec2(material.roughness);
+
+	// Find the microfacet normal
+	glm::vec3 localOutDir = worldToLocal(intersection.normal) * outDir;
+	if (localOutDir.z == 0.f) return glm::vec3(0.f);
+	glm::vec3 localMicroNormal = trowbridgeReitzSampleNormal(localOutDir, xi, roughness);
+
+	float reflectance = schlickFresnel(std::abs(glm::dot(localOutDir, localMicroNormal)));
+	float transmittance = 1.f - reflectance;
+
+	float reflectProb = reflectance;
+	float transmitProb = transmittance * material.transmission;
+	float diffuseProb = transmittance * (1.f - material.transmission);
+
+	// If exiting the surface, only allow transmission
+	if (localOutDir.z < 0.f)
+	{
+		transmitProb = transmittance;
+		diffuseProb = 0.f;
+	}
+
+	float interactionChoice = sample1D(sampler);
+	if (interactionChoice <= reflectProb)
+	{
+		// SPECULAR
+
+		// Find the entrance direction
+		glm::vec3 localInDir = glm::reflect(-localOutDir, localMicroNormal);
+		if (localInDir.z * localOutDir.z <= 0.f) return glm::vec3(0.f);
+
+		inDir = localToWorld(intersection.normal) * localInDir;
+
+		// PDF
+		pdf = trowbridgeReitzPdf(localOutDir, localMicroNormal, roughness) / (4.f * glm::dot(localOutDir, localMicroNormal)) * reflectProb;
+
+		float distribution = trowbridgeReitzDistribution(localMicroNormal, roughness);
+		float masking = trowbridgeReitzMasking(localOutDir, localInDir, roughness);
+
+		return glm::vec3(distribution * masking * reflectance / (4.f * cosTheta(localInDir) * cosTheta(localOutDir)));
+	}
+	else if (interactionChoice <= reflectProb + transmitProb)
+	{
+		// TRANSMITTANCE
+
+		// Find the entrance direction
+		float relativeEta;
+		glm::vec3 localInDir;
+		bool totalInternalReflection = !refract(localOutDir, localMicroNormal, material.ior, relativeEta, localInDir);
+
+		if (totalInternalReflection || localOutDir.z * localInDir.z > 0.f || localInDir.z == 0.f) return glm::vec3(0.f);
+
+		inDir = localToWorld(intersection.normal) * localInDir;
+
+		// PDF
+		float detDenom = glm::dot(localInDir, localMicroNormal) + glm::dot(localOutDir, localMicroNormal) / relativeEta;
+		float detMicro_detIn = std::abs(glm::dot(localInDir, localMicroNormal)) / (detDenom * detDenom);
+		pdf = trowbridgeReitzPdf(localOutDir, localMicroNormal, roughness) * detMicro_detIn * transmitProb;
+
+		float distribution = trowbridgeReitzDistribution(localMicroNormal, roughness);
+		float masking = trowbridgeReitzMasking(localOutDir, localInDir, roughness);
+
+		return material.albedo *
+			(distribution * masking * transmittance * glm::dot(localInDir, localMicroNormal) * glm::dot(localOutDir, localMicroNormal) /
+			(cosTheta(localInDir) * cosTheta(localOutDir) * detDenom * detDenom));
+	}
+	else
+	{
+		// DIFFUSE
+
+		glm::vec3 diffuseOut = diffuseBxDF(intersection, material, xi, outDir, inDir, pdf);
+		pdf *= diffuseProb;
+		return diffuseOut;
+	}
+}
+
+static glm::vec3 microFacetBxDF(const CPUPathTracer::Intersection& intersection, const CPUPathTracer::Material& material, const glm::vec2& xi, const glm::vec3& outDir, glm::vec3& inDir, float& pdf)
+{
+	float angle = 0.f;
+	glm::mat3 anisoRotation = axisAngle(glm::vec3(0.f, 0.f, 1.f), angle * PI / 180.f);
+	glm::mat3 anisoRotationInv = glm::transpose(anisoRotation);
+
+	glm::vec3 normal = intersection.normal;
+	if (glm::dot(normal, outDir) < 0.f)
+	{
+		normal *= -1.f;
+	}
+
+	glm::vec2 alpha = material.alpha;
+
+	// Find the entrance direction
+	glm::vec3 localOutDir = worldToLocal(normal, glm::vec3(0.f, 0.f, 1.f)) * outDir;
+
+	if (localOutDir.z == 0.f) return glm::vec3(0.f);
+
+	localOutDir = anisoRotation * localOutDir;
+
+	glm::vec3 localMicroNormal = trowbridgeReitzSampleNormal(localOutDir, xi, alpha);
+	glm::vec3 localInDir = glm::reflect(-localOutDir, localMicroNormal);
+
+	if (localInDir.z * localOutDir.z <= 0.f) return glm::vec3(0.f);
+
+	inDir = localToWorld(normal, glm::vec3(0.f, 0.f, 1.f)) * anisoRotationInv * localInDir;
+
+	// Compute the PDF
+	pdf = trowbridgeReitzPdf(localOutDir, localMicroNormal, alpha) / (4.f * glm::dot(localOutDir, localMicroNormal));
+	return microfacetAttenuation(material, localOutDir, localInDir, alpha);
+}
+
+// BxDF evaluation functions
+
+static glm::vec3 diffuseEval(const CPUPathTracer::Intersection& intersection, const CPUPathTracer::Material& material, const glm::vec3& outDir, const glm::vec3& inDir, float& pdf)
+{
+	pdf = 0.f;
+	glm::vec3 normal = intersection.normal;
+	if (glm::dot(normal, outDir) < 0.f)
+	{
+		normal *= -1.f;
+	}
+
+	float cosThetaIn = glm::dot(normal, inDir);
+	if (cosThetaIn <= 0.f) return glm::vec3(0.f);
+
+	pdf = cosThetaIn * INV_PI;
+	return material.albedo * INV_PI;
+}
+
+static glm::vec3 dielectricEval(const CPUPathTracer::Intersection& intersection, const CPUPathTracer::Material& material, const glm::vec3& outDir, const glm::vec3& inDir, float& pdf)
+{
+	pdf = 0.f;
+	glm::vec2 roughness = glm::max(glm::vec2(material.roughness), glm::vec2(SPECULAR_ALPHA));
+
+	glm::mat3 toLocal = worldToLocal(intersection.normal);
+	glm::vec3 localOutDir = toLocal * outDir;
+	glm::vec3 localInDir = toLocal * inDir;
+	if (localOutDir.z == 0.f || localInDir.z == 0.f) return glm::vec3(0.f);
+
+	bool exiting = localOutDir.z < 0.f;
+
+	if (localInDir.z * localOutDir.z > 0.f)
+	{
+		glm::vec3 value = glm::vec3(0.f);
+
+		// SPECULAR
+
+		glm::vec3 localMicroNormal = glm::normalize(localOutDir + localInDir);
+		if (localMicroNormal.z < 0.f) localMicroNormal = -localMicroNormal;
+
+		float reflectance = schlickFresnel(std::abs(glm::dot(localOutDir, localMicroNormal)));
+		float reflectPdf = trowbridgeReitzPdf(localOutDir, localMicroNormal, roughness) / (4.f * glm::dot(localOutDir, localMicroNormal)) * reflectance;
+
+		if (reflectPdf > 0.f)
+		{
+			float distribution = trowbridgeReitzDistribution(localMicroNormal, roughness);
+			float masking = trowbridgeReitzMasking(localOutDir, localInDir, roughness);
+
+			pdf += reflectPdf;
+			value += glm::vec3(distribution * masking * reflectance / (4.f * cosTheta(localInDir) * cosTheta(localOutDir)));
+		}
+
+		// DIFFUSE
+
+		if (!exiting && material.transmission < 1.f)
+		{
+			float diffuseProb = (1.f - schlickFresnel(cosTheta(localOutDir))) * (1.f - material.transmission);
+
+			pdf += hemisphereCosinePDF(localInDir) * diffuseProb;
+			value += material.albedo * INV_PI;
+		}
+
+		return value;
+	}
+
+	// TRANSMITTANCE
+
+	float relativeEta = exiting ? 1.f / material.ior : material.ior;
+	glm::vec3 localMicroNormal = glm::normalize(localOutDir + localInDir * relativeEta);
+	if (localMicroNormal.z < 0.f) localMicroNormal = -localMicroNormal;
+	if ((glm::dot(localOutDir, localMicroNormal) < 0.f) != exiting) return glm::vec3(0.f);
+
+	float reflectance = schlickFresnel(std::abs(glm::dot(localOutDir, localMicroNormal)));
+	float transmittance = 1.f - reflectance;
+	float transmitProb = exiting ? transmittance : transmittance * material.transmission;
+	if (transmitProb <= 0.f) return glm::vec3(0.f);
+
+	float detDenom = glm::dot(localInDir, localMicroNormal) + glm::dot(localOutDir, localMicroNormal) / relativeEta;
+	float detMicro_detIn = std::abs(glm::dot(localInDir, localMicroNormal)) / (detDenom * detDenom);
+	pdf = trowbridgeReitzPdf(localOutDir, localMicroNormal, roughness) * detMicro_detIn * transmitProb;
+
+	float distribution = trowbridgeReitzDistribution(localMicroNormal, roughness);
+	float masking = trowbridgeReitzMasking(localOutDir, localInDir, roughness);
+
+	return material.albedo *
+		(distribution * masking * transmittance * glm::dot(localInDir, localMicroNormal) * glm::dot(localOutDir, localMicroNormal) /
+		(cosTheta(localInDir) * cosTheta(localOutDir) * detDenom * detDenom));
+}
+
+static glm::vec3 microFacetEval(const CPUPathTracer::Intersection& intersection, const CPUPathTracer::Material& material, const glm::vec3& outDir, const glm::vec3& inDir, float& pdf)
+{
+	pdf = 0.f;
+	glm::vec3 normal = intersection.normal;
+	if (glm::dot(normal, outDir) < 0.f)
+	{
+		normal *= -1.f;
+	}
+
+	glm::vec2 alpha = glm::max(material.alpha, glm::vec2(SPECULAR_ALPHA));
+
+	glm::mat3 toLocal = worldToLocal(normal, glm::vec3(0.f, 0.f, 1.f));
+	glm::vec3 localOutDir = toLocal * outDir;
+	glm::vec3 localInDir = toLocal * inDir;
+	if (localInDir.z * localOutDir.z <= 0.f) return glm::vec3(0.f);
+
+	glm::vec3 localMicroNormal = glm::normalize(localOutDir + localInDir);
+
+	pdf = trowbridgeReitzPdf(localOutDir, localMicroNormal, alpha) / (4.f * glm::dot(localOutDir, localMicroNormal));
+	return microfacetAttenuation(material, localOutDir, localInDir, alpha);
+}
+
+// Generic BxDF functions
+
+static int chooseLobe(const CPUPathTracer::Material& material, CPUPathTracer::Sampler& sampler)
+{
+	if (material.metallic >= sample1D(sampler)) return LOBE_METALLIC;
+	if ((material.flags & MATERIAL_DIELECTRIC) != 0u) return LOBE_DIELECTRIC;
+	return LOBE_DIFFUSE;
+}
+
+static glm::vec3 sampleLobe(int lobe, const CPUPathTracer::Intersection& intersection, const CPUPathTracer::Material& material, const glm::vec2& xi, const glm::vec3& outDir, glm::vec3& inDir, float& pdf, CPUPathTracer::Sampler& sampler)
+{
+	switch (lobe)
+	{
+	case LOBE_METALLIC:
+		return microFacetBxDF(intersection, material, xi, outDir, inDir, pdf);
+	case LOBE_DIELECTRIC:
+		return dielectricBxDF(intersection, material, xi, outDir, inDir, pdf, sampler);
+	default:
+		return diffuseBxDF(intersection, material, xi, outDir, inDir, pdf);
+	}
+}
+
+static glm::vec3 evaluateLobe(int lobe, const CPUPathTracer::Intersection& intersection, const CPUPathTracer::Material& material, const glm::vec3& outDir, const glm::vec3& inDir, float& pdf)
+{
+	switch (lobe)
+	{
+	case LOBE_METALLIC:
+		return microFacetEval(intersection, material, outDir, inDir, pdf);
+	case LOBE_DIELECTRIC:
+		return dielectricEval(intersection, material, outDir, inDir, pdf);
+	default:
+		return diffuseEval(intersection, material, outDir, inDir, pdf);
+	}
+}
+
+static bool canSampleLights(int lobe, const CPUPathTracer::Material& material)
+{
+	if (lobe == LOBE_METALLIC) return std::max(material.alpha.x, material.alpha.y) >= SPECULAR_ALPHA;
+	if (lobe == LOBE_DIELECTRIC) return material.roughness >= SPECULAR_ALPHA || material.transmission < 1.f;
+	return true;
+}
+
+// Light sampling functions
+
+struct SphericalRectangle {
+	glm::vec3 origin;
+	glm::mat3 frame;
+	// [x0, y0, x1, y1]
+	glm::vec4 bounds;
+	float z0;
+	float b0;
+	float b1;
+	float k;
+	float solidAngle;
+};
+
+static SphericalRectangle sphericalRectangle(const Scene::Light& light, const glm::vec3& origin)
+{
+	SphericalRectangle rect;
+	rect.origin = origin;
+	rect.solidAngle = 0.f;
+
+	glm::vec3 edgeX = glm::vec3(light.transform[0]);
+	glm::vec3 edgeY = glm::vec3(light.transform[1]);
+	float lengthX = glm::length(edgeX);
+	float lengthY = glm::length(edgeY);
+
+	glm::vec3 x = edgeX / lengthX;
+	glm::vec3 y = edgeY / lengthY;
+	glm::vec3 z = glm::cross(x, y);
+
+	glm::vec3 toCorner = glm::vec3(light.transform * glm::vec4(-0.5f, -0.5f, 0.f, 1.f)) - origin;
+	rect.z0 = glm::dot(toCorner, z);
+	if (rect.z0 > 0.f)
+	{
+		z = -z;
+		rect.z0 = -rect.z0;
+	}
+
+	rect.frame = glm::mat3(x, y, z);
+	rect.bounds = glm::vec4(glm::dot(toCorner, x), glm::dot(toCorner, y), 0.f, 0.f);
+	rect.bounds.z = rect.bounds.x + lengthX;
+	rect.bounds.w = rect.bounds.y + lengthY;
+
+	if (rect.z0 == 0.f) return rect;
+
+	glm::vec3 n0 = glm::normalize(glm::vec3(0.f, rect.z0, -rect.bounds.y));
+	glm::vec3 n1 = glm::normalize(glm::vec3(-rect.z0, 0.f, rect.bounds.z));
+	glm::vec3 n2 = glm::normalize(glm::vec3(0.f, -rect.z0, rect.bounds.w));
+	glm::vec3 n3 = glm::normalize(glm::vec3(rect.z0, 0.f, -rect.bounds.x));
+
+	float g0 = std::acos(glm::clamp(-glm::dot(n0, n1), -1.f, 1.f));
+	float g1 = std::acos(glm::clamp(-glm::dot(n1, n2), -1.f, 1.f));
+	float g2 = std::acos(glm::clamp(-glm::dot(n2, n3), -1.f, 1.f));
+	float g3 = std::acos(glm::clamp(-glm::dot(n3, n0), -1.f, 1.f));
+
+	rect.b0 = n0.z;
+	rect.b1 = n2.z;
+	rect.k = 2.f * PI - g2 - g3;
+	rect.solidAngle = std::max(0.f, g0 + g1 - rect.k);
+
+	return rect;
+}
+
+static glm::vec3 sampleSphericalRectangle(const SphericalRectangle& rect, const glm::vec2& xi)
+{
+	float x0 = rect.bounds.x, y0 = rect.bounds.y, x1 = rect.bounds.z, y1 = rect.bounds.w;
+
+	float au = xi.x * rect.solidAngle + rect.k;
+	float fu = (std::cos(au) * rect.b0 - rect.b1) / std::sin(au);
+	float cu = glm::clamp((fu > 0.f ? 1.f : -1.f) / std::sqrt(fu * fu + rect.b0 * rect.b0), -1.f, 1.f);
+	float xu = glm::clamp(-(cu * rect.z0) / std::max(std::sqrt(1.f - cu * cu), 1e-7f), x0, x1);
+
+	float d = std::sqrt(xu * xu + rect.z0 * rect.z0);
+	float h0 = y0 / std::sqrt(d * d + y0 * y0);
+	float h1 = y1 / std::sqrt(d * d + y1 * y1);
+	float hv = glm::mix(h0, h1, xi.y);
+	float hv2 = hv * hv;
+	float yv = hv2 < 1.f - 1e-6f ? hv * d / std::sqrt(1.f - hv2) : y1;
+
+	return rect.origin + rect.frame * glm::vec3(xu, yv, rect.z0);
+}
+
+static float lightPdf(const Scene::Light& light, const SphericalRectangle& rect, float selectionPdf, const glm::vec3& direction, float distance)
+{
+	float cosThetaLight = -glm::dot(glm::vec3(light.normal), direction);
+	if (cosThetaLight <= 0.f) return 0.f;
+
+	if (rect.solidAngle >= MIN_SPHERICAL_SOLID_ANGLE) return selectionPdf / rect.solidAngle;
+
+	return selectionPdf * distance * distance / (light.normal.w * cosThetaLight);
+}
+
+static float powerHeuristic(float pdf, float otherPdf)
+{
+	if (pdf <= 0.f) return 0.f;
+
+	float ratio = otherPdf / pdf;
+	return 1.f / (1.f + ratio * ratio);
+}
+
+CPUPathTracer::CPUPathTracer(const Scene* scene, const Camera* camera, unsigned threadCount)
+	: m_scene(scene), m_camera(camera), m_scheduler(threadCount), m_maxDepth(defaultMaxDepth), m_rouletteDepth(defaultRouletteDepth), m_blueNoise(nullptr)
+{
+	resize(camera->m_resolution);
+}
+
+void CPUPathTracer::resize(const glm::uvec2& resolution)
+{
+	m_resolution = resolution;
+	m_film.assign(resolution.x * resolution.y, glm::vec4(0.f, 0.f, 0.f, 1.f));
+	m_moments.assign(resolution.x * resolution.y, 0.f);
+}
+
+unsigned CPUPathTracer::getThreadCount() const
+{
+	return m_scheduler.getThreadCount();
+}
+
+void CPUPathTracer::setPathDepth(uint32_t maxDepth, uint32_t rouletteDepth)
+{
+	m_maxDepth = std::max(1u, maxDepth);
+	m_rouletteDepth = rouletteDepth;
+}
+
+void CPUPathTracer::setBlueNoise(const std::vector<uint16_t>* tile)
+{
+	m_blueNoise = tile;
+}
+
+CPUPathTracer::Material CPUPathTracer::getMaterial(int index) const
+{
+	const MaterialRecord& record = m_scene->m_materialRecords[index];
+
+	auto unorm = [&](int offset) {
+		return float((record.bits >> offset) & MATERIAL_UNORM_MAX) / float(MATERIAL_UNORM_MAX);
+	};
+
+	Material material;
+	material.albedo = record.albedo;
+	material.roughness = record.roughness;
+	material.alpha = record.alpha;
+	material.metallic = unorm(MATERIAL_METALLIC_OFFSET);
+	material.ior = record.ior;
+	material.transmission = unorm(MATERIAL_TRANSMISSION_OFFSET);
+	material.flags = record.bits >> MATERIAL_FLAGS_OFFSET;
+
+	return material;
+}
+
+CPUPathTracer::Ray CPUPathTracer::raycast(const glm::vec2& pixelCenter, Sampler& sampler) const
+{
+	const float FOVY = 19.5f * PI / 180.f;
+
+	glm::vec2 screenCoords = (pixelCenter + sample2D(sampler)) / glm::vec2(m_resolution);
+	screenCoords = screenCoords * 2.f - glm::vec2(1.f);
+
+	float aspectRatio = float(m_resolution.x) / m_resolution.y;
+	glm::vec3 ref = m_camera->m_eye + m_camera->m_forward;
+	glm::vec3 V = m_camera->m_up * std::tan(FOVY * 0.5f);
+	glm::vec3 H = m_camera->m_right * std::tan(FOVY * 0.5f) * aspectRatio;
+	glm::vec3 p = ref + H * screenCoords.x + V * screenCoords.y;
+
+	return Ray { m_camera->m_eye, glm::normalize(p - m_camera->m_eye) };
+}
+
+// Finds the closest triangle of a mesh, with the ray in the mesh's object space
+// With [anyHit] set, stops at the first triangle closer than intersection.t and returns true
+bool CPUPathTracer::intersectMesh(const Ray& ray, uint32_t rootNode, int instance, bool anyHit, Intersection& intersection) const
+{
+	const std::vector<BVH::Node>& nodes = m_scene->m_blasNodes;
+	glm::vec3 invDirection = safeInverse(ray.direction);
+
+	// Pending nodes and their entry distances
+	uint32_t stack[BVH_STACK_SIZE];
+	float stackT[BVH_STACK_SIZE];
+	int stackSize = 0;
+
+	float tRoot = boxIntersect(ray, invDirection, nodes[rootNode].min, nodes[rootNode].max);
+	if (tRoot < intersection.t)
+	{
+		stack[stackSize] = rootNode;
+		stackT[stackSize++] = tRoot;
+	}
+
+	while (stackSize > 0)
+	{
+		--stackSize;
+		if (stackT[stackSize] > intersection.t) continue;
+
+		const BVH::Node& node = nodes[stack[stackSize]];
+
+		if (node.isLeaf())
+		{
+			for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; ++i)
+			{
+				float sample_t;
+				glm::vec2 barycentric;
+				if (!triangleIntersect(ray, m_scene->m_triangles[i], sample_t, barycentric) || sample_t > intersection.t) continue;
+
+				intersection.t = sample_t;
+				intersection.barycentric = barycentric;
+				intersection.index = i;
+				intersection.instance = instance;
+				intersection.type = GEOMETRY;
+
+				if (anyHit) return true;
+			}
+			continue;
+		}
+
+		// Visit the nearer child first, skipping any child beyond the closest hit
+		uint32_t near = node.leftFirst;
+		uint32_t far = node.leftFirst + 1;
+
+		float tNear = boxIntersect(ray, invDirection, nodes[near].min, nodes[near].max);
+		float tFar = boxIntersect(ray, invDirection, nodes[far].min, nodes[far].max);
+
+		if (tFar < tNear)
+		{
+			std::swap(tNear, tFar);
+			std::swap(near, far);
+		}
+
+		if (tFar < intersection.t && stackSize < BVH_STACK_SIZE)
+		{
+			stack[stackSize] = far;
+			stackT[stackSize++] = tFar;
+		}
+		if (tNear < intersection.t && stackSize < BVH_STACK_SIZE)
+		{
+			stack[stackSize] = near;
+			stackT[stackSize++] = tNear;
+		}
+	}
+
+	return false;
+}
+
+// Finds the closest triangle of any instance, transforming the ray into each instance's object space
+bool CPUPathTracer::intersectInstances(const Ray& ray, bool anyHit, Intersection& intersection) const
+{
+	const std::vector<BVH::Node>& nodes = m_scene->m_tlas.m_nodes;
+	glm::vec3 invDirection = safeInverse(ray.direction);
+
+	uint32_t stack[TLAS_STACK_SIZE];
+	float stackT[TLAS_STACK_SIZE];
+	int stackSize = 0;
+
+	float tRoot = boxIntersect(ray, invDirection, nodes[0].min, nodes[0].max);
+	if (tRoot < intersection.t)
+	{
+		stack[stackSize] = 0;
+		stackT[stackSize++] = tRoot;
+	}
+
+	while (stackSize > 0)
+	{
+		--stackSize;
+		if (stackT[stackSize] > intersection.t) continue;
+
+		const BVH::Node& node = nodes[stack[stackSize]];
+
+		if (node.isLeaf())
+		{
+			for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; ++i)
+			{
+				const Scene::Instance& instance = m_scene->m_instances[i];
+				Ray localRay {
+					glm::vec3(instance.invTransform * glm::vec4(ray.origin, 1.f)),
+					glm::vec3(instance.invTransform * glm::vec4(ray.direction, 0.f))
+				};
+
+				if (intersectMesh(localRay, instance.rootNode, i, anyHit, intersection)) return true;
+			}
+			continue;
+		}
+
+		uint32_t near = node.leftFirst;
+		uint32_t far = node.leftFirst + 1;
+
+		float tNear = boxIntersect(ray, invDirection, nodes[near].min, nodes[near].max);
+		float tFar = boxIntersect(ray, invDirection, nodes[far].min, nodes[far].max);
+
+		if (tFar < tNear)
+		{
+			std::swap(tNear, tFar);
+			std::swap(near, far);
+		}
+
+		if (tFar < intersection.t && stackSize < TLAS_STACK_SIZE)
+		{
+			stack[stackSize] = far;
+			stackT[stackSize++] = tFar;
+		}
+		if (tNear < intersection.t && stackSize < TLAS_STACK_SIZE)
+		{
+			stack[stackSize] = near;
+			stackT[stackSize++] = tNear;
+		}
+	}
+
+	return false;
+}
+
+// Checks for any geometry along the ray closer than [maxDistance]
+bool CPUPathTracer::occluded(const Ray& ray, float maxDistance) const
+{
+	if (m_scene->m_instances.empty()) return false;
+
+	Intersection intersection;
+	intersection.t = maxDistance;
+	intersection.type = -1;
+	intersection.index = -1;
+	intersection.instance = -1;
+
+	return intersectInstances(ray, true, intersection);
+}
+
+bool CPUPathTracer::intersect(const Ray& ray, Intersection& intersection) const
+{
+	intersection.t = infinity;
+	intersection.type = -1;
+	intersection.index = -1;
+	intersection.instance = -1;
+
+	// Geometry
+	if (!m_scene->m_instances.empty())
+	{
+		intersectInstances(ray, false, intersection);
+	}
+
+	for (uint32_t lightIndex = 0; lightIndex < m_scene->m_lightCount[0]; ++lightIndex)
+	{
+		const Scene::Light& areaLight = m_scene->m_lights[lightIndex];
+
+		float sample_t;
+		if (!rectangleIntersect(ray, areaLight.invTransform, sample_t)) continue;
+		if (sample_t < 0.f || sample_t > intersection.t) continue;
+
+		intersection.t = sample_t;
+		intersection.index = lightIndex;
+		intersection.type = LIGHT;
+	}
+
+	if (intersection.index == -1) return false;
+
+	if (intersection.type == GEOMETRY)
+	{
+		int dataInd = int(m_scene->m_indices[intersection.index].w);
+
+		const Scene::Instance& instance = m_scene->m_instances[intersection.instance];
+		glm::vec3 bary = glm::vec3(1.f - intersection.barycentric.x - intersection.barycentric.y, intersection.barycentric);
+
+		glm::vec3 n1 = m_scene->m_vertexData[dataInd * 3 + 0].normal;
+		glm::vec3 n2 = m_scene->m_vertexData[dataInd * 3 + 1].normal;
+		glm::vec3 n3 = m_scene->m_vertexData[dataInd * 3 + 2].normal;
+		glm::vec3 localNormal = bary.x * n1 + bary.y * n2 + bary.z * n3;
+
+		// Normals transform by the inverse transpose
+		intersection.normal = glm::normalize(glm::transpose(glm::mat3(instance.invTransform)) * localNormal);
+		intersection.material = instance.material >= 0 ? instance.material : int(m_scene->m_materialMap[intersection.index]);
+
+		return true;
+	}
+	else if (intersection.type == LIGHT)
+	{
+		const Scene::Light& light = m_scene->m_lights[intersection.index];
+		intersection.normal = glm::vec3(light.normal);
+		intersection.radiance = glm::vec3(light.radiance);
+		return true;
+	}
+
+	return false;
+}
+
+float CPUPathTracer::totalLightPower() const
+{
+	float power = 0.f;
+	for (uint32_t i = 0; i < m_scene->m_lightCount[0]; ++i)
+	{
+		power += m_scene->m_lights[i].radiance.w;
+	}
+
+	return power;
+}
+
+float CPUPathTracer::lightSelectionPdf(int index) const
+{
+	float power = totalLightPower();
+	return power > 0.f ? m_scene->m_lights[index].radiance.w / power : 0.f;
+}
+
+int CPUPathTracer::chooseLight(float xi, float& selectionPdf) const
+{
+	selectionPdf = 0.f;
+	float power = totalLightPower();
+	if (power <= 0.f) return -1;
+
+	float target = xi * power;
+	float cumulative = 0.f;
+	int chosen = -1;
+	for (uint32_t i = 0; i < m_scene->m_lightCount[0]; ++i)
+	{
+		float lightPower = m_scene->m_lights[i].radiance.w;
+		if (lightPower <= 0.f) continue;
+
+		chosen = int(i);
+		cumulative += lightPower;
+		if (target < cumulative) break;
+	}
+
+	selectionPdf = m_scene->m_lights[chosen].radiance.w / power;
+	return chosen;
+}
+
+float CPUPathTracer::lightHitWeight(const Intersection& intersection, const Ray& ray, float bxdfPdf) const
+{
+	if (bxdfPdf <= 0.f) return 1.f;
+
+	const Scene::Light& light = m_scene->m_lights[intersection.index];
+	float pdf = lightPdf(light, sphericalRectangle(light, ray.origin), lightSelectionPdf(intersection.index), ray.direction, intersection.t);
+	return powerHeuristic(bxdfPdf, pdf);
+}
+
+glm::vec3 CPUPathTracer::sampleLight(int lobe, const Intersection& intersection, const Material& material, const glm::vec3& position, const glm::vec3& outDir, Ray& shadowRay, float& maxDistance, Sampler& sampler) const
+{
+	shadowRay = Ray { position, outDir };
+	maxDistance = 0.f;
+
+	float selectionPdf;
+	int index = chooseLight(sample1D(sampler), selectionPdf);
+	glm::vec2 xi = sample2D(sampler);
+	if (index < 0) return glm::vec3(0.f);
+
+	const Scene::Light& light = m_scene->m_lights[index];
+	SphericalRectangle rect = sphericalRectangle(light, position);
+	glm::vec3 lightPoint = rect.solidAngle >= MIN_SPHERICAL_SOLID_ANGLE
+		? sampleSphericalRectangle(rect, xi)
+		: glm::vec3(light.transform * glm::vec4(xi - glm::vec2(0.5f), 0.f, 1.f));
+
+	glm::vec3 toLight = lightPoint - position;
+	float distance = glm::length(toLight);
+	glm::vec3 inDir = toLight / distance;
+
+	float pdf = lightPdf(light, rect, selectionPdf, inDir, distance);
+	if (pdf <= 0.f) return glm::vec3(0.f);
+
+	float bxdfPdf;
+	glm::vec3 bxdf = evaluateLobe(lobe, intersection, material, outDir, inDir, bxdfPdf);
+	if (bxdfPdf <= 0.f) return glm::vec3(0.f);
+
+	shadowRay = Ray { position + inDir * 0.0001f, inDir };
+	maxDistance = distance - 0.0002f;
+
+	return glm::vec3(light.radiance) * bxdf * std::abs(glm::dot(intersection.normal, inDir)) / pdf * powerHeuristic(pdf, bxdfPdf);
+}
+
+// Traces the path of one sample through a pixel, as tracePath() in pathtracer.frag.glsl
+glm::vec3 CPUPathTracer::tracePath(const glm::uvec2& pixel, uint32_t iterationCount) const
+{
+	Sampler sampler = startSampler(pixel, iterationCount, m_blueNoise ? m_blueNoise->data() : nullptr);
+	Ray ray = raycast(glm::vec2(pixel) + glm::vec2(0.5f), sampler);
+
+	Intersection intersection;
+
+	glm::vec3 attenuation = glm::vec3(1.f);
+	glm::vec3 radiance = glm::vec3(0.f);
+	float bxdfPdf = 0.f;
+	for (uint32_t i = 0; i < m_maxDepth; ++i)
+	{
+		if (!intersect(ray, intersection)) break;
+
+		if (intersection.type == LIGHT)
+		{
+			radiance += attenuation * intersection.radiance * lightHitWeight(intersection, ray, bxdfPdf);
+			break;
+		}
+
+		if (i + 1 >= m_maxDepth) break;
+
+		// Samples are drawn in separate statements, operand order is unspecified in C++
+		glm::vec2 xi = sample2D(sampler);
+		Material material = getMaterial(intersection.material);
+		int lobe = chooseLobe(material, sampler);
+
+		glm::vec3 outDir = -ray.direction;
+		glm::vec3 position = ray.origin + ray.direction * intersection.t;
+		glm::vec3 inDir = glm::vec3(0.f);
+		float pdf = 0.f;
+
+		glm::vec3 bxdf = sampleLobe(lobe, intersection, material, xi, outDir, inDir, pdf, sampler);
+
+		bxdfPdf = 0.f;
+		if (canSampleLights(lobe, material))
+		{
+			Ray shadowRay;
+			float maxDistance;
+			glm::vec3 lightRadiance = sampleLight(lobe, intersection, material, position, outDir, shadowRay, maxDistance, sampler);
+			if (maxDistance > 0.f && !occluded(shadowRay, maxDistance))
+			{
+				radiance += attenuation * lightRadiance;
+			}
+
+			if (pdf > 0.f) evaluateLobe(lobe, intersection, material, outDir, inDir, bxdfPdf);
+		}
+
+		if (pdf <= 0.f) break;
+
+		attenuation *= bxdf * std::abs(glm::dot(intersection.normal, inDir));
+		attenuation /= pdf;
+
+		if (i + 1 >= m_rouletteDepth && !russianRoulette(attenuation, sampler)) break;
+
+		ray = Ray { position + inDir * 0.0001f, inDir };
+	}
+
+	return radiance;
+}
+
+void CPUPathTracer::renderTile(uint32_t tile, uint32_t iterationCount, uint32_t samplesPerPass)
+{
+	uint32_t tilesX = (m_resolution.x + tileSize - 1) / tileSize;
+	glm::uvec2 tileMin = glm::uvec2(tile % tilesX, tile / tilesX) * tileSize;
+	glm::uvec2 tileMax = glm::min(tileMin + glm::uvec2(tileSize), m_resolution);
+
+	for (uint32_t y = tileMin.y; y < tileMax.y; ++y)
+	{
+		for (uint32_t x = tileMin.x; x < tileMax.x; ++x)
+		{
+			glm::vec4& pixel = m_film[y * m_resolution.x + x];
+			float& moment = m_moments[y * m_resolution.x + x];
+
+			glm::vec3 accumCol = glm::vec3(pixel);
+			glm::vec3 passCol = glm::vec3(0.f);
+			float passSquares = 0.f;
+			for (uint32_t i = 0; i < samplesPerPass; ++i)
+			{
+				glm::vec3 sampleCol = tracePath(glm::uvec2(x, y), iterationCount + i);
+				passCol += sampleCol;
+				passSquares += luminance(sampleCol) * luminance(sampleCol);
+			}
+			glm::vec3 col = (accumCol * float(iterationCount) + passCol) / float(iterationCount + samplesPerPass);
+
+			pixel = glm::vec4(col, 1.f);
+			moment = (moment * float(iterationCount) + passSquares) / float(iterationCount + samplesPerPass);
+		}
+	}
+}
+
+void CPUPathTracer::trace(uint32_t iterationCount, uint32_t samplesPerPass)
+{
+	glm::uvec2 tiles = (m_resolution + glm::uvec2(tileSize - 1)) / tileSize;
+
+	m_scheduler.run(tiles.x * tiles.y, [&](uint32_t tile) {
+		renderTile(tile, iterationCount, samplesPerPass);
+	});
+}
+
+float CPUPathTracer::estimateNoise(uint32_t sampleCount) const
+{
+	if (sampleCount < 2) return infinity;
+
+	// Same as pixelError() in adaptive.glsl, squared
+	double squaredError = 0.0;
+	float n = float(sampleCount);
+	for (size_t i = 0; i < m_film.size(); ++i)
+	{
+		float lum = luminance(glm::vec3(m_film[i]));
+		float variance = std::max(0.f, m_moments[i] - lum * lum) * n / (n - 1.f);
+		float error = std::sqrt(variance / n) / (lum + ERROR_LUMINANCE_FLOOR);
+		squaredError += error * error;
+	}
+
+	return float(squaredError / m_film.size());
+}
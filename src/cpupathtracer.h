@@ -0,0 +1,119 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <error_handling.h>
+#include <gl/gl.h>
+#include <utils.h>
+
+#include <scene.h>
+#include <camera.h>
+#include <tilescheduler.h>
+#include <bluenoise.h>
+
+#include <vector>
+
+// Reference path tracer running on the CPU, tiles of the image are rendered across all cores
+// Mirrors pathtracer.frag.glsl: the camera model, traversal, BxDFs, light sampling, sample sequence and running mean are the same
+class CPUPathTracer
+{
+public:
+	struct Ray {
+		glm::vec3 origin;
+		glm::vec3 direction;
+	};
+
+	struct Intersection {
+		float t;
+		glm::vec3 normal;
+		glm::vec3 radiance;
+
+		int type;
+		int index;
+		int instance;
+		int material;
+		// Weights of the second and third triangle vertices
+		glm::vec2 barycentric;
+	};
+
+	// Unpacked MaterialRecord
+	struct Material {
+		glm::vec3 albedo;
+		float roughness;
+		glm::vec2 alpha;
+		float metallic;
+		float ior;
+		float transmission;
+		uint32_t flags;
+	};
+
+	// State of the Sobol sampler of one path, as startSampler() in sampling.glsl
+	struct Sampler {
+		uint32_t seed;
+		uint32_t index;
+		uint32_t dimension;
+		glm::uvec2 pixel;
+		// Tile the dimensions take their shifts from, null unless blue noise is enabled
+		const uint16_t* blueNoise;
+	};
+
+	// Segments traced per path at most, and the number after which paths are terminated by Russian roulette
+	static constexpr uint32_t defaultMaxDepth = 32;
+	static constexpr uint32_t defaultRouletteDepth = 3;
+
+	// Running mean of every pixel as RGBA32F, laid out as the accumulation texture with rows from the bottom
+	std::vector<glm::vec4> m_film;
+	// Running mean of the squared luminance of every pixel's samples, laid out as the film
+	std::vector<float> m_moments;
+
+private:
+	static constexpr uint32_t tileSize = 16;
+
+	const Scene* m_scene;
+	const Camera* m_camera;
+	glm::uvec2 m_resolution;
+
+	TileScheduler m_scheduler;
+
+	uint32_t m_maxDepth;
+	uint32_t m_rouletteDepth;
+
+	const std::vector<uint16_t>* m_blueNoise;
+
+	Material getMaterial(int index) const;
+
+	Ray raycast(const glm::vec2& pixelCenter, Sampler& sampler) const;
+
+	bool intersectMesh(const Ray& ray, uint32_t rootNode, int instance, bool anyHit, Intersection& intersection) const;
+	bool intersectInstances(const Ray& ray, bool anyHit, Intersection& intersection) const;
+
+	float totalLightPower() const;
+	float lightSelectionPdf(int index) const;
+	int chooseLight(float xi, float& selectionPdf) const;
+	float lightHitWeight(const Intersection& intersection, const Ray& ray, float bxdfPdf) const;
+	glm::vec3 sampleLight(int lobe, const Intersection& intersection, const Material& material, const glm::vec3& position, const glm::vec3& outDir, Ray& shadowRay, float& maxDistance, Sampler& sampler) const;
+
+	glm::vec3 tracePath(const glm::uvec2& pixel, uint32_t iterationCount) const;
+	void renderTile(uint32_t tile, uint32_t iterationCount, uint32_t samplesPerPass);
+
+public:
+	// Zero threads uses one per hardware thread
+	CPUPathTracer(const Scene* scene, const Camera* camera, unsigned threadCount = 0);
+
+	bool intersect(const Ray& ray, Intersection& intersection) const;
+	bool occluded(const Ray& ray, float maxDistance) const;
+
+	void resize(const glm::uvec2& resolution);
+	unsigned getThreadCount() const;
+
+	void setPathDepth(uint32_t maxDepth, uint32_t rouletteDepth);
+
+	// Shifts the sequence of every pixel by its rank in [tile], a blueNoiseTile() outliving the path tracer, null disables it
+	void setBlueNoise(const std::vector<uint16_t>* tile);
+
+	// Traces [samplesPerPass] samples per pixel starting at sample [iterationCount] and blends them into the film and moments
+	// Every pixel takes every sample, the CPU stays a uniformly sampled reference for adaptive sampling
+	void trace(uint32_t iterationCount, uint32_t samplesPerPass = 1);
+
+	// Relative MSE of the film averaged over the pixels after [sampleCount] samples, as Renderer::estimateNoise()
+	float estimateNoise(uint32_t sampleCount) const;
+};
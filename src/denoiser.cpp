@@ -0,0 +1,152 @@
+#include <denoiser.h>
+
+// Texture units of the filter, after the renderer's
+#define DENOISE_INPUT_TEXTURE  GL_TEXTURE15
+#define ALBEDO_TEXTURE         GL_TEXTURE16
+#define NORMAL_TEXTURE         GL_TEXTURE17
+#define DEPTH_TEXTURE          GL_TEXTURE18
+#define DENOISE_ACCUM_TEXTURE  GL_TEXTURE19
+#define DENOISE_MOMENT_TEXTURE GL_TEXTURE20
+#define DENOISE_COUNT_TEXTURE  GL_TEXTURE21
+
+static GLuint createTexture(const glm::uvec2& resolution, GLenum format)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, format, resolution.x, resolution.y);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	return texture;
+}
+
+static void bindTexture(GLenum unit, GLuint texture)
+{
+	glActiveTexture(unit);
+	glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+Denoiser::Denoiser(const glm::uvec2& resolution)
+	: m_atrousProgram("src/shaders/pathtracer/pathtracer.vert.glsl", "src/shaders/denoiser/atrous.frag.glsl"),
+	  m_resolution(resolution), m_pendingQueries(0)
+{
+	glGenQueries(maxIterations, m_timerQueries);
+
+	glUseProgram(m_atrousProgram.m_id);
+	glUniform1i(glGetUniformLocation(m_atrousProgram.m_id, "inTexture"), DENOISE_INPUT_TEXTURE - GL_TEXTURE0);
+	glUniform1i(glGetUniformLocation(m_atrousProgram.m_id, "albedoTexture"), ALBEDO_TEXTURE - GL_TEXTURE0);
+	glUniform1i(glGetUniformLocation(m_atrousProgram.m_id, "normalTexture"), NORMAL_TEXTURE - GL_TEXTURE0);
+	glUniform1i(glGetUniformLocation(m_atrousProgram.m_id, "depthTexture"), DEPTH_TEXTURE - GL_TEXTURE0);
+	glUniform1i(glGetUniformLocation(m_atrousProgram.m_id, "accumTexture"), DENOISE_ACCUM_TEXTURE - GL_TEXTURE0);
+	glUniform1i(glGetUniformLocation(m_atrousProgram.m_id, "momentTexture"), DENOISE_MOMENT_TEXTURE - GL_TEXTURE0);
+	glUniform1i(glGetUniformLocation(m_atrousProgram.m_id, "sampleCountTexture"), DENOISE_COUNT_TEXTURE - GL_TEXTURE0);
+	glUseProgram(0);
+
+	allocate();
+}
+
+Denoiser::~Denoiser()
+{
+	release();
+	glDeleteQueries(maxIterations, m_timerQueries);
+}
+
+void Denoiser::allocate()
+{
+	// Illumination with its variance in alpha
+	for (int i = 0; i < 2; ++i)
+	{
+		m_filterTextures[i] = createTexture(m_resolution, GL_RGBA32F);
+
+		glGenFramebuffers(1, &m_filterFbos[i]);
+		glBindFramebuffer(GL_FRAMEBUFFER, m_filterFbos[i]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_filterTextures[i], 0);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Denoiser::release()
+{
+	glDeleteFramebuffers(2, m_filterFbos);
+	glDeleteTextures(2, m_filterTextures);
+}
+
+bool Denoiser::isCompiled() const
+{
+	return m_atrousProgram.isCompiled();
+}
+
+void Denoiser::resize(const glm::uvec2& resolution)
+{
+	release();
+	m_resolution = resolution;
+	allocate();
+}
+
+// Only reads the queries once the last one is available, so the filter never waits for the GPU
+void Denoiser::readTimerQueries()
+{
+	if (m_pendingQueries == 0) return;
+
+	GLuint available = GL_FALSE;
+	glGetQueryObjectuiv(m_timerQueries[m_pendingQueries - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available) return;
+
+	m_iterationTimes.resize(m_pendingQueries);
+	for (uint i = 0; i < m_pendingQueries; ++i)
+	{
+		GLuint64 elapsed;
+		glGetQueryObjectui64v(m_timerQueries[i], GL_QUERY_RESULT, &elapsed);
+		m_iterationTimes[i] = elapsed * 1e-6;
+	}
+	m_pendingQueries = 0;
+}
+
+GLuint Denoiser::denoise(const AccumulationBuffer& accumulation, const GBuffer& gbuffer, uint iterations)
+{
+	GLint framebuffer;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+	glViewport(0, 0, m_resolution.x, m_resolution.y);
+
+	readTimerQueries();
+	bool timed = m_pendingQueries == 0;
+
+	const AccumulationBuffer::Target& front = accumulation.getFront();
+	const GBuffer::Target& view = gbuffer.getFront();
+	bindTexture(ALBEDO_TEXTURE, view.albedoTexture);
+	bindTexture(NORMAL_TEXTURE, view.normalTexture);
+	bindTexture(DEPTH_TEXTURE, view.depthTexture);
+	bindTexture(DENOISE_ACCUM_TEXTURE, front.colorTexture);
+	bindTexture(DENOISE_MOMENT_TEXTURE, front.momentTexture);
+	bindTexture(DENOISE_COUNT_TEXTURE, front.sampleCountTexture);
+
+	glUseProgram(m_atrousProgram.m_id);
+	iterations = glm::clamp(iterations, 1u, maxIterations);
+	for (uint i = 0; i < iterations; ++i)
+	{
+		if (timed) glBeginQuery(GL_TIME_ELAPSED, m_timerQueries[i]);
+
+		// The first iteration reads the accumulation, the others the previous iteration's output
+		glBindFramebuffer(GL_FRAMEBUFFER, m_filterFbos[i & 1]);
+		bindTexture(DENOISE_INPUT_TEXTURE, m_filterTextures[(i + 1) & 1]);
+		glUniform1i(glGetUniformLocation(m_atrousProgram.m_id, "stepSize"), 1 << i);
+		glUniform1i(glGetUniformLocation(m_atrousProgram.m_id, "firstIteration"), i == 0);
+		glUniform1i(glGetUniformLocation(m_atrousProgram.m_id, "lastIteration"), i + 1 == iterations);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+
+		if (timed) glEndQuery(GL_TIME_ELAPSED);
+	}
+	if (timed) m_pendingQueries = iterations;
+
+	glUseProgram(0);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+	return m_filterTextures[(iterations - 1) & 1];
+}
+
+const std::vector<double>& Denoiser::getIterationTimes() const
+{
+	return m_iterationTimes;
+}
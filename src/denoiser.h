@@ -0,0 +1,57 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <error_handling.h>
+#include <gl/gl.h>
+#include <utils.h>
+
+#include <shaderprogram.h>
+#include <accumulationbuffer.h>
+#include <gbuffer.h>
+
+#include <vector>
+
+// Edge-avoiding A-trous wavelet filter applied to the accumulation before tonemapping
+// The albedo, shading normal and depth of the G-buffer keep the filter from blurring across edges
+class Denoiser
+{
+public:
+	ShaderProgram m_atrousProgram;
+
+	static constexpr uint defaultIterations = 5;
+	// The last iteration's taps are 2^(maxIterations - 1) pixels apart
+	static constexpr uint maxIterations = 8;
+
+private:
+	glm::uvec2 m_resolution;
+
+	// Ping-pong targets of the iterations
+	GLuint m_filterFbos[2], m_filterTextures[2];
+
+	// One GL_TIME_ELAPSED query per iteration, a new filter is only timed once the previous one's results are read
+	GLuint m_timerQueries[maxIterations];
+	uint m_pendingQueries;
+	std::vector<double> m_iterationTimes;
+
+	void allocate();
+	void release();
+	void readTimerQueries();
+
+public:
+	Denoiser(const glm::uvec2& resolution);
+	~Denoiser();
+
+	Denoiser(const Denoiser&) = delete;
+	Denoiser& operator=(const Denoiser&) = delete;
+
+	bool isCompiled() const;
+
+	void resize(const glm::uvec2& resolution);
+
+	// Filters the front target of [accumulation] with [iterations] iterations and returns the texture holding the result
+	// [gbuffer]'s front target must show the view of the accumulation, the framebuffer binding is left as it was
+	GLuint denoise(const AccumulationBuffer& accumulation, const GBuffer& gbuffer, uint iterations);
+
+	// Milliseconds each iteration of the last timed filter took on the GPU
+	const std::vector<double>& getIterationTimes() const;
+};
@@ -0,0 +1,118 @@
+#include <gbuffer.h>
+
+static GLuint createTexture(const glm::uvec2& resolution, GLenum format)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, format, resolution.x, resolution.y);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	return texture;
+}
+
+GBuffer::GBuffer(const glm::uvec2& resolution)
+	: m_program("src/shaders/pathtracer/pathtracer.vert.glsl", "src/shaders/pathtracer/gbuffer.frag.glsl"),
+	  m_front(0), m_valid(false), m_resolution(resolution)
+{
+	allocate();
+}
+
+GBuffer::~GBuffer()
+{
+	release();
+}
+
+void GBuffer::allocate()
+{
+	for (Target& target : m_targets)
+	{
+		target.albedoTexture = createTexture(m_resolution, GL_RGBA16F);
+		target.normalTexture = createTexture(m_resolution, GL_RGBA16F);
+		target.depthTexture = createTexture(m_resolution, GL_RG32F);
+		target.positionTexture = createTexture(m_resolution, GL_RGBA32F);
+
+		glGenFramebuffers(1, &target.fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.albedoTexture, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, target.normalTexture, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, target.depthTexture, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, target.positionTexture, 0);
+
+		GLenum drawBuffers[4] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3};
+		glDrawBuffers(4, drawBuffers);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	m_front = 0;
+	m_valid = false;
+}
+
+void GBuffer::release()
+{
+	for (Target& target : m_targets)
+	{
+		glDeleteFramebuffers(1, &target.fbo);
+		glDeleteTextures(1, &target.albedoTexture);
+		glDeleteTextures(1, &target.normalTexture);
+		glDeleteTextures(1, &target.depthTexture);
+		glDeleteTextures(1, &target.positionTexture);
+	}
+}
+
+bool GBuffer::isCompiled() const
+{
+	return m_program.isCompiled();
+}
+
+void GBuffer::resize(const glm::uvec2& resolution)
+{
+	release();
+	m_resolution = resolution;
+	allocate();
+}
+
+void GBuffer::invalidate()
+{
+	m_valid = false;
+}
+
+bool GBuffer::isValid() const
+{
+	return m_valid;
+}
+
+void GBuffer::draw(const Camera& camera)
+{
+	GLint framebuffer;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+
+	m_front = 1 - m_front;
+	Target& target = m_targets[m_front];
+	target.eye = camera.m_eye;
+	target.forward = camera.m_forward;
+	target.up = camera.m_up;
+	target.right = camera.m_right;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+	glViewport(0, 0, m_resolution.x, m_resolution.y);
+	glUseProgram(m_program.m_id);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	glUseProgram(0);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+	m_valid = true;
+}
+
+const GBuffer::Target& GBuffer::getFront() const
+{
+	return m_targets[m_front];
+}
+
+const GBuffer::Target& GBuffer::getPrevious() const
+{
+	return m_targets[1 - m_front];
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <error_handling.h>
+#include <gl/gl.h>
+#include <utils.h>
+
+#include <shaderprogram.h>
+#include <camera.h>
+
+// First hit through the middle of every pixel, for the denoiser and for reprojecting the accumulation when the camera moves
+// Ping-pong pair, drawing the current view makes the previous one the back target
+class GBuffer
+{
+public:
+	struct Target {
+		GLuint fbo;
+		// Albedo of the hit material as RGBA16F, white for lights and the background
+		GLuint albedoTexture;
+		// Shading normal as RGBA16F, zero for lights and the background
+		GLuint normalTexture;
+		// Distance along the ray and its largest screen space derivative as RG32F
+		GLuint depthTexture;
+		// World position as RGBA32F
+		GLuint positionTexture;
+
+		// Camera the target was drawn from
+		glm::vec3 eye, forward, up, right;
+	};
+
+	ShaderProgram m_program;
+
+private:
+	Target m_targets[2];
+	int m_front;
+	// Whether the front target shows the view the accumulation was taken from
+	bool m_valid;
+
+	glm::uvec2 m_resolution;
+
+	void allocate();
+	void release();
+
+public:
+	GBuffer(const glm::uvec2& resolution);
+	~GBuffer();
+
+	GBuffer(const GBuffer&) = delete;
+	GBuffer& operator=(const GBuffer&) = delete;
+
+	bool isCompiled() const;
+
+	void resize(const glm::uvec2& resolution);
+	void invalidate();
+	bool isValid() const;
+
+	// Draws the view of [camera] into the back target and makes it the front one
+	// The scene textures and the program's uniforms must be set, the framebuffer binding is left as it was
+	void draw(const Camera& camera);
+
+	const Target& getFront() const;
+	// The view drawn before the front one
+	const Target& getPrevious() const;
+};
@@ -0,0 +1,67 @@
+#include <image.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+static bool hasExtension(const char* filePath, const char* extension)
+{
+	size_t pathLength = std::strlen(filePath);
+	size_t extensionLength = std::strlen(extension);
+	return pathLength >= extensionLength && std::strcmp(filePath + pathLength - extensionLength, extension) == 0;
+}
+
+// Same Reinhard operator and gamma as post.frag.glsl
+static uint8_t tonemap(float value)
+{
+	value = value / (1.f + value);
+	value = std::pow(value, 1.f / 2.2f);
+	return uint8_t(std::round(glm::clamp(value, 0.f, 1.f) * 255.f));
+}
+
+bool writeImage(const char* filePath, const glm::uvec2& resolution, const std::vector<glm::vec4>& pixels)
+{
+	FILE* file = std::fopen(filePath, "wb");
+	if (!file)
+	{
+		printf("Could not open %s for writing\n", filePath);
+		return false;
+	}
+
+	bool written = true;
+	if (hasExtension(filePath, ".pfm"))
+	{
+		// Negative scale marks little endian, rows are stored from the bottom
+		std::fprintf(file, "PF\n%u %u\n-1.0\n", resolution.x, resolution.y);
+		for (uint32_t i = 0; i < resolution.x * resolution.y && written; ++i)
+		{
+			written = std::fwrite(&pixels[i], sizeof(float), 3, file) == 3;
+		}
+	}
+	else
+	{
+		// Rows are stored from the top
+		std::fprintf(file, "P6\n%u %u\n255\n", resolution.x, resolution.y);
+		std::vector<uint8_t> row(resolution.x * 3);
+		for (uint32_t y = resolution.y; y-- > 0 && written;)
+		{
+			for (uint32_t x = 0; x < resolution.x; ++x)
+			{
+				const glm::vec4& pixel = pixels[y * resolution.x + x];
+				row[x * 3 + 0] = tonemap(pixel.r);
+				row[x * 3 + 1] = tonemap(pixel.g);
+				row[x * 3 + 2] = tonemap(pixel.b);
+			}
+			written = std::fwrite(row.data(), 1, row.size(), file) == row.size();
+		}
+	}
+
+	written = std::fclose(file) == 0 && written;
+	if (!written)
+	{
+		printf("Could not write %s\n", filePath);
+	}
+
+	return written;
+}
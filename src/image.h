@@ -0,0 +1,9 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Writes [pixels], rows from the bottom as in the accumulation texture, to [filePath]
+// .pfm files keep the linear radiance, anything else is written as a tonemapped binary .ppm
+bool writeImage(const char* filePath, const glm::uvec2& resolution, const std::vector<glm::vec4>& pixels);
@@ -1,5 +1,10 @@
 #include <iostream>
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <string>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -18,6 +23,9 @@ using namespace glm;
 #include <shaderprogram.h>
 #include <renderer.h>
 #include <camera.h>
+#include <cpupathtracer.h>
+#include <image.h>
+#include <scenecache.h>
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
@@ -26,6 +34,9 @@ using namespace glm;
 
 #define CAMERA_SENSITIVITY 0.01f
 
+// Seconds of rendering between the noise estimates of an offline GPU render, each of which waits for the GPU
+#define NOISE_CHECK_INTERVAL 0.25
+
 // #################
 // # Error Logging #
 // #################
@@ -105,25 +116,587 @@ static void mouseCursorPosCallback(GLFWwindow* window, double xpos, double ypos)
     data.mousePosition = mousePosition;
 }
 
+static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    UNUSED(scancode);
+    UNUSED(mods);
+
+    CallbackAccessibleData& data = *(CallbackAccessibleData*)glfwGetWindowUserPointer(window);
+    Renderer* renderer = data.renderer;
+
+    // B : Cycle through the fragment, tiled, wavefront and CPU backends
+    if (key == GLFW_KEY_B && action == GLFW_PRESS)
+    {
+        switch (renderer->getBackend())
+        {
+        case Renderer::Backend::Fragment:
+            renderer->setBackend(Renderer::Backend::Tiled);
+            break;
+        case Renderer::Backend::Tiled:
+            renderer->setBackend(Renderer::Backend::Wavefront);
+            break;
+        case Renderer::Backend::Wavefront:
+            renderer->setBackend(Renderer::Backend::CPU);
+            break;
+        case Renderer::Backend::CPU:
+            renderer->setBackend(Renderer::Backend::Fragment);
+            break;
+        }
+    }
+
+    // N : Toggle blue noise sample offsets
+    if (key == GLFW_KEY_N && action == GLFW_PRESS)
+    {
+        renderer->setBlueNoise(!renderer->getBlueNoise());
+    }
+
+    // D : Toggle the denoiser
+    if (key == GLFW_KEY_D && action == GLFW_PRESS)
+    {
+        renderer->setDenoiseIterations(renderer->getDenoiseIterations() > 0 ? 0 : Denoiser::defaultIterations);
+    }
+
+    // R : Toggle reprojecting the accumulation when the camera moves
+    if (key == GLFW_KEY_R && action == GLFW_PRESS)
+    {
+        renderer->setReprojection(!renderer->getReprojection());
+    }
+
+    // I : Cycle the resolution while the camera moves through full, 1/2 and 1/4
+    if (key == GLFW_KEY_I && action == GLFW_PRESS)
+    {
+        uint scale = renderer->getInteractionScale();
+        renderer->setInteractionScale(scale >= 4 ? 1 : scale * 2);
+    }
+
+    // V : Toggle rasterizing the first hits of the fragment and tiled backends
+    if (key == GLFW_KEY_V && action == GLFW_PRESS)
+    {
+        renderer->setRasterPrimary(!renderer->getRasterPrimary());
+    }
+
+    // E : Toggle the error map view
+    if (key == GLFW_KEY_E && action == GLFW_PRESS)
+    {
+        renderer->setView(renderer->getView() == Renderer::View::Error ? Renderer::View::Color : Renderer::View::Error);
+    }
+}
+
 static void windowSizeCallback(GLFWwindow* window, int width, int height)
 {
     CallbackAccessibleData& data = *(CallbackAccessibleData*)glfwGetWindowUserPointer(window);
     data.renderer->resize(glm::uvec2(width, height));
 }
 
-bool run()
+// ###########
+// # Options #
+// ###########
+
+struct Options {
+    std::string sceneFile = "assets/TEST.obj";
+    std::string materialRoot = "assets/";
+    uvec2 resolution = uvec2(1280, 720);
+
+    // Presentations per second of the interactive window, zero presents once per accumulation pass at the monitor's refresh rate
+    uint32_t displayRate = 60;
+    // GPU time each accumulation pass is held at by adapting its samples per pixel, zero takes one sample per pass
+    double passTime = 0.0;
+
+    // Offline rendering, enabled by an output file
+    std::string outFile;
+    uint32_t spp = 64;
+    bool hasSpp = false;
+    unsigned threadCount = 0;
+    // Offline renders stop once the relative MSE of the image drops below the target or the time budget runs out, zero disables either
+    // With either set, --spp only caps the samples if it is given
+    double noiseTarget = 0.0;
+    double timeBudget = 0.0;
+
+    Renderer::Backend backend = Renderer::Backend::Fragment;
+    bool hasBackend = false;
+    AccumulationBuffer::Format accumulationFormat = AccumulationBuffer::Format::RGBA32F;
+    bool blueNoise = false;
+    uint32_t maxDepth = CPUPathTracer::defaultMaxDepth;
+    uint32_t rouletteDepth = CPUPathTracer::defaultRouletteDepth;
+    // Relative standard error at which the GPU backends stop sampling a tile, zero samples every pixel
+    float adaptiveThreshold = 0.f;
+    // A-trous iterations of the interactive denoiser, zero disables it
+    uint32_t denoiseIterations = 0;
+    // Keep the accumulation of the interactive view through camera moves
+    bool reprojection = false;
+    // Divides the resolution of the interactive view while the camera moves, 1 keeps it
+    uint32_t interactionScale = 1;
+    // Start the paths of the fragment and tiled backends from a rasterized visibility buffer
+    bool rasterPrimary = false;
+    // Tiles of the tiled backend, zero tiles per dispatch traces a whole pass in one dispatch
+    uint32_t tileSize = TiledPathTracer::defaultTileSize;
+    TiledPathTracer::Order tileOrder = TiledPathTracer::Order::Hilbert;
+    uint32_t tilesPerDispatch = TiledPathTracer::defaultTilesPerDispatch;
+    // CSV of the clock cycles every tile of an offline tiled render took, empty records none
+    std::string tileTimesFile;
+    // Load the scene from its binary cache when it is current, and write the cache after parsing it otherwise
+    bool sceneCache = true;
+    bool help = false;
+};
+
+static void printUsage(const char* program)
+{
+    std::cout << "Usage: " << program << " [options]\n"
+        << "  --scene FILE        OBJ scene to load (default assets/TEST.obj)\n"
+        << "  --mtl-root DIR      Directory of the scene's MTL files (default assets/)\n"
+        << "  --no-cache          Always parse the scene instead of reading or writing its binary cache next to the OBJ file\n"
+        << "  --res WxH           Image resolution (default 1280x720)\n"
+        << "  --backend NAME      fragment, tiled, wavefront or cpu (default fragment, cpu when rendering offline)\n"
+        << "  --accumulation FMT  rgba32f, rgba16f or r11g11b10f storage of the GPU running mean (default rgba32f)\n"
+        << "  --display-rate HZ   Window updates per second, accumulation runs back to back in between (default 60)\n"
+        << "                      0 runs one pass per vsynced frame\n"
+        << "  --pass-ms MS        Adapt the samples per pixel of every pass so it takes MS milliseconds (default off, one sample per pass)\n"
+        << "  --blue-noise        Offset the sample sequences of the pixels by blue noise, low sample counts look cleaner\n"
+        << "  --max-depth N       Path segments traced at most (default " << CPUPathTracer::defaultMaxDepth << ")\n"
+        << "  --rr-depth N        Path segments before Russian roulette may end a path (default " << CPUPathTracer::defaultRouletteDepth << ")\n"
+        << "  --denoise N         Denoise the interactive view with N A-trous iterations, at most " << Denoiser::maxIterations << " (default off, D toggles it)\n"
+        << "  --reproject         Carry the accumulation over when the camera moves on the GPU backends (default off, R toggles it)\n"
+        << "  --preview-scale N   Trace 1/N of the resolution while the camera moves, e.g. 2 or 4 (default 1, I cycles it)\n"
+        << "  --raster-primary    Rasterize the first hits of the fragment and tiled backends instead of tracing them (default off, V toggles it)\n"
+        << "  --tile-size N       Side in pixels of the tiles of the tiled backend, a multiple of 8 (default " << TiledPathTracer::defaultTileSize << ")\n"
+        << "  --tile-order ORDER  hilbert, morton or scanline order of the tiles (default hilbert)\n"
+        << "  --tile-batch N      Tiles per dispatch of the tiled backend, 0 traces a whole pass in one dispatch (default " << TiledPathTracer::defaultTilesPerDispatch << ")\n"
+        << "  --tile-times FILE   Write the clock cycles every tile of an offline tiled render took to FILE as CSV\n"
+        << "  --adaptive ERR      Stop sampling the 8x8 tiles whose relative error is below ERR, e.g. 0.01, on the GPU backends (default off)\n"
+        << "  --out FILE          Render offline without a window and write FILE, .pfm is linear, anything else is a tonemapped .ppm\n"
+        << "  --spp N             Samples per pixel of an offline render (default 64, unlimited with --noise or --time)\n"
+        << "  --noise RELMSE      Stop an offline render once the estimated relative MSE of the image is below RELMSE, e.g. 0.001\n"
+        << "  --time SECONDS      Stop an offline render after SECONDS, whichever of the limits comes first\n"
+        << "  --threads N         Worker threads of an offline CPU render (default one per hardware thread)\n"
+        << "  --help              Show this message" << std::endl;
+}
+
+static bool parseUnsigned(const char* value, uint32_t& result)
+{
+    char* end = nullptr;
+    unsigned long parsed = std::strtoul(value, &end, 10);
+    if (end == value || *end != '\0' || value[0] == '-') return false;
+
+    result = uint32_t(parsed);
+    return true;
+}
+
+static bool parseOptions(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string option = argv[i];
+        if (option == "--help" || option == "-h")
+        {
+            options.help = true;
+            return true;
+        }
+        if (option == "--blue-noise")
+        {
+            options.blueNoise = true;
+            continue;
+        }
+        if (option == "--reproject")
+        {
+            options.reprojection = true;
+            continue;
+        }
+        if (option == "--raster-primary")
+        {
+            options.rasterPrimary = true;
+            continue;
+        }
+        if (option == "--no-cache")
+        {
+            options.sceneCache = false;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            std::cout << "Missing value for " << option << std::endl;
+            return false;
+        }
+        const char* value = argv[++i];
+
+        bool valid = true;
+        if (option == "--scene")
+        {
+            options.sceneFile = value;
+        }
+        else if (option == "--mtl-root")
+        {
+            options.materialRoot = value;
+            if (!options.materialRoot.empty() && options.materialRoot.back() != '/') options.materialRoot += '/';
+        }
+        else if (option == "--res")
+        {
+            std::string resolution = value;
+            size_t separator = resolution.find('x');
+            valid = separator != std::string::npos
+                && parseUnsigned(resolution.substr(0, separator).c_str(), options.resolution.x)
+                && parseUnsigned(resolution.substr(separator + 1).c_str(), options.resolution.y)
+                && options.resolution.x > 0 && options.resolution.y > 0;
+        }
+        else if (option == "--backend")
+        {
+            std::string backend = value;
+            options.hasBackend = true;
+            if (backend == "fragment") options.backend = Renderer::Backend::Fragment;
+            else if (backend == "tiled") options.backend = Renderer::Backend::Tiled;
+            else if (backend == "wavefront") options.backend = Renderer::Backend::Wavefront;
+            else if (backend == "cpu") options.backend = Renderer::Backend::CPU;
+            else valid = false;
+        }
+        else if (option == "--accumulation")
+        {
+            std::string format = value;
+            if (format == "rgba32f") options.accumulationFormat = AccumulationBuffer::Format::RGBA32F;
+            else if (format == "rgba16f") options.accumulationFormat = AccumulationBuffer::Format::RGBA16F;
+            else if (format == "r11g11b10f") options.accumulationFormat = AccumulationBuffer::Format::R11G11B10F;
+            else valid = false;
+        }
+        else if (option == "--display-rate")
+        {
+            valid = parseUnsigned(value, options.displayRate);
+        }
+        else if (option == "--pass-ms")
+        {
+            char* end = nullptr;
+            options.passTime = std::strtod(value, &end);
+            valid = end != value && *end == '\0' && options.passTime >= 0.0;
+        }
+        else if (option == "--max-depth")
+        {
+            valid = parseUnsigned(value, options.maxDepth) && options.maxDepth > 0;
+        }
+        else if (option == "--rr-depth")
+        {
+            valid = parseUnsigned(value, options.rouletteDepth);
+        }
+        else if (option == "--denoise")
+        {
+            valid = parseUnsigned(value, options.denoiseIterations) && options.denoiseIterations <= Denoiser::maxIterations;
+        }
+        else if (option == "--preview-scale")
+        {
+            valid = parseUnsigned(value, options.interactionScale) && options.interactionScale > 0;
+        }
+        else if (option == "--tile-size")
+        {
+            valid = parseUnsigned(value, options.tileSize) && options.tileSize > 0 && options.tileSize % TILE_GROUP_SIZE == 0;
+        }
+        else if (option == "--tile-order")
+        {
+            std::string order = value;
+            if (order == "hilbert") options.tileOrder = TiledPathTracer::Order::Hilbert;
+            else if (order == "morton") options.tileOrder = TiledPathTracer::Order::Morton;
+            else if (order == "scanline") options.tileOrder = TiledPathTracer::Order::Scanline;
+            else valid = false;
+        }
+        else if (option == "--tile-batch")
+        {
+            valid = parseUnsigned(value, options.tilesPerDispatch);
+        }
+        else if (option == "--tile-times")
+        {
+            options.tileTimesFile = value;
+        }
+        else if (option == "--adaptive")
+        {
+            char* end = nullptr;
+            options.adaptiveThreshold = std::strtof(value, &end);
+            valid = end != value && *end == '\0' && options.adaptiveThreshold >= 0.f;
+        }
+        else if (option == "--out")
+        {
+            options.outFile = value;
+        }
+        else if (option == "--spp")
+        {
+            valid = parseUnsigned(value, options.spp) && options.spp > 0;
+            options.hasSpp = true;
+        }
+        else if (option == "--noise")
+        {
+            char* end = nullptr;
+            options.noiseTarget = std::strtod(value, &end);
+            valid = end != value && *end == '\0' && options.noiseTarget >= 0.0;
+        }
+        else if (option == "--time")
+        {
+            char* end = nullptr;
+            options.timeBudget = std::strtod(value, &end);
+            valid = end != value && *end == '\0' && options.timeBudget >= 0.0;
+        }
+        else if (option == "--threads")
+        {
+            valid = parseUnsigned(value, options.threadCount);
+        }
+        else
+        {
+            std::cout << "Unknown option " << option << std::endl;
+            return false;
+        }
+
+        if (!valid)
+        {
+            std::cout << "Invalid value '" << value << "' for " << option << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// ##############
+// # Scene Init #
+// ##############
+
+static Scene* loadScene(const Options& options)
+{
+    Timer timer;
+
+    const char* sceneFile = options.sceneFile.c_str();
+    const char* materialRoot = options.materialRoot.c_str();
+    std::string cachePath = sceneCachePath(sceneFile);
+
+    Scene* scene = options.sceneCache ? readSceneCache(cachePath.c_str(), sceneFile, materialRoot) : nullptr;
+    bool cached = scene != nullptr;
+    if (!cached)
+    {
+        scene = new Scene(sceneFile, materialRoot);
+        if (scene->m_triangles.empty())
+        {
+            std::cout << "Could not load a scene from " << options.sceneFile << std::endl;
+            delete scene;
+            return nullptr;
+        }
+
+        // Failing to write the cache only costs the next run the parsing
+        if (options.sceneCache) writeSceneCache(cachePath.c_str(), sceneFile, materialRoot, *scene);
+    }
+
+    // TODO add a way to define lights from referenced files
+    scene->m_lights = std::vector<Scene::Light> { Scene::Light(glm::vec3(4.f), glm::vec3(0.f, 1.95f, 0.f), glm::vec3(3.14f / 2.f, 0.f, 0.f), glm::vec3(1.25f, 1.25f, 1.f)) };
+    scene->m_lightCount = glm::uvec4(1, 0, 0, 0);
+
+    printf("Loaded %s%s: %zu triangles, %zu instances in %.1f ms\n", sceneFile, cached ? " from its cache" : "", scene->m_triangles.size(), scene->m_instances.size(), timer.getElapsedMilliseconds());
+
+    return scene;
+}
+
+static Camera* createCamera(const Options& options)
+{
+    return new Camera(glm::vec3(0.f, 1.5f, 15.f), glm::vec3(0.f, -0.25f, 0.f), options.resolution);
+}
+
+// Samples per pixel an offline render takes at most
+static uint32_t getMaxSamples(const Options& options)
+{
+    bool converges = options.noiseTarget > 0.0 || options.timeBudget > 0.0;
+    return converges && !options.hasSpp ? std::numeric_limits<uint32_t>::max() : options.spp;
+}
+
+// [spp] is the mean over the pixels, [noise] the relative MSE of the image
+static void printRenderStats(const Options& options, double spp, double seconds, float noise)
+{
+    double pixelSamples = double(options.resolution.x) * options.resolution.y * spp;
+    printf("Rendered %.4g spp at %ux%u in %.3f s (%.2f ms/spp, %.2f Msamples/s), relative MSE %.3g\n",
+        spp, options.resolution.x, options.resolution.y, seconds,
+        seconds * 1000.0 / spp, pixelSamples / seconds * 1e-6, noise);
+}
+
+// Writes the clock cycles of every tile as CSV rows of tile coordinates, from the bottom left, and prints how uneven they were
+static bool writeTileTimes(const char* filePath, const uvec2& tiles, const std::vector<uint64_t>& times)
+{
+    FILE* file = std::fopen(filePath, "w");
+    if (!file)
+    {
+        printf("Could not open %s for writing\n", filePath);
+        return false;
+    }
+
+    std::fprintf(file, "x,y,cycles\n");
+    uint64_t slowest = 0;
+    double total = 0.0;
+    for (uint32_t i = 0; i < times.size(); ++i)
+    {
+        std::fprintf(file, "%u,%u,%llu\n", i % tiles.x, i / tiles.x, (unsigned long long)times[i]);
+        slowest = std::max(slowest, times[i]);
+        total += double(times[i]);
+    }
+
+    if (std::fclose(file) != 0)
+    {
+        printf("Could not write %s\n", filePath);
+        return false;
+    }
+
+    if (total > 0.0)
+    {
+        printf("Timed %ux%u tiles, the slowest took %.2fx the mean\n", tiles.x, tiles.y, slowest * times.size() / total);
+    }
+
+    return true;
+}
+
+// ####################
+// # Offline Renderer #
+// ####################
+
+// Renders on the CPU without any graphics context, so it runs on machines without a display
+static bool renderOfflineCPU(const Options& options)
+{
+    Scene* scene = loadScene(options);
+    LOG_AND_RETURN_IF_ERROR(scene);
+    DEFER(delete scene);
+    Camera* camera = createCamera(options);
+    DEFER(delete camera);
+    camera->update();
+
+    CPUPathTracer pathTracer(scene, camera, options.threadCount);
+    printf("Rendering on %u CPU threads\n", pathTracer.getThreadCount());
+    pathTracer.setPathDepth(options.maxDepth, options.rouletteDepth);
+
+    std::vector<uint16_t> blueNoise;
+    if (options.blueNoise)
+    {
+        blueNoise = blueNoiseTile();
+        pathTracer.setBlueNoise(&blueNoise);
+    }
+
+    // The noise estimate is cheap next to a pass, so it is checked after every one
+    uint32_t maxSamples = getMaxSamples(options);
+    uint32_t spp = 0;
+    Timer timer;
+    while (spp < maxSamples)
+    {
+        pathTracer.trace(spp);
+        spp++;
+
+        if (options.noiseTarget > 0.0 && pathTracer.estimateNoise(spp) < options.noiseTarget) break;
+        if (options.timeBudget > 0.0 && timer.getElapsedSeconds() >= options.timeBudget) break;
+    }
+    printRenderStats(options, spp, timer.getElapsedSeconds(), pathTracer.estimateNoise(spp));
+
+    return writeImage(options.outFile.c_str(), options.resolution, pathTracer.m_film);
+}
+
+// Renders on the GPU through a hidden window, which still needs a display server
+static bool renderOfflineGPU(const Options& options)
+{
+    Scene* scene = loadScene(options);
+    LOG_AND_RETURN_IF_ERROR(scene);
+    DEFER(delete scene);
+    Camera* camera = createCamera(options);
+    DEFER(delete camera);
+
+    glfwSetErrorCallback([](int error, const char* description) {
+        printf("GLFW Error [%d] via callback: '%s'\n", error, description);
+    });
+
+    LOG_AND_RETURN_IF_ERROR(glfwInit());
+    DEFER(glfwTerminate());
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+    GLFWwindow* window = glfwCreateWindow(options.resolution.x, options.resolution.y, "PathTracer", nullptr, nullptr);
+    LOG_AND_RETURN_IF_ERROR(window);
+    DEFER(glfwDestroyWindow(window));
+
+    glfwMakeContextCurrent(window);
+
+    LOG_AND_RETURN_IF_ERROR(glewInit() == GLEW_OK);
+
+    ShaderProgram program = ShaderProgram("src/shaders/pathtracer/pathtracer.vert.glsl", "src/shaders/pathtracer/pathtracer.frag.glsl");
+    ShaderProgram postProgram = ShaderProgram("src/shaders/pathtracer/pathtracer.vert.glsl", "src/shaders/pathtracer/post.frag.glsl");
+
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    DEFER(glDeleteVertexArrays(1, &vao));
+
+    Renderer renderer(program, postProgram, scene, camera);
+    renderer.setAccumulationFormat(options.accumulationFormat);
+    renderer.setBackend(options.backend);
+    renderer.setBlueNoise(options.blueNoise);
+    renderer.setPathDepth(options.maxDepth, options.rouletteDepth);
+    renderer.setAdaptiveThreshold(options.adaptiveThreshold);
+    renderer.setRasterPrimary(options.rasterPrimary);
+    renderer.setTiling(options.tileSize, options.tileOrder, options.tilesPerDispatch);
+    LOG_AND_RETURN_IF_ERROR(renderer.getBackend() == options.backend);
+
+    bool timeTiles = !options.tileTimesFile.empty();
+    if (timeTiles && options.backend != Renderer::Backend::Tiled)
+    {
+        std::cout << "Only the tiled backend times its tiles, " << options.tileTimesFile << " is not written" << std::endl;
+        timeTiles = false;
+    }
+    else if (timeTiles && !renderer.setTileProfiling(true))
+    {
+        std::cout << "The GPU cannot read its clock from shaders, " << options.tileTimesFile << " is not written" << std::endl;
+        timeTiles = false;
+    }
+
+    // Passes run in chunks of NOISE_CHECK_INTERVAL seconds between checking the limits
+    uint32_t maxSamples = getMaxSamples(options);
+    bool checkLimits = options.noiseTarget > 0.0 || options.timeBudget > 0.0;
+    glFinish();
+    Timer timer;
+    while (renderer.getSampleCount() < maxSamples)
+    {
+        double chunk = checkLimits ? NOISE_CHECK_INTERVAL : std::numeric_limits<double>::infinity();
+        if (options.timeBudget > 0.0)
+        {
+            chunk = std::min(chunk, options.timeBudget - timer.getElapsedSeconds());
+        }
+        renderer.accumulateFor(chunk, maxSamples);
+
+        if (options.timeBudget > 0.0 && timer.getElapsedSeconds() >= options.timeBudget) break;
+        if (options.noiseTarget > 0.0 && renderer.estimateNoise() < options.noiseTarget) break;
+    }
+    glFinish();
+    double seconds = timer.getElapsedSeconds();
+
+    std::vector<glm::vec4> pixels;
+    renderer.readAccumulation(pixels);
+    GL_REPORT_ERRORS();
+
+    // Adaptive sampling leaves every pixel with its own sample count in alpha
+    double sampleCount = 0.0;
+    for (const glm::vec4& pixel : pixels)
+    {
+        sampleCount += pixel.a;
+    }
+    printRenderStats(options, sampleCount / pixels.size(), seconds, renderer.estimateNoise());
+
+    if (timeTiles)
+    {
+        uvec2 tiles;
+        std::vector<uint64_t> tileTimes = renderer.getTileTimes(tiles);
+        LOG_AND_RETURN_IF_ERROR(writeTileTimes(options.tileTimesFile.c_str(), tiles, tileTimes));
+    }
+
+    return writeImage(options.outFile.c_str(), options.resolution, pixels);
+}
+
+// ########################
+// # Interactive Renderer #
+// ########################
+
+bool run(const Options& options)
 {
     // ##############
     // # Scene Init #
     // ##############
 
-    // TODO add a way to define lights from referenced files
-    Scene* defaultScene = new Scene("assets/TEST.obj", "assets/");
-    defaultScene->m_lights = std::vector<Scene::Light> { Scene::Light(glm::vec3(4.f), glm::vec3(0.f, 1.95f, 0.f), glm::vec3(3.14f / 2.f, 0.f, 0.f), glm::vec3(1.25f, 1.25f, 1.f)) };
-    defaultScene->m_lightCount = glm::uvec4(1, 0, 0, 0);
-
+    Scene* defaultScene = loadScene(options);
+    LOG_AND_RETURN_IF_ERROR(defaultScene);
     DEFER(delete defaultScene);
-    Camera* camera = new Camera(glm::vec3(0.f, 1.5f, 15.f), glm::vec3(0.f, -0.25f, 0.f), glm::uvec2(1280, 720));
+    Camera* camera = createCamera(options);
     DEFER(delete camera);
 
     // #############
@@ -140,16 +713,18 @@ bool run()
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
 
-    GLFWwindow* window = glfwCreateWindow(1280, 720, "PathTracer", nullptr, nullptr);
+    GLFWwindow* window = glfwCreateWindow(options.resolution.x, options.resolution.y, "PathTracer", nullptr, nullptr);
     LOG_AND_RETURN_IF_ERROR(window);
     DEFER(glfwDestroyWindow(window));
 
     glfwMakeContextCurrent(window);
-    glfwSwapInterval(1);
+    // Waiting on vsync would hold back the accumulation between presents
+    glfwSwapInterval(options.displayRate == 0 ? 1 : 0);
 
     // Callbacks
     glfwSetCursorPosCallback(window, mouseCursorPosCallback);
     glfwSetWindowSizeCallback(window, windowSizeCallback);
+    glfwSetKeyCallback(window, keyCallback);
 
     LOG_AND_RETURN_IF_ERROR(glewInit() == GLEW_OK);
 
@@ -170,6 +745,17 @@ bool run()
     glBindVertexArray(vao);
 
     Renderer renderer(program, postProgram, defaultScene, camera);
+    renderer.setAccumulationFormat(options.accumulationFormat);
+    renderer.setBackend(options.backend);
+    renderer.setTargetPassTime(options.passTime);
+    renderer.setBlueNoise(options.blueNoise);
+    renderer.setPathDepth(options.maxDepth, options.rouletteDepth);
+    renderer.setAdaptiveThreshold(options.adaptiveThreshold);
+    renderer.setDenoiseIterations(options.denoiseIterations);
+    renderer.setReprojection(options.reprojection);
+    renderer.setInteractionScale(options.interactionScale);
+    renderer.setRasterPrimary(options.rasterPrimary);
+    renderer.setTiling(options.tileSize, options.tileOrder, options.tilesPerDispatch);
 
     // Callback data
     CallbackAccessibleData callbackAccessibleData {ivec2(), &renderer};
@@ -179,10 +765,43 @@ bool run()
     // # Main Loop #
     // #############
 
+    auto titleUpdate = std::chrono::steady_clock::now();
+
     glUseProgram(program.m_id);
     while (!glfwWindowShouldClose(window))
     {
-        renderer.draw();
+        if (options.displayRate == 0)
+        {
+            renderer.draw();
+        }
+        else
+        {
+            // Sample until the next presentation is due, input is handled once per presentation
+            renderer.accumulateFor(1.0 / options.displayRate);
+            renderer.present();
+        }
+
+        // Sampling statistics, twice per second
+        auto now = std::chrono::steady_clock::now();
+        if (now - titleUpdate > std::chrono::milliseconds(500))
+        {
+            char title[256];
+            int length = snprintf(title, sizeof(title), "PathTracer - %u spp, %u spp/pass, %.2f ms/pass%s",
+                renderer.getSampleCount(), renderer.getSamplesPerPass(), renderer.getPassTime(), renderer.getBlueNoise() ? ", blue noise" : "");
+
+            // GPU time of every denoiser iteration
+            std::vector<double> denoiseTimes = renderer.getDenoiseTimes();
+            for (size_t i = 0; i < denoiseTimes.size() && length < int(sizeof(title)); ++i)
+            {
+                length += snprintf(title + length, sizeof(title) - length, i == 0 ? ", denoise %.2f" : " + %.2f", denoiseTimes[i]);
+            }
+            if (!denoiseTimes.empty() && length < int(sizeof(title)))
+            {
+                snprintf(title + length, sizeof(title) - length, " ms");
+            }
+            glfwSetWindowTitle(window, title);
+            titleUpdate = now;
+        }
 
         glfwSwapBuffers(window);
         glfwPollEvents();
@@ -194,12 +813,35 @@ bool run()
 
 int main(int argc, char** argv)
 {
-    UNUSED(argc);
-    UNUSED(argv);
-
     std::cout << "PathTracer" << std::endl;
 
-    if (!run())
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (options.help)
+    {
+        printUsage(argv[0]);
+        return 0;
+    }
+
+    bool success;
+    if (options.outFile.empty())
+    {
+        success = run(options);
+    }
+    else if (!options.hasBackend || options.backend == Renderer::Backend::CPU)
+    {
+        success = renderOfflineCPU(options);
+    }
+    else
+    {
+        success = renderOfflineGPU(options);
+    }
+
+    if (!success)
     {
         return 1;
     }
@@ -5,29 +5,34 @@
 #define VERTEX_DATA_TEXTURE  GL_TEXTURE2
 #define ACCUMULATION_TEXTURE GL_TEXTURE3
 #define LIGHT_TEXTURE        GL_TEXTURE4
-#define MATERIAL_TEXTURE     GL_TEXTURE5
+#define SAMPLE_COUNT_TEXTURE GL_TEXTURE5
 #define MATERIAL_MAP_TEXTURE GL_TEXTURE6
+#define BVH_TEXTURE          GL_TEXTURE7
+#define TLAS_TEXTURE         GL_TEXTURE8
+#define INSTANCE_TEXTURE     GL_TEXTURE9
+#define TRIANGLE_TEXTURE     GL_TEXTURE10
+#define BLUE_NOISE_TEXTURE   GL_TEXTURE12
+#define MOMENT_TEXTURE       GL_TEXTURE13
+#define ERROR_TEXTURE        GL_TEXTURE14
+// Reprojection, after the denoiser's
+#define POSITION_TEXTURE          GL_TEXTURE22
+#define NORMAL_TEXTURE            GL_TEXTURE23
+#define PREVIOUS_POSITION_TEXTURE GL_TEXTURE24
+#define PREVIOUS_NORMAL_TEXTURE   GL_TEXTURE25
+#define VISIBILITY_TEXTURE        GL_TEXTURE26
 
 Renderer::Renderer(const ShaderProgram& program, const ShaderProgram& postProgram, Scene* scene, Camera* camera)
-	: m_scene(scene), m_camera(camera), m_program(program), m_postProgram(postProgram), m_iterationCount(0)
+	: m_scene(scene), m_camera(camera), m_program(program), m_postProgram(postProgram), m_accumulation(camera->m_resolution),
+	  m_errorProgram("src/shaders/pathtracer/error.comp.glsl"), m_noiseProgram("src/shaders/pathtracer/noise.comp.glsl"),
+	  m_maxDepth(CPUPathTracer::defaultMaxDepth), m_rouletteDepth(CPUPathTracer::defaultRouletteDepth), m_blueNoise(false), m_blueNoiseTexture(0),
+	  m_adaptiveThreshold(0.f), m_view(View::Color), m_iterationCount(0),
+	  m_samplesPerPass(1), m_targetPassTime(0.0), m_passTime(0.0), m_timerQueriesIssued(0), m_timerQueriesRead(0), m_backend(Backend::Fragment), m_wavefront(nullptr), m_tiled(nullptr), m_cpuPathTracer(nullptr),
+	  m_tileSize(TiledPathTracer::defaultTileSize), m_tileOrder(TiledPathTracer::Order::Hilbert), m_tilesPerDispatch(TiledPathTracer::defaultTilesPerDispatch), m_tileProfiling(false),
+	  m_denoiser(nullptr), m_denoiseIterations(0),
+	  m_reprojection(false), m_reprojectProgram("src/shaders/pathtracer/pathtracer.vert.glsl", "src/shaders/pathtracer/reproject.frag.glsl"), m_viewChanged(false), m_gbuffer(nullptr),
+	  m_interactionScale(1), m_interacting(false), m_previewAccumulation(nullptr), m_visibility(nullptr)
 {
-	// Framebuffer
-	glGenFramebuffers(1, &m_fbo);
-	glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
-
-	glActiveTexture(ACCUMULATION_TEXTURE);
-	glGenTextures(1, &m_accumulationTexture);
-	glBindTexture(GL_TEXTURE_2D, m_accumulationTexture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, camera->m_resolution.x, camera->m_resolution.y, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_accumulationTexture, 0);
-
-	GLenum drawBuffers[1] = {GL_COLOR_ATTACHMENT0};
-	glDrawBuffers(1, drawBuffers);
-
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glGenQueries(timerQueryCount, m_timerQueries);
 
 	// Vertices
 	glActiveTexture(VERTICES_TEXTURE);
@@ -47,6 +52,15 @@ Renderer::Renderer(const ShaderProgram& program, const ShaderProgram& postProgra
 	glBindTexture(GL_TEXTURE_BUFFER, m_indicesTexture);
 	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32UI, m_indicesBuffer);
 
+	// Triangle Records
+	glActiveTexture(TRIANGLE_TEXTURE);
+	glGenBuffers(1, &m_triangleBuffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, m_triangleBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(Scene::TriangleRecord) * scene->m_triangles.size(), scene->m_triangles.data(), GL_STATIC_DRAW);
+	glGenTextures(1, &m_triangleTexture);
+	glBindTexture(GL_TEXTURE_BUFFER, m_triangleTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGB32F, m_triangleBuffer);
+
 	// Vertex Data
 	glActiveTexture(VERTEX_DATA_TEXTURE);
 	glGenBuffers(1, &m_vertexDataBuffer);
@@ -66,13 +80,10 @@ Renderer::Renderer(const ShaderProgram& program, const ShaderProgram& postProgra
 	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_lightBuffer);
 
 	// Materials
-	glActiveTexture(MATERIAL_TEXTURE);
 	glGenBuffers(1, &m_materialBuffer);
-	glBindBuffer(GL_TEXTURE_BUFFER, m_materialBuffer);
-	glBufferData(GL_TEXTURE_BUFFER, sizeof(Scene::Material) * scene->m_materials.size(), &scene->m_materials[0], GL_STATIC_DRAW);
-	glGenTextures(1, &m_materialTexture);
-	glBindTexture(GL_TEXTURE_BUFFER, m_materialTexture);
-	glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, m_materialBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_materialBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(MaterialRecord) * scene->m_materialRecords.size(), scene->m_materialRecords.data(), GL_STATIC_DRAW);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BINDING, m_materialBuffer);
 
 	glActiveTexture(MATERIAL_MAP_TEXTURE);
 	glGenBuffers(1, &m_materialMapBuffer);
@@ -82,6 +93,32 @@ Renderer::Renderer(const ShaderProgram& program, const ShaderProgram& postProgra
 	glBindTexture(GL_TEXTURE_BUFFER, m_materialMapTexture);
 	glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, m_materialMapBuffer);
 
+	// BVH
+	glActiveTexture(BVH_TEXTURE);
+	glGenBuffers(1, &m_bvhBuffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, m_bvhBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(BVH::Node) * scene->m_blasNodes.size(), scene->m_blasNodes.data(), GL_STATIC_DRAW);
+	glGenTextures(1, &m_bvhTexture);
+	glBindTexture(GL_TEXTURE_BUFFER, m_bvhTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32UI, m_bvhBuffer);
+
+	glActiveTexture(TLAS_TEXTURE);
+	glGenBuffers(1, &m_tlasBuffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, m_tlasBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(BVH::Node) * scene->m_tlas.m_nodes.size(), scene->m_tlas.m_nodes.data(), GL_STATIC_DRAW);
+	glGenTextures(1, &m_tlasTexture);
+	glBindTexture(GL_TEXTURE_BUFFER, m_tlasTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32UI, m_tlasBuffer);
+
+	// Instances
+	glActiveTexture(INSTANCE_TEXTURE);
+	glGenBuffers(1, &m_instanceBuffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, m_instanceBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(Scene::Instance) * scene->m_instances.size(), scene->m_instances.data(), GL_STATIC_DRAW);
+	glGenTextures(1, &m_instanceTexture);
+	glBindTexture(GL_TEXTURE_BUFFER, m_instanceTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32UI, m_instanceBuffer);
+
 	// Uniforms
 	m_uEye = glGetUniformLocation(program.m_id, "eye");
     m_uForward = glGetUniformLocation(program.m_id, "forward");
@@ -89,22 +126,34 @@ Renderer::Renderer(const ShaderProgram& program, const ShaderProgram& postProgra
     m_uRight = glGetUniformLocation(program.m_id, "right");
     m_uResolution = glGetUniformLocation(program.m_id, "resolution");
 
-	glUseProgram(program.m_id);
-	glUniform1ui(glGetUniformLocation(program.m_id, "indexCount"), scene->m_indices.size());
-	glUniform1i(glGetUniformLocation(program.m_id, "verticesTex"), VERTICES_TEXTURE - GL_TEXTURE0);
-    glUniform1i(glGetUniformLocation(program.m_id, "indicesTex"), INDICES_TEXTURE - GL_TEXTURE0);
-    glUniform1i(glGetUniformLocation(program.m_id, "vertexDataTex"), VERTEX_DATA_TEXTURE - GL_TEXTURE0);
+	setSceneUniforms(program);
 
-    glUniform1i(glGetUniformLocation(program.m_id, "accumTexture"), ACCUMULATION_TEXTURE - GL_TEXTURE0);
+    glUseProgram(m_errorProgram.m_id);
+    glUniform1i(glGetUniformLocation(m_errorProgram.m_id, "accumTexture"), ACCUMULATION_TEXTURE - GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(m_errorProgram.m_id, "sampleCountTexture"), SAMPLE_COUNT_TEXTURE - GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(m_errorProgram.m_id, "momentTexture"), MOMENT_TEXTURE - GL_TEXTURE0);
 
-    glUniform1i(glGetUniformLocation(program.m_id, "lightTex"), LIGHT_TEXTURE - GL_TEXTURE0);
-    glUniform4uiv(glGetUniformLocation(program.m_id, "lightCount"), 1, &scene->m_lightCount[0]);
+    glUseProgram(m_noiseProgram.m_id);
+    glUniform1i(glGetUniformLocation(m_noiseProgram.m_id, "accumTexture"), ACCUMULATION_TEXTURE - GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(m_noiseProgram.m_id, "errorTexture"), ERROR_TEXTURE - GL_TEXTURE0);
 
-    glUniform1i(glGetUniformLocation(program.m_id, "materialTex"), MATERIAL_TEXTURE - GL_TEXTURE0);
-    glUniform1i(glGetUniformLocation(program.m_id, "materialMapTex"), MATERIAL_MAP_TEXTURE - GL_TEXTURE0);
+    glGenTextures(1, &m_noiseTexture);
+    glBindTexture(GL_TEXTURE_2D, m_noiseTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, 1, 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glUseProgram(m_reprojectProgram.m_id);
+    glUniform1i(glGetUniformLocation(m_reprojectProgram.m_id, "positionTexture"), POSITION_TEXTURE - GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(m_reprojectProgram.m_id, "normalTexture"), NORMAL_TEXTURE - GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(m_reprojectProgram.m_id, "previousPositionTexture"), PREVIOUS_POSITION_TEXTURE - GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(m_reprojectProgram.m_id, "previousNormalTexture"), PREVIOUS_NORMAL_TEXTURE - GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(m_reprojectProgram.m_id, "accumTexture"), ACCUMULATION_TEXTURE - GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(m_reprojectProgram.m_id, "sampleCountTexture"), SAMPLE_COUNT_TEXTURE - GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(m_reprojectProgram.m_id, "momentTexture"), MOMENT_TEXTURE - GL_TEXTURE0);
 
     glUseProgram(m_postProgram.m_id);
     glUniform1i(glGetUniformLocation(postProgram.m_id, "inTexture"), ACCUMULATION_TEXTURE - GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(postProgram.m_id, "errorTexture"), ERROR_TEXTURE - GL_TEXTURE0);
 
     glUseProgram(0);
 
@@ -113,37 +162,266 @@ Renderer::Renderer(const ShaderProgram& program, const ShaderProgram& postProgra
 
 Renderer::~Renderer()
 {
+	delete m_wavefront;
+	delete m_tiled;
+	delete m_cpuPathTracer;
+	delete m_denoiser;
+	delete m_gbuffer;
+	delete m_previewAccumulation;
+	delete m_visibility;
+
+	glDeleteQueries(timerQueryCount, m_timerQueries);
+
 	glDeleteTextures(1, &m_verticesTexture);
 	glDeleteTextures(1, &m_indicesTexture);
-	glDeleteTextures(1, &m_accumulationTexture);
+	glDeleteTextures(1, &m_bvhTexture);
+	glDeleteTextures(1, &m_tlasTexture);
+	glDeleteTextures(1, &m_instanceTexture);
+	glDeleteTextures(1, &m_triangleTexture);
+	glDeleteTextures(1, &m_blueNoiseTexture);
+	glDeleteTextures(1, &m_noiseTexture);
 
 	glDeleteBuffers(1, &m_verticesBuffer);
 	glDeleteBuffers(1, &m_indicesBuffer);
+	glDeleteBuffers(1, &m_bvhBuffer);
+	glDeleteBuffers(1, &m_tlasBuffer);
+	glDeleteBuffers(1, &m_instanceBuffer);
+	glDeleteBuffers(1, &m_triangleBuffer);
+	glDeleteBuffers(1, &m_materialBuffer);
 }
 
 void Renderer::draw()
 {
-	// Accumulation
+	accumulate();
+	present();
+}
 
-	glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+// Binds the front accumulation target and the error map to their texture units
+static void bindAccumulation(const AccumulationBuffer& accumulation)
+{
+	const AccumulationBuffer::Target& front = accumulation.getFront();
 
-	glUseProgram(m_program.m_id);
+	glActiveTexture(ACCUMULATION_TEXTURE);
+	glBindTexture(GL_TEXTURE_2D, front.colorTexture);
+	glActiveTexture(SAMPLE_COUNT_TEXTURE);
+	glBindTexture(GL_TEXTURE_2D, front.sampleCountTexture);
+	glActiveTexture(MOMENT_TEXTURE);
+	glBindTexture(GL_TEXTURE_2D, front.momentTexture);
+	glActiveTexture(ERROR_TEXTURE);
+	glBindTexture(GL_TEXTURE_2D, accumulation.getErrorTexture());
+}
 
-	glUniform1ui(glGetUniformLocation(m_program.m_id, "iterationCount"), m_iterationCount);
-	m_iterationCount++;
+// Every backend reads the front accumulation target and writes the back one
+// Pixels of the tiles the error map marks as converged are carried over by the GPU backends without tracing them
+void Renderer::accumulate()
+{
+	updateInteraction();
+	if (!m_interacting)
+	{
+		updateView();
+	}
 
-	glDrawArrays(GL_TRIANGLES, 0, 3);
+	AccumulationBuffer& accumulation = getActiveAccumulation();
+	const AccumulationBuffer::Target& back = accumulation.getBack();
+	glm::uvec2 resolution = getRenderResolution();
+
+	bindAccumulation(accumulation);
+
+	// The oldest query is waited for only once every query of the ring is in flight
+	readTimerQueries(m_timerQueriesIssued - m_timerQueriesRead == timerQueryCount);
+
+	uint samples = m_samplesPerPass;
+	int slot = m_timerQueriesIssued % timerQueryCount;
+
+	switch (m_backend)
+	{
+	case Backend::Fragment:
+	case Backend::Tiled:
+	{
+		glBeginQuery(GL_TIME_ELAPSED, m_timerQueries[slot]);
+
+		// The visibility buffer holds one camera ray per pixel, so every sample becomes a pass of its own
+		uint passes = m_visibility ? samples : 1;
+		for (uint pass = 0; pass < passes; ++pass)
+		{
+			glm::vec2 jitter = VisibilityBuffer::jitter(m_iterationCount + pass);
+			if (m_visibility)
+			{
+				if (pass > 0)
+				{
+					accumulation.swap();
+					bindAccumulation(accumulation);
+				}
+
+				m_visibility->draw(resolution, jitter);
+				glActiveTexture(VISIBILITY_TEXTURE);
+				glBindTexture(GL_TEXTURE_2D, m_visibility->getTexture());
+			}
+
+			const ShaderProgram& program = m_tiled ? m_tiled->m_program : m_program;
+			glUseProgram(program.m_id);
+
+			glUniform1ui(glGetUniformLocation(program.m_id, "samplesPerPass"), samples / passes);
+			glUniform2fv(glGetUniformLocation(program.m_id, "primaryJitter"), 1, &jitter[0]);
+
+			if (m_tiled)
+			{
+				m_tiled->trace(resolution, accumulation);
+				continue;
+			}
+
+			glBindFramebuffer(GL_FRAMEBUFFER, accumulation.getBack().fbo);
+			glViewport(0, 0, resolution.x, resolution.y);
+
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		glEndQuery(GL_TIME_ELAPSED);
+		m_timerQuerySamples[slot] = samples;
+		m_timerQueriesIssued++;
+		break;
+	}
+	case Backend::Wavefront:
+		glBeginQuery(GL_TIME_ELAPSED, m_timerQueries[slot]);
+
+		m_wavefront->trace(samples, m_maxDepth, accumulation);
+
+		glEndQuery(GL_TIME_ELAPSED);
+		m_timerQuerySamples[slot] = samples;
+		m_timerQueriesIssued++;
+		break;
+	case Backend::CPU:
+	{
+		// The CPU is timed directly, the GPU only sees the upload
+		Timer timer;
+		m_cpuPathTracer->trace(m_iterationCount, samples);
+		updateSamplesPerPass(timer.getElapsedMilliseconds(), samples);
+
+		// Show the film through the accumulation target, every pixel has the same number of samples
+		uint32_t sampleCount = m_iterationCount + samples;
+		glTextureSubImage2D(back.colorTexture, 0, 0, 0, resolution.x, resolution.y, GL_RGBA, GL_FLOAT, m_cpuPathTracer->m_film.data());
+		glClearTexImage(back.sampleCountTexture, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &sampleCount);
+		glTextureSubImage2D(back.momentTexture, 0, 0, 0, resolution.x, resolution.y, GL_RED, GL_FLOAT, m_cpuPathTracer->m_moments.data());
+		break;
+	}
+	}
+	m_iterationCount += samples;
+	accumulation.swap();
+
+	if (m_adaptiveThreshold > 0.f || m_view == View::Error)
+	{
+		computeError(accumulation);
+	}
+}
+
+// Updates the error map from the front accumulation target, for the next pass and the error view
+void Renderer::computeError(const AccumulationBuffer& accumulation) const
+{
+	bindAccumulation(accumulation);
+
+	glm::uvec2 tiles = accumulation.getErrorResolution();
+	glBindImageTexture(0, accumulation.getErrorTexture(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32F);
+
+	glUseProgram(m_errorProgram.m_id);
+	glDispatchCompute(tiles.x, tiles.y, 1);
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+	glUseProgram(0);
+}
+
+// Feeds the controller with the timing of every finished pass, in order
+void Renderer::readTimerQueries(bool waitForOldest)
+{
+	while (m_timerQueriesRead < m_timerQueriesIssued)
+	{
+		int slot = m_timerQueriesRead % timerQueryCount;
+
+		if (!waitForOldest)
+		{
+			GLuint available = GL_FALSE;
+			glGetQueryObjectuiv(m_timerQueries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) break;
+		}
+		waitForOldest = false;
+
+		GLuint64 elapsed;
+		glGetQueryObjectui64v(m_timerQueries[slot], GL_QUERY_RESULT, &elapsed);
+		m_timerQueriesRead++;
+		updateSamplesPerPass(elapsed * 1e-6, m_timerQuerySamples[slot]);
+	}
+}
+
+// Scales the samples per pass by how far a pass of [samples] samples taking [passTime] ms was from the target
+void Renderer::updateSamplesPerPass(double passTime, uint samples)
+{
+	m_passTime = passTime;
+	if (m_targetPassTime <= 0.0 || passTime <= 0.0) return;
+
+	double samplesForTarget = m_targetPassTime * samples / passTime;
+
+	// At most halve or double per measurement so one noisy pass cannot swing the budget
+	samplesForTarget = glm::clamp(samplesForTarget, 0.5 * m_samplesPerPass, 2.0 * m_samplesPerPass);
+	m_samplesPerPass = glm::clamp(uint(std::round(samplesForTarget)), 1u, maxSamplesPerPass);
+}
+
+// Blocks until the GPU has passed [sync]
+static void waitSync(GLsync sync)
+{
+	while (glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED);
+}
+
+uint Renderer::accumulateFor(double seconds, uint maxSamples)
+{
+	Timer timer;
+	uint passes = 0;
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	// At most one pass is queued behind the running one, so the timer follows the GPU rather than the command queue
+	GLsync previous = nullptr;
+	do
+	{
+		accumulate();
+		passes++;
 
-	// Output
+		GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		if (previous)
+		{
+			waitSync(previous);
+			glDeleteSync(previous);
+		}
+		previous = fence;
+	} while (timer.getElapsedSeconds() < seconds && m_iterationCount < maxSamples);
+	glDeleteSync(previous);
+
+	return passes;
+}
+
+void Renderer::present()
+{
+	const AccumulationBuffer& accumulation = getActiveAccumulation();
+
+	// The denoiser draws to its own targets before the bound framebuffer is cleared
+	GLuint image = accumulation.getFront().colorTexture;
+	if (!m_interacting)
+	{
+		updateView();
+		if (m_denoiser)
+		{
+			image = m_denoiser->denoise(m_accumulation, *m_gbuffer, m_denoiseIterations);
+		}
+	}
 
 	glViewport(0, 0, m_camera->m_resolution.x, m_camera->m_resolution.y);
 	glClear(GL_COLOR_BUFFER_BIT);
 
 	glUseProgram(m_postProgram.m_id);
+	glUniform1i(glGetUniformLocation(m_postProgram.m_id, "view"), int(m_view));
+	glUniform1f(glGetUniformLocation(m_postProgram.m_id, "adaptiveThreshold"), m_adaptiveThreshold);
+	glUniform1i(glGetUniformLocation(m_postProgram.m_id, "upscale"), m_interacting);
+	bindAccumulation(accumulation);
 	glActiveTexture(ACCUMULATION_TEXTURE);
-	glBindTexture(GL_TEXTURE_2D, m_accumulationTexture);
+	glBindTexture(GL_TEXTURE_2D, image);
 	glDrawArrays(GL_TRIANGLES, 0, 3);
 
 	glUseProgram(0);
@@ -152,6 +430,18 @@ void Renderer::draw()
 void Renderer::reset()
 {
 	m_iterationCount = 0;
+	m_accumulation.clear();
+	if (m_previewAccumulation)
+	{
+		m_previewAccumulation->clear();
+	}
+
+	// Nothing is left to reproject, the G-buffer has to show the current view again
+	if (m_viewChanged)
+	{
+		m_gbuffer->invalidate();
+		m_viewChanged = false;
+	}
 
 	glViewport(0, 0, m_camera->m_resolution.x, m_camera->m_resolution.y);
 	glClear(GL_COLOR_BUFFER_BIT);
@@ -161,42 +451,614 @@ void Renderer::resize(const glm::uvec2& resolution)
 {
 	m_camera->m_resolution = resolution;
 
-	// Recreate the accumulation texture
-	glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+	m_accumulation.resize(resolution);
+	if (m_previewAccumulation)
+	{
+		m_previewAccumulation->resize(getPreviewResolution());
+	}
 
-	glActiveTexture(ACCUMULATION_TEXTURE);
-	glGenTextures(1, &m_accumulationTexture);
-	glBindTexture(GL_TEXTURE_2D, m_accumulationTexture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, resolution.x, resolution.y, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	// The wavefront path state covers the full resolution, the preview only uses part of it
+	if (m_wavefront)
+	{
+		m_wavefront->resize(resolution);
+	}
+	if (m_cpuPathTracer)
+	{
+		m_cpuPathTracer->resize(getRenderResolution());
+	}
+	if (m_denoiser)
+	{
+		m_denoiser->resize(resolution);
+	}
+	if (m_gbuffer)
+	{
+		m_gbuffer->resize(resolution);
+	}
+	if (m_visibility)
+	{
+		m_visibility->resize(resolution);
+	}
+	m_viewChanged = false;
 
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_accumulationTexture, 0);
+	// Update the shaders' stored resolution
+	setCameraUniforms();
 
-	GLenum drawBuffers[1] = {GL_COLOR_ATTACHMENT0};
-	glDrawBuffers(1, drawBuffers);
+	reset();
+}
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+void Renderer::updateCamera()
+{
+	m_camera->update();
+	setCameraUniforms();
+
+	// Every move restarts the preview, the full resolution accumulation is restarted or reprojected below
+	if (m_previewAccumulation)
+	{
+		m_lastCameraMove = std::chrono::steady_clock::now();
+		m_previewAccumulation->clear();
+		m_iterationCount = 0;
+	}
+
+	// Reprojected once the next pass or present needs it, so several moves in between only cost one
+	if (m_reprojection && m_backend != Backend::CPU && m_gbuffer && m_gbuffer->isValid())
+	{
+		m_viewChanged = true;
+		return;
+	}
+
+	if (m_gbuffer)
+	{
+		m_gbuffer->invalidate();
+	}
+    reset();
+}
+
+// Brings the G-buffer, and with reprojection the accumulation, to the current view
+void Renderer::updateView()
+{
+	if (!m_gbuffer || (m_gbuffer->isValid() && !m_viewChanged)) return;
+
+	m_gbuffer->draw(*m_camera);
+	if (m_viewChanged)
+	{
+		reproject();
+		m_viewChanged = false;
+	}
+}
+
+// Resamples the front accumulation target, taken from the G-buffer's previous view, into the back target for its front view
+// The error map is unknown again until the next pass, the pixels' sample counts carry over
+void Renderer::reproject()
+{
+	const GBuffer::Target& view = m_gbuffer->getFront();
+	const GBuffer::Target& previous = m_gbuffer->getPrevious();
+
+	GLint framebuffer;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+
+	bindAccumulation(m_accumulation);
+	glActiveTexture(POSITION_TEXTURE);
+	glBindTexture(GL_TEXTURE_2D, view.positionTexture);
+	glActiveTexture(NORMAL_TEXTURE);
+	glBindTexture(GL_TEXTURE_2D, view.normalTexture);
+	glActiveTexture(PREVIOUS_POSITION_TEXTURE);
+	glBindTexture(GL_TEXTURE_2D, previous.positionTexture);
+	glActiveTexture(PREVIOUS_NORMAL_TEXTURE);
+	glBindTexture(GL_TEXTURE_2D, previous.normalTexture);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_accumulation.getBack().fbo);
+	glViewport(0, 0, m_camera->m_resolution.x, m_camera->m_resolution.y);
+
+	glUseProgram(m_reprojectProgram.m_id);
+	glUniform3fv(glGetUniformLocation(m_reprojectProgram.m_id, "previousEye"), 1, &previous.eye[0]);
+	glUniform3fv(glGetUniformLocation(m_reprojectProgram.m_id, "previousForward"), 1, &previous.forward[0]);
+	glUniform3fv(glGetUniformLocation(m_reprojectProgram.m_id, "previousUp"), 1, &previous.up[0]);
+	glUniform3fv(glGetUniformLocation(m_reprojectProgram.m_id, "previousRight"), 1, &previous.right[0]);
+	glUniform2uiv(glGetUniformLocation(m_reprojectProgram.m_id, "resolution"), 1, &m_camera->m_resolution[0]);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
 
-	// Update the shader's stored resolution
-	glUseProgram(m_program.m_id);
-	glUniform2uiv(m_uResolution, 1, &m_camera->m_resolution[0]);
 	glUseProgram(0);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+	m_accumulation.swap();
+	m_accumulation.clearError();
+	m_iterationCount = 0;
+}
+
+// Enters the preview while the camera moves and leaves it once the camera rested long enough
+void Renderer::updateInteraction()
+{
+	std::chrono::duration<double> sinceMove = std::chrono::steady_clock::now() - m_lastCameraMove;
+	setInteracting(m_previewAccumulation && sinceMove.count() < interactionIdleTime);
+}
+
+// Switches the passes between the preview and the full resolution accumulation, both have been restarted since the camera moved
+void Renderer::setInteracting(bool interacting)
+{
+	if (interacting == m_interacting) return;
+
+	m_interacting = interacting;
+	m_iterationCount = 0;
+
+	// The CPU film is restarted at the new resolution, its accumulation was restarted by the move
+	if (m_cpuPathTracer)
+	{
+		m_cpuPathTracer->resize(getRenderResolution());
+	}
+	setCameraUniforms();
+}
+
+glm::uvec2 Renderer::getPreviewResolution() const
+{
+	return (m_camera->m_resolution + glm::uvec2(m_interactionScale - 1)) / glm::uvec2(m_interactionScale);
+}
+
+glm::uvec2 Renderer::getRenderResolution() const
+{
+	return m_interacting ? getPreviewResolution() : m_camera->m_resolution;
+}
+
+AccumulationBuffer& Renderer::getActiveAccumulation()
+{
+	return m_interacting ? *m_previewAccumulation : m_accumulation;
+}
+
+// Creates the G-buffer while the denoiser or reprojection need it, returns false if it could not be compiled
+bool Renderer::updateGBuffer()
+{
+	bool needed = m_denoiser || m_reprojection;
+	if (needed && !m_gbuffer)
+	{
+		GBuffer* gbuffer = new GBuffer(m_camera->m_resolution);
+		if (!gbuffer->isCompiled())
+		{
+			std::cout << "Could not compile the G-buffer" << std::endl;
+			delete gbuffer;
+			return false;
+		}
+
+		m_gbuffer = gbuffer;
+		setProgramUniforms();
+		setCameraUniforms();
+	}
+	else if (!needed && m_gbuffer)
+	{
+		delete m_gbuffer;
+		m_gbuffer = nullptr;
+	}
+
+	return true;
+}
+
+// Switches the path tracing backend, restarting the accumulation
+void Renderer::setBackend(Backend backend)
+{
+	if (backend == m_backend) return;
+
+	Wavefront* wavefront = nullptr;
+	if (backend == Backend::Wavefront)
+	{
+		wavefront = new Wavefront(m_camera->m_resolution);
+		if (!wavefront->isCompiled())
+		{
+			std::cout << "Could not compile the wavefront path tracer" << std::endl;
+			delete wavefront;
+			return;
+		}
+
+		for (const ShaderProgram* program : wavefront->getPrograms())
+		{
+			setSceneUniforms(*program);
+		}
+	}
+
+	TiledPathTracer* tiled = nullptr;
+	if (backend == Backend::Tiled)
+	{
+		tiled = new TiledPathTracer();
+		if (!tiled->isCompiled())
+		{
+			std::cout << "Could not compile the tiled path tracer" << std::endl;
+			delete tiled;
+			return;
+		}
+
+		tiled->setTileSize(m_tileSize);
+		tiled->setOrder(m_tileOrder);
+		tiled->setTilesPerDispatch(m_tilesPerDispatch);
+		tiled->setProfiling(m_tileProfiling);
+		setSceneUniforms(tiled->m_program);
+	}
+
+	delete m_wavefront;
+	m_wavefront = wavefront;
+
+	delete m_tiled;
+	m_tiled = tiled;
+
+	delete m_cpuPathTracer;
+	m_cpuPathTracer = backend == Backend::CPU ? new CPUPathTracer(m_scene, m_camera) : nullptr;
+	if (m_cpuPathTracer)
+	{
+		m_cpuPathTracer->resize(getRenderResolution());
+		m_cpuPathTracer->setPathDepth(m_maxDepth, m_rouletteDepth);
+		if (m_blueNoise) m_cpuPathTracer->setBlueNoise(&m_blueNoiseTile);
+	}
+
+	m_backend = backend;
 
+	setCameraUniforms();
 	reset();
 }
 
-void Renderer::updateCamera()
+Renderer::Backend Renderer::getBackend() const
 {
-	m_camera->update();
+	return m_backend;
+}
+
+// Switches the storage of the running mean, restarting the accumulation
+void Renderer::setAccumulationFormat(AccumulationBuffer::Format format)
+{
+	m_accumulation.setFormat(format);
+	if (m_previewAccumulation)
+	{
+		m_previewAccumulation->setFormat(format);
+	}
+	reset();
+}
+
+void Renderer::setPathDepth(uint maxDepth, uint rouletteDepth)
+{
+	m_maxDepth = std::max(1u, maxDepth);
+	m_rouletteDepth = rouletteDepth;
+
+	setProgramUniforms();
+	if (m_cpuPathTracer)
+	{
+		m_cpuPathTracer->setPathDepth(m_maxDepth, m_rouletteDepth);
+	}
+
+	reset();
+}
+
+void Renderer::setBlueNoise(bool enabled)
+{
+	if (enabled == m_blueNoise) return;
+
+	if (enabled && !m_blueNoiseTexture)
+	{
+		m_blueNoiseTile = blueNoiseTile();
+
+		glActiveTexture(BLUE_NOISE_TEXTURE);
+		glGenTextures(1, &m_blueNoiseTexture);
+		glBindTexture(GL_TEXTURE_2D, m_blueNoiseTexture);
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_R16UI, BLUE_NOISE_SIZE, BLUE_NOISE_SIZE);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, BLUE_NOISE_SIZE, BLUE_NOISE_SIZE, GL_RED_INTEGER, GL_UNSIGNED_SHORT, m_blueNoiseTile.data());
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	}
+
+	m_blueNoise = enabled;
+
+	setProgramUniforms();
+	if (m_cpuPathTracer)
+	{
+		m_cpuPathTracer->setBlueNoise(enabled ? &m_blueNoiseTile : nullptr);
+	}
+
+	reset();
+}
+
+bool Renderer::getBlueNoise() const
+{
+	return m_blueNoise;
+}
+
+void Renderer::setAdaptiveThreshold(float threshold)
+{
+	m_adaptiveThreshold = std::max(0.f, threshold);
+
+	setProgramUniforms();
+	reset();
+}
+
+float Renderer::getAdaptiveThreshold() const
+{
+	return m_adaptiveThreshold;
+}
+
+// The error map is only kept up to date while adaptive sampling or the error view need it
+void Renderer::setView(View view)
+{
+	if (view == View::Error && m_view != View::Error)
+	{
+		computeError(getActiveAccumulation());
+	}
+	m_view = view;
+}
+
+Renderer::View Renderer::getView() const
+{
+	return m_view;
+}
+
+void Renderer::setDenoiseIterations(uint iterations)
+{
+	iterations = std::min(iterations, Denoiser::maxIterations);
+
+	if (iterations > 0 && !m_denoiser)
+	{
+		Denoiser* denoiser = new Denoiser(m_camera->m_resolution);
+		if (!denoiser->isCompiled())
+		{
+			std::cout << "Could not compile the denoiser" << std::endl;
+			delete denoiser;
+			return;
+		}
+
+		m_denoiser = denoiser;
+		if (!updateGBuffer())
+		{
+			delete m_denoiser;
+			m_denoiser = nullptr;
+			return;
+		}
+	}
+	else if (iterations == 0)
+	{
+		delete m_denoiser;
+		m_denoiser = nullptr;
+		updateGBuffer();
+	}
+
+	m_denoiseIterations = iterations;
+}
+
+uint Renderer::getDenoiseIterations() const
+{
+	return m_denoiseIterations;
+}
+
+std::vector<double> Renderer::getDenoiseTimes() const
+{
+	return m_denoiser ? m_denoiser->getIterationTimes() : std::vector<double>();
+}
+
+void Renderer::setReprojection(bool enabled)
+{
+	// The last move can no longer be reprojected
+	if (!enabled && m_viewChanged)
+	{
+		reset();
+	}
+
+	bool previous = m_reprojection;
+	m_reprojection = enabled;
+	if (!updateGBuffer())
+	{
+		m_reprojection = previous;
+	}
+}
+
+bool Renderer::getReprojection() const
+{
+	return m_reprojection;
+}
+
+void Renderer::setInteractionScale(uint scale)
+{
+	scale = std::max(scale, 1u);
+	if (scale == m_interactionScale) return;
+
+	setInteracting(false);
+	m_interactionScale = scale;
+
+	delete m_previewAccumulation;
+	m_previewAccumulation = scale > 1 ? new AccumulationBuffer(getPreviewResolution(), m_accumulation.getFormat()) : nullptr;
+}
+
+uint Renderer::getInteractionScale() const
+{
+	return m_interactionScale;
+}
+
+void Renderer::setRasterPrimary(bool enabled)
+{
+	if (enabled == (m_visibility != nullptr)) return;
+
+	VisibilityBuffer* visibility = nullptr;
+	if (enabled)
+	{
+		visibility = new VisibilityBuffer(m_scene, m_camera->m_resolution);
+		if (!visibility->isCompiled())
+		{
+			std::cout << "Could not compile the visibility buffer" << std::endl;
+			delete visibility;
+			return;
+		}
+	}
+
+	delete m_visibility;
+	m_visibility = visibility;
+
+	setProgramUniforms();
+	setCameraUniforms();
+	reset();
+}
+
+bool Renderer::getRasterPrimary() const
+{
+	return m_visibility != nullptr;
+}
+
+void Renderer::setTiling(uint size, TiledPathTracer::Order order, uint tilesPerDispatch)
+{
+	m_tileSize = size;
+	m_tileOrder = order;
+	m_tilesPerDispatch = tilesPerDispatch;
+
+	if (m_tiled)
+	{
+		m_tiled->setTileSize(m_tileSize);
+		m_tiled->setOrder(m_tileOrder);
+		m_tiled->setTilesPerDispatch(m_tilesPerDispatch);
+	}
+}
+
+bool Renderer::setTileProfiling(bool enabled)
+{
+	if (enabled && !TiledPathTracer::canProfile()) return false;
 
-	glUseProgram(m_program.m_id);
-    glUniform3fv(m_uEye, 1, &m_camera->m_eye[0]);
-    glUniform3fv(m_uForward, 1, &m_camera->m_forward[0]);
-    glUniform3fv(m_uUp, 1, &m_camera->m_up[0]);
-    glUniform3fv(m_uRight, 1, &m_camera->m_right[0]);
-    glUniform2uiv(m_uResolution, 1, &m_camera->m_resolution[0]);
+	m_tileProfiling = enabled;
+	if (m_tiled)
+	{
+		m_tiled->setProfiling(enabled);
+	}
+
+	return true;
+}
+
+std::vector<uint64_t> Renderer::getTileTimes(glm::uvec2& tiles) const
+{
+	tiles = m_tiled ? m_tiled->getTileCount() : glm::uvec2(0);
+	return m_tiled ? m_tiled->getTileTimes() : std::vector<uint64_t>();
+}
+
+void Renderer::setTargetPassTime(double milliseconds)
+{
+	m_targetPassTime = milliseconds;
+}
+
+uint Renderer::getSamplesPerPass() const
+{
+	return m_samplesPerPass;
+}
+
+double Renderer::getPassTime() const
+{
+	return m_passTime;
+}
+
+uint Renderer::getSampleCount() const
+{
+	return m_iterationCount;
+}
+
+float Renderer::estimateNoise() const
+{
+	computeError(m_accumulation);
+
+	glBindImageTexture(0, m_noiseTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+	glUseProgram(m_noiseProgram.m_id);
+	glDispatchCompute(1, 1, 1);
+	glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+	glUseProgram(0);
+
+	float noise;
+	glBindTexture(GL_TEXTURE_2D, m_noiseTexture);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_FLOAT, &noise);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// A single pixel without an error estimate outweighs the rest of the image
+	float pixels = float(m_camera->m_resolution.x) * m_camera->m_resolution.y;
+	return noise * pixels >= 0.5f * UNKNOWN_ERROR ? std::numeric_limits<float>::infinity() : noise;
+}
+
+void Renderer::readAccumulation(std::vector<glm::vec4>& pixels) const
+{
+	m_accumulation.read(pixels);
+}
+
+// Points a path tracing program at the scene data
+void Renderer::setSceneUniforms(const ShaderProgram& program) const
+{
+	glUseProgram(program.m_id);
+	glUniform1ui(glGetUniformLocation(program.m_id, "instanceCount"), m_scene->m_instances.size());
+	glUniform1i(glGetUniformLocation(program.m_id, "verticesTex"), VERTICES_TEXTURE - GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(program.m_id, "indicesTex"), INDICES_TEXTURE - GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(program.m_id, "vertexDataTex"), VERTEX_DATA_TEXTURE - GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(program.m_id, "triangleTex"), TRIANGLE_TEXTURE - GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(program.m_id, "bvhTex"), BVH_TEXTURE - GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(program.m_id, "tlasTex"), TLAS_TEXTURE - GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(program.m_id, "instanceTex"), INSTANCE_TEXTURE - GL_TEXTURE0);
+
+    glUniform1i(glGetUniformLocation(program.m_id, "lightTex"), LIGHT_TEXTURE - GL_TEXTURE0);
+    glUniform4uiv(glGetUniformLocation(program.m_id, "lightCount"), 1, &m_scene->m_lightCount[0]);
+
+    glUniform1i(glGetUniformLocation(program.m_id, "materialMapTex"), MATERIAL_MAP_TEXTURE - GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(program.m_id, "blueNoiseTex"), BLUE_NOISE_TEXTURE - GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(program.m_id, "blueNoise"), m_blueNoise);
+    glUniform1ui(glGetUniformLocation(program.m_id, "maxDepth"), m_maxDepth);
+    glUniform1ui(glGetUniformLocation(program.m_id, "rouletteDepth"), m_rouletteDepth);
+    glUniform1f(glGetUniformLocation(program.m_id, "adaptiveThreshold"), m_adaptiveThreshold);
+    glUniform1i(glGetUniformLocation(program.m_id, "rasterPrimary"), m_visibility != nullptr);
+    glUniform1i(glGetUniformLocation(program.m_id, "visibilityTexture"), VISIBILITY_TEXTURE - GL_TEXTURE0);
+
+    // Front accumulation target, only read by the programs that accumulate
+    glUniform1i(glGetUniformLocation(program.m_id, "accumTexture"), ACCUMULATION_TEXTURE - GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(program.m_id, "sampleCountTexture"), SAMPLE_COUNT_TEXTURE - GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(program.m_id, "momentTexture"), MOMENT_TEXTURE - GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(program.m_id, "errorTexture"), ERROR_TEXTURE - GL_TEXTURE0);
     glUseProgram(0);
+}
 
-    reset();
+// Updates the scene uniforms of every path tracing program after a setting changed
+void Renderer::setProgramUniforms() const
+{
+	setSceneUniforms(m_program);
+	if (m_wavefront)
+	{
+		for (const ShaderProgram* program : m_wavefront->getPrograms())
+		{
+			setSceneUniforms(*program);
+		}
+	}
+	if (m_tiled)
+	{
+		setSceneUniforms(m_tiled->m_program);
+	}
+	if (m_gbuffer)
+	{
+		setSceneUniforms(m_gbuffer->m_program);
+	}
+	if (m_visibility)
+	{
+		setSceneUniforms(m_visibility->m_program);
+	}
+}
+
+// Updates the camera of every path tracing program, the uniform locations are shared through the shaders' layout qualifiers
+void Renderer::setCameraUniforms() const
+{
+	std::vector<const ShaderProgram*> programs { &m_program };
+	if (m_wavefront)
+	{
+		std::vector<const ShaderProgram*> stages = m_wavefront->getPrograms();
+		programs.insert(programs.end(), stages.begin(), stages.end());
+	}
+	if (m_tiled)
+	{
+		programs.push_back(&m_tiled->m_program);
+	}
+	if (m_gbuffer)
+	{
+		programs.push_back(&m_gbuffer->m_program);
+	}
+	if (m_visibility)
+	{
+		programs.push_back(&m_visibility->m_program);
+	}
+
+	glm::uvec2 resolution = getRenderResolution();
+	for (const ShaderProgram* program : programs)
+	{
+		glUseProgram(program->m_id);
+		glUniform3fv(m_uEye, 1, &m_camera->m_eye[0]);
+		glUniform3fv(m_uForward, 1, &m_camera->m_forward[0]);
+		glUniform3fv(m_uUp, 1, &m_camera->m_up[0]);
+		glUniform3fv(m_uRight, 1, &m_camera->m_right[0]);
+		glUniform2uiv(m_uResolution, 1, &resolution[0]);
+	}
+	glUseProgram(0);
 }
@@ -8,32 +8,218 @@
 #include <scene.h>
 #include <shaderprogram.h>
 #include <camera.h>
+#include <accumulationbuffer.h>
+#include <wavefront.h>
+#include <tiledpathtracer.h>
+#include <gbuffer.h>
+#include <denoiser.h>
+#include <visibilitybuffer.h>
+#include <cpupathtracer.h>
+#include <bluenoise.h>
+
+#include <limits>
+#include <chrono>
 
 class Renderer
 {
 public:
+	enum class Backend {
+		Fragment,
+		// The fragment backend's paths in a compute shader working through the image tile by tile
+		Tiled,
+		Wavefront,
+		CPU,
+	};
+
+	// What present() shows
+	enum class View {
+		Color,
+		// Relative error of every tile as a heat map, tiles adaptive sampling skips are dimmed
+		Error,
+	};
+
 	Scene* m_scene;
 	Camera* m_camera;
 	const ShaderProgram& m_program;
 	const ShaderProgram& m_postProgram;
 
 private:
-	GLuint m_fbo;
-	GLuint m_accumulationTexture;
+	AccumulationBuffer m_accumulation;
+	// Reduces the front accumulation target to the error map, and the error map to the noise of the image
+	ShaderProgram m_errorProgram;
+	ShaderProgram m_noiseProgram;
+	// Single R32F texel written by the noise reduction
+	GLuint m_noiseTexture;
+
+	GLuint m_verticesTexture, m_indicesTexture, m_vertexDataTexture, m_lightTexture, m_materialMapTexture, m_bvhTexture, m_tlasTexture, m_instanceTexture, m_triangleTexture;
+	GLuint m_verticesBuffer,  m_indicesBuffer,  m_vertexDataBuffer,  m_lightBuffer,  m_materialMapBuffer,  m_bvhBuffer,  m_tlasBuffer,  m_instanceBuffer,  m_triangleBuffer;
+
+	GLuint m_materialBuffer;
 
-	GLuint m_verticesTexture, m_indicesTexture, m_vertexDataTexture, m_lightTexture, m_materialTexture, m_materialMapTexture;
-	GLuint m_verticesBuffer,  m_indicesBuffer,  m_vertexDataBuffer,  m_lightBuffer,  m_materialBuffer,  m_materialMapBuffer;
+	uint m_maxDepth;
+	uint m_rouletteDepth;
+
+	// Shifts the sequence of every pixel by blue noise, the tile is generated the first time it is enabled
+	bool m_blueNoise;
+	std::vector<uint16_t> m_blueNoiseTile;
+	GLuint m_blueNoiseTexture;
+
+	// Relative error below which a tile stops taking samples, zero samples every pixel
+	float m_adaptiveThreshold;
+	View m_view;
 
 	GLuint m_uEye, m_uForward, m_uUp, m_uRight, m_uResolution;
 
+	// Samples taken since the last reset by the pixels that never converged
 	uint m_iterationCount;
 
+	// Samples per pixel of every accumulation pass, adapted to hold m_targetPassTime when it is set
+	static constexpr uint maxSamplesPerPass = 256;
+	static constexpr int timerQueryCount = 4;
+
+	uint m_samplesPerPass;
+	double m_targetPassTime;
+	double m_passTime;
+
+	// Ring of GL_TIME_ELAPSED queries, read back once available so the controller never stalls the GPU
+	GLuint m_timerQueries[timerQueryCount];
+	uint m_timerQuerySamples[timerQueryCount];
+	uint64_t m_timerQueriesIssued, m_timerQueriesRead;
+
+	Backend m_backend;
+
+	// Only exist while their backend is selected
+	Wavefront* m_wavefront;
+	TiledPathTracer* m_tiled;
+	CPUPathTracer* m_cpuPathTracer;
+
+	// Tiling of the tiled backend, kept while another backend is selected
+	uint m_tileSize;
+	TiledPathTracer::Order m_tileOrder;
+	uint m_tilesPerDispatch;
+	bool m_tileProfiling;
+
+	// Only exists while denoising, filters what present() shows with m_denoiseIterations iterations
+	Denoiser* m_denoiser;
+	uint m_denoiseIterations;
+
+	// Carries the accumulation over to the new view when the camera moves, instead of restarting it
+	bool m_reprojection;
+	ShaderProgram m_reprojectProgram;
+	// Set when the camera moved since the accumulation was reprojected, the next pass or present reprojects it once
+	bool m_viewChanged;
+
+	// Only exists while the denoiser or reprojection need it, its front target shows the view of the accumulation
+	GBuffer* m_gbuffer;
+
+	// While the camera moves, passes trace 1/m_interactionScale of the resolution into the preview accumulation, upscaled by present()
+	// The full resolution accumulation resumes once the camera rested for interactionIdleTime seconds
+	static constexpr double interactionIdleTime = 0.15;
+
+	uint m_interactionScale;
+	bool m_interacting;
+	std::chrono::steady_clock::time_point m_lastCameraMove;
+	// Only exists while the interaction scale is above 1
+	AccumulationBuffer* m_previewAccumulation;
+
+	// Only exists while the fragment and tiled backends start their paths from rasterized first hits
+	VisibilityBuffer* m_visibility;
+
+	void readTimerQueries(bool waitForOldest);
+	void updateSamplesPerPass(double passTime, uint samples);
+	void computeError(const AccumulationBuffer& accumulation) const;
+	bool updateGBuffer();
+	void updateView();
+	void reproject();
+	void updateInteraction();
+	void setInteracting(bool interacting);
+	glm::uvec2 getPreviewResolution() const;
+	// Resolution the passes trace, reduced while interacting
+	glm::uvec2 getRenderResolution() const;
+	// Accumulation the passes write to and present() shows
+	AccumulationBuffer& getActiveAccumulation();
+
+	void setSceneUniforms(const ShaderProgram& program) const;
+	void setProgramUniforms() const;
+	void setCameraUniforms() const;
+
 public:
 	Renderer(const ShaderProgram& program, const ShaderProgram& postProgram, Scene* scene, Camera* camera);
 	~Renderer();
 
+	// One accumulation pass followed by presenting the result
 	void draw();
+	// Adds getSamplesPerPass() samples per pixel to the accumulation
+	void accumulate();
+	// Runs accumulation passes back to back until [seconds] have passed or [maxSamples] samples per pixel were taken, returns the number of passes
+	uint accumulateFor(double seconds, uint maxSamples = std::numeric_limits<uint>::max());
+	// Tonemaps the accumulation to the bound framebuffer, denoised first if enabled
+	void present();
 	void reset();
 	void resize(const glm::uvec2& resolution);
 	void updateCamera();
+
+	void setBackend(Backend backend);
+	Backend getBackend() const;
+
+	void setAccumulationFormat(AccumulationBuffer::Format format);
+
+	// Traces at most [maxDepth] segments per path, ending paths by Russian roulette after [rouletteDepth] of them, restarting the accumulation
+	void setPathDepth(uint maxDepth, uint rouletteDepth);
+
+	// Spreads the error of low sample counts as blue noise, restarting the accumulation
+	void setBlueNoise(bool enabled);
+	bool getBlueNoise() const;
+
+	// Stops sampling the tiles whose relative standard error drops below [threshold], zero disables it, restarting the accumulation
+	void setAdaptiveThreshold(float threshold);
+	float getAdaptiveThreshold() const;
+
+	void setView(View view);
+	View getView() const;
+
+	// Filters the image before tonemapping with [iterations] A-trous iterations, zero disables the denoiser
+	// The accumulation is kept, only what present() shows changes
+	void setDenoiseIterations(uint iterations);
+	uint getDenoiseIterations() const;
+	// GPU milliseconds of every iteration of a recent filter, empty until one was measured
+	std::vector<double> getDenoiseTimes() const;
+
+	// Keeps the samples of the surfaces still in view when the camera moves, only for the GPU backends
+	// Samples carried over to a new view are capped, so shading that depends on the view fades in over a few passes
+	void setReprojection(bool enabled);
+	bool getReprojection() const;
+
+	// Traces 1/[scale] of the resolution while the camera moves and returns to the full resolution once it rests, 1 disables it
+	// The denoiser and reprojection wait for the full resolution
+	void setInteractionScale(uint scale);
+	uint getInteractionScale() const;
+
+	// Starts the paths of the fragment and tiled backends from first hits rasterized into a visibility buffer instead of tracing the camera rays
+	// Every pixel's camera ray then goes through the same offset from its center in a pass, and every sample is rasterized separately
+	// Restarts the accumulation, the wavefront and CPU backends keep tracing their camera rays
+	void setRasterPrimary(bool enabled);
+	bool getRasterPrimary() const;
+
+	// Splits the image of the tiled backend into tiles of [size] pixels square, rounded up to a multiple of TILE_GROUP_SIZE
+	// The tiles are handed out in [order], at most [tilesPerDispatch] per dispatch, zero traces all of them in one dispatch
+	void setTiling(uint size, TiledPathTracer::Order order, uint tilesPerDispatch);
+	// Records the clock cycles every tile of the tiled backend takes, returns false if the GPU cannot read its clock from shaders
+	bool setTileProfiling(bool enabled);
+	// Clock cycles of every tile summed over the passes since profiling started, rows from the bottom, with [tiles] along each axis
+	// Waits for the GPU, empty unless the tiled backend is profiling
+	std::vector<uint64_t> getTileTimes(glm::uvec2& tiles) const;
+
+	// Adapts the samples per pass so a pass takes [milliseconds], zero keeps the current count
+	void setTargetPassTime(double milliseconds);
+	uint getSamplesPerPass() const;
+	// Duration of the last measured pass in milliseconds
+	double getPassTime() const;
+	uint getSampleCount() const;
+	// Relative MSE of the accumulation averaged over the pixels, estimated from their variance on the GPU and read back
+	// Infinite until every pixel has two samples
+	float estimateNoise() const;
+
+	// Copies the running mean of every pixel, rows from the bottom, with its sample count in alpha
+	void readAccumulation(std::vector<glm::vec4>& pixels) const;
 };
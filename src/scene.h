@@ -9,6 +9,12 @@
 
 #include <tiny_obj_loader.h>
 
+#include <bvh.h>
+#include <shaders/pathtracer/material_record.h>
+#include <shaders/pathtracer/traversal.h>
+
+#include <algorithm>
+#include <map>
 #include <vector>
 #include <iostream>
 
@@ -24,17 +30,30 @@ public:
 		glm::vec3 textureCoordinates;
 	};
 
+	// Unit rectangle in the local xy plane facing +z, uploaded as ten RGBA32F texels
 	struct Light {
 		Light(glm::vec3 radiance, glm::mat4 transform)
-			: radiance(vec4(radiance, 0.f)), transform(transform)
-		{}
+			: radiance(vec4(radiance, 0.f)), transform(transform), invTransform(glm::inverse(transform))
+		{
+			glm::vec3 areaNormal = glm::cross(glm::vec3(transform[0]), glm::vec3(transform[1]));
+			float area = glm::length(areaNormal);
+
+			normal = vec4(areaNormal / area, area);
+
+			// Total power of a Lambertian emitter, averaged over the color channels
+			this->radiance.w = (radiance.r + radiance.g + radiance.b) / 3.f * area * M_PI;
+		}
 
 		Light(glm::vec3 radiance, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale)
 			: Light(radiance, glm::translate(glm::mat4(1.f), position) * glm::eulerAngleYXZ(rotation.y, rotation.x, rotation.z) * glm::scale(glm::mat4(1.f), scale))
 		{}
 
+		// [radiance, power]
 		vec4 radiance;
 		glm::mat4 transform;
+		glm::mat4 invTransform;
+		// [world normal, area]
+		vec4 normal;
 	};
 
 	struct Material {
@@ -48,19 +67,108 @@ public:
 		float ior;
 		float anisotropy;
 		float transmission;
+
+		// Converts a roughness and anisotropy to microfacet alphas along the tangent and bitangent
+		static glm::vec2 roughnessToAnisotropic(float roughness, float anisotropy)
+		{
+			glm::vec2 alpha = glm::vec2(roughness * roughness);
+
+			if (anisotropy > 0.f)
+			{
+				float aspect = std::sqrt(1.f - anisotropy * 0.9f);
+				alpha.x /= aspect;
+				alpha.y *= aspect;
+			}
+
+			return alpha;
+		}
+
+		// Packs the material into the layout read by the shaders
+		MaterialRecord pack() const
+		{
+			uint32_t flags = 0;
+			if (metallic > 0.f) flags |= MATERIAL_METALLIC;
+			if (roughness < 1.f) flags |= MATERIAL_DIELECTRIC;
+			if (transmission > 0.f) flags |= MATERIAL_TRANSMISSIVE;
+			if (anisotropy > 0.f) flags |= MATERIAL_ANISOTROPIC;
+
+			auto unorm = [](float value) {
+				return uint32_t(std::round(glm::clamp(value, 0.f, 1.f) * MATERIAL_UNORM_MAX));
+			};
+
+			MaterialRecord record;
+			record.albedo = albedo;
+			record.roughness = roughness;
+			record.alpha = roughnessToAnisotropic(roughness, anisotropy);
+			record.ior = ior;
+			record.bits =
+				(unorm(metallic) << MATERIAL_METALLIC_OFFSET)
+				| (unorm(transmission) << MATERIAL_TRANSMISSION_OFFSET)
+				| (flags << MATERIAL_FLAGS_OFFSET);
+
+			return record;
+		}
+	};
+
+	static_assert(sizeof(MaterialRecord) == 2 * sizeof(glm::vec4), "MaterialRecord must match its std430 layout");
+
+	// Triangles [triangleOffset, triangleOffset + triangleCount) of the index list, in object space
+	struct Mesh {
+		uint32_t triangleOffset;
+		uint32_t triangleCount;
+		// Root of the mesh's bottom level hierarchy in the combined node list
+		uint32_t rootNode;
+		BVH::Bounds bounds;
+	};
+
+	// Placement of a mesh in the scene, uploaded as nine RGBA32UI texels holding the bits of the matrices and the integers
+	struct Instance {
+		Instance(uint32_t mesh, uint32_t rootNode, glm::mat4 transform, int32_t material)
+			: transform(transform), invTransform(glm::inverse(transform)), mesh(mesh), rootNode(rootNode), material(material), padding(0)
+		{}
+
+		glm::mat4 transform;
+		glm::mat4 invTransform;
+		uint32_t mesh;
+		uint32_t rootNode;
+		// Overrides the mesh's per-triangle materials unless -1
+		int32_t material;
+		uint32_t padding;
+	};
+
+	// Intersection ready form of a triangle, parallel to the index list
+	struct TriangleRecord {
+		TriangleRecord(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2)
+			: v0(v0), edge1(v1 - v0), edge2(v2 - v0)
+		{}
+
+		glm::vec3 v0;
+		glm::vec3 edge1;
+		glm::vec3 edge2;
 	};
 
 	std::vector<glm::vec3> m_vertices;
 	std::vector<VertexData> m_vertexData;
 
 	std::vector<glm::vec4> m_indices;
+	std::vector<TriangleRecord> m_triangles;
+
+	std::vector<Mesh> m_meshes;
+	std::vector<Instance> m_instances;
 
 	std::vector<Light> m_lights;
 	glm::uvec4 m_lightCount;
 
 	std::vector<Material> m_materials;
+	// Shader layout of m_materials, see packMaterials()
+	std::vector<MaterialRecord> m_materialRecords;
 	std::vector<uint32_t> m_materialMap;
 
+	// Bottom level hierarchies of every mesh, with absolute child and triangle indices
+	std::vector<BVH::Node> m_blasNodes;
+	// Top level hierarchy over the instances
+	BVH m_tlas;
+
 	Scene()
 		: m_vertices(std::vector<glm::vec3> {glm::vec3(-1.f, -1.f, 0.f), glm::vec3(1.f, -1.f, 0.f), glm::vec3(0.f, 1.f, 0.f)}),
 		  m_vertexData(std::vector<VertexData> {
@@ -73,6 +181,16 @@ public:
 		  	Light(glm::vec3(1.f), glm::vec3(0.f, 2.f, 0.f), glm::vec3(3.14f / 2.f, 0.f, 0.f), glm::vec3(2.f, 1.f, 1.f))
 		  }),
 		  m_lightCount(1, 0, 0, 0)
+	{
+		addInstance(addMesh(0, m_indices.size()), glm::mat4(1.f));
+		buildTLAS();
+	}
+
+	// Tag of the constructor leaving every array empty, for scenes filled by the caller such as readSceneCache()
+	struct Empty {};
+
+	Scene(Empty)
+		: m_lightCount(0)
 	{ }
 
 	// Load the scene as an obj file
@@ -89,52 +207,34 @@ public:
 			return;
 		}
 
-		// Vertices
-		size_t vertexCount = attrib.vertices.size() / 3;
-		m_vertices.reserve(vertexCount);
-		for (size_t i = 0; i < vertexCount; ++i)
-		{
-			m_vertices.push_back(glm::vec3(attrib.vertices[3 * i], attrib.vertices[3 * i + 1], attrib.vertices[3 * i + 2]));
-		}
-
-		// Indices
-		size_t indexOffset = 0;
+		// Meshes
+		// Shapes which are an affine copy of an earlier shape become instances of its mesh
+		std::vector<ShapeGeometry> prototypes;
 		for (size_t s = 0; s < shapes.size(); ++s)
 		{
-			indexOffset = m_indices.size();
-			m_indices.reserve(indexOffset + shapes[s].mesh.indices.size());
+			ShapeGeometry shape(attrib, shapes[s].mesh);
 
-			for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); ++f)
+			bool isInstance = false;
+			for (const ShapeGeometry& prototype : prototypes)
 			{
-				// There are always 3 vertices per polygon with triangulation enabled
-				glm::vec4 indices;
-				for (int i = 0; i < 3; ++i)
+				glm::mat4 transform;
+				int32_t material;
+				if (shape.isInstanceOf(prototype, transform, material))
 				{
-					tinyobj::index_t objIndex = tinyobj::index_t(shapes[s].mesh.indices[f * 3 + i]);
-
-					// Index
-					indices[i] = objIndex.vertex_index;
-
-					// Normal
-					glm::vec3 normal = glm::vec3(0.f, 0.f, -1.f);
-					if (objIndex.normal_index != -1)
-					{
-						normal = glm::vec3(
-							attrib.normals[3 * objIndex.normal_index + 0],
-							attrib.normals[3 * objIndex.normal_index + 1],
-							attrib.normals[3 * objIndex.normal_index + 2]
-							);
-					}
-
-					m_vertexData.push_back(VertexData(normal, glm::vec2(0.f)));
+					addInstance(prototype.mesh, transform, material);
+					isInstance = true;
+					break;
 				}
-				indices.w = indexOffset + f;
-
-				m_materialMap.push_back(shapes[s].mesh.material_ids[f]);
-				m_indices.push_back(indices);
 			}
+			if (isInstance) continue;
+
+			shape.mesh = addMesh(shape);
+			addInstance(shape.mesh, glm::mat4(1.f));
+			prototypes.push_back(std::move(shape));
 		}
 
+		buildTLAS();
+
 		// Materials
 		for (size_t i = 0; i < materials.size(); ++i)
 		{
@@ -215,9 +315,235 @@ public:
 
 			m_materials.push_back(Material(albedo, roughness, metallic, ior, anisotropy, transmission));
 		}
+
+		packMaterials();
 	}
 
 	Scene(const std::string filename)
 		: Scene(filename.c_str())
 	{ }
+
+	// Updates the packed material records, call after changing m_materials
+	void packMaterials()
+	{
+		m_materialRecords.clear();
+		m_materialRecords.reserve(m_materials.size());
+		for (const Material& material : m_materials)
+		{
+			m_materialRecords.push_back(material.pack());
+		}
+	}
+
+	// Builds the bottom level hierarchy over a range of triangles and sorts them into its leaf order
+	// Returns the index of the new mesh
+	uint32_t addMesh(uint32_t triangleOffset, uint32_t triangleCount)
+	{
+		Mesh mesh;
+		mesh.triangleOffset = triangleOffset;
+		mesh.triangleCount = triangleCount;
+		mesh.rootNode = m_blasNodes.size();
+
+		std::vector<glm::vec4> indices(m_indices.begin() + triangleOffset, m_indices.begin() + triangleOffset + triangleCount);
+		BVH blas(m_vertices, indices);
+		if (!LOG_IF_ERROR(blas.getDepth() <= BVH_STACK_SIZE))
+		{
+			printf("The hierarchy of mesh %zu has %u levels, traversal skips the levels past %u and may miss its triangles\n", m_meshes.size(), blas.getDepth(), BVH_STACK_SIZE);
+		}
+		blas.reorder(m_indices, triangleOffset);
+		blas.reorder(m_materialMap, triangleOffset);
+		mesh.bounds = blas.getBounds();
+
+		// Triangle records in leaf order
+		m_triangles.reserve(triangleOffset + triangleCount);
+		for (uint32_t i = triangleOffset; i < triangleOffset + triangleCount; ++i)
+		{
+			const glm::vec4& triangle = m_indices[i];
+			m_triangles.push_back(TriangleRecord(m_vertices[int(triangle.x)], m_vertices[int(triangle.y)], m_vertices[int(triangle.z)]));
+		}
+
+		// Make the node indices absolute in the combined node list
+		for (BVH::Node node : blas.m_nodes)
+		{
+			node.leftFirst += node.isLeaf() ? triangleOffset : mesh.rootNode;
+			m_blasNodes.push_back(node);
+		}
+
+		m_meshes.push_back(mesh);
+		return m_meshes.size() - 1;
+	}
+
+	// Places a mesh in the scene, the instance order changes when the top level hierarchy is built
+	void addInstance(uint32_t mesh, const glm::mat4& transform, int32_t material = -1)
+	{
+		m_instances.push_back(Instance(mesh, m_meshes[mesh].rootNode, transform, material));
+	}
+
+	// Builds the top level hierarchy and sorts the instances into its leaf order
+	void buildTLAS()
+	{
+		std::vector<BVH::Bounds> instanceBounds;
+		instanceBounds.reserve(m_instances.size());
+		for (const Instance& instance : m_instances)
+		{
+			const BVH::Bounds& meshBounds = m_meshes[instance.mesh].bounds;
+
+			BVH::Bounds bounds;
+			for (int corner = 0; corner < 8; ++corner)
+			{
+				glm::vec3 point = glm::vec3(
+					(corner & 1) ? meshBounds.max.x : meshBounds.min.x,
+					(corner & 2) ? meshBounds.max.y : meshBounds.min.y,
+					(corner & 4) ? meshBounds.max.z : meshBounds.min.z
+					);
+				bounds.grow(glm::vec3(instance.transform * glm::vec4(point, 1.f)));
+			}
+			instanceBounds.push_back(bounds);
+		}
+
+		m_tlas = BVH(instanceBounds);
+		if (!LOG_IF_ERROR(m_tlas.getDepth() <= TLAS_STACK_SIZE))
+		{
+			printf("The instance hierarchy has %u levels, traversal skips the levels past %u and may miss instances\n", m_tlas.getDepth(), TLAS_STACK_SIZE);
+		}
+		m_tlas.reorder(m_instances);
+	}
+
+private:
+	// Triangles of a single obj shape, with the vertices it uses in order of first use
+	struct ShapeGeometry {
+		std::vector<glm::vec3> vertices;
+		// Local vertex index of each triangle corner
+		std::vector<uint32_t> corners;
+		// Normal of each triangle corner
+		std::vector<glm::vec3> normals;
+		// Material of each triangle
+		std::vector<int> materials;
+
+		uint32_t mesh;
+
+		ShapeGeometry(const tinyobj::attrib_t& attrib, const tinyobj::mesh_t& objMesh)
+		{
+			std::map<int, uint32_t> localIndices;
+
+			// There are always 3 vertices per polygon with triangulation enabled
+			for (const tinyobj::index_t& objIndex : objMesh.indices)
+			{
+				// Index
+				auto localIndex = localIndices.find(objIndex.vertex_index);
+				if (localIndex == localIndices.end())
+				{
+					localIndex = localIndices.emplace(objIndex.vertex_index, vertices.size()).first;
+					vertices.push_back(glm::vec3(
+						attrib.vertices[3 * objIndex.vertex_index + 0],
+						attrib.vertices[3 * objIndex.vertex_index + 1],
+						attrib.vertices[3 * objIndex.vertex_index + 2]
+						));
+				}
+				corners.push_back(localIndex->second);
+
+				// Normal
+				glm::vec3 normal = glm::vec3(0.f, 0.f, -1.f);
+				if (objIndex.normal_index != -1)
+				{
+					normal = glm::vec3(
+						attrib.normals[3 * objIndex.normal_index + 0],
+						attrib.normals[3 * objIndex.normal_index + 1],
+						attrib.normals[3 * objIndex.normal_index + 2]
+						);
+				}
+				normals.push_back(normal);
+			}
+
+			materials = objMesh.material_ids;
+		}
+
+		// Checks if this shape is an affine transform of [prototype] with the same topology and normals
+		// A single material different from the prototype's is returned in [material], otherwise -1
+		bool isInstanceOf(const ShapeGeometry& prototype, glm::mat4& transform, int32_t& material) const
+		{
+			if (vertices.size() != prototype.vertices.size() || corners != prototype.corners) return false;
+
+			material = -1;
+			if (materials != prototype.materials)
+			{
+				if (std::any_of(materials.begin(), materials.end(), [&](int m) { return m != materials[0]; })) return false;
+				material = materials[0];
+			}
+
+			// Least squares fit of the linear part about the centroids
+			glm::dvec3 centroid(0.), prototypeCentroid(0.);
+			for (size_t i = 0; i < vertices.size(); ++i)
+			{
+				centroid += glm::dvec3(vertices[i]);
+				prototypeCentroid += glm::dvec3(prototype.vertices[i]);
+			}
+			centroid /= double(vertices.size());
+			prototypeCentroid /= double(vertices.size());
+
+			glm::dmat3 covariance(0.), crossCovariance(0.);
+			for (size_t i = 0; i < vertices.size(); ++i)
+			{
+				glm::dvec3 p = glm::dvec3(prototype.vertices[i]) - prototypeCentroid;
+				glm::dvec3 q = glm::dvec3(vertices[i]) - centroid;
+				covariance += glm::outerProduct(p, p);
+				crossCovariance += glm::outerProduct(q, p);
+			}
+
+			// Flat or degenerate shapes do not determine a unique transform
+			double trace = covariance[0][0] + covariance[1][1] + covariance[2][2];
+			if (trace <= 0. || glm::determinant(covariance) <= 1e-9 * trace * trace * trace) return false;
+
+			glm::dmat3 linear = crossCovariance * glm::inverse(covariance);
+			glm::dvec3 translation = centroid - linear * prototypeCentroid;
+
+			// Verify every vertex and normal
+			BVH::Bounds bounds;
+			for (const glm::vec3& vertex : vertices) bounds.grow(vertex);
+			double tolerance = 1e-4 * glm::length(glm::dvec3(bounds.max - bounds.min));
+
+			for (size_t i = 0; i < vertices.size(); ++i)
+			{
+				glm::dvec3 p = linear * glm::dvec3(prototype.vertices[i]) + translation;
+				if (glm::length(p - glm::dvec3(vertices[i])) > tolerance) return false;
+			}
+
+			glm::dmat3 normalMatrix = glm::transpose(glm::inverse(linear));
+			for (size_t i = 0; i < normals.size(); ++i)
+			{
+				glm::dvec3 n = glm::normalize(normalMatrix * glm::dvec3(prototype.normals[i]));
+				if (glm::dot(n, glm::normalize(glm::dvec3(normals[i]))) < 0.999) return false;
+			}
+
+			transform = glm::mat4(glm::dmat4(linear));
+			transform[3] = glm::vec4(glm::vec3(translation), 1.f);
+			return true;
+		}
+	};
+
+	// Appends the triangles of a shape as a new mesh
+	uint32_t addMesh(const ShapeGeometry& shape)
+	{
+		uint32_t vertexOffset = m_vertices.size();
+		m_vertices.insert(m_vertices.end(), shape.vertices.begin(), shape.vertices.end());
+
+		uint32_t triangleOffset = m_indices.size();
+		uint32_t triangleCount = shape.materials.size();
+		m_indices.reserve(triangleOffset + triangleCount);
+
+		for (uint32_t f = 0; f < triangleCount; ++f)
+		{
+			glm::vec4 indices;
+			indices.w = m_vertexData.size() / 3;
+			for (int i = 0; i < 3; ++i)
+			{
+				indices[i] = vertexOffset + shape.corners[3 * f + i];
+				m_vertexData.push_back(VertexData(shape.normals[3 * f + i], glm::vec2(0.f)));
+			}
+
+			m_materialMap.push_back(shape.materials[f]);
+			m_indices.push_back(indices);
+		}
+
+		return addMesh(triangleOffset, triangleCount);
+	}
 };
@@ -0,0 +1,372 @@
+#include <scenecache.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static constexpr char cacheMagic[8] = {'P', 'T', 'S', 'C', 'E', 'N', 'E', '\0'};
+// Bump when the meaning of a section changes, changed layouts of the scene's structs are caught by the element sizes
+static constexpr uint32_t cacheVersion = 1;
+// Sections start at this alignment in the file, enough for any of the scene's vector types
+static constexpr uint64_t sectionAlignment = 16;
+// Size recorded for a source that did not exist, the cache is stale once it does
+static constexpr uint64_t missingSource = UINT64_MAX;
+
+// Followed by the MTL root, the sources and the section table
+struct CacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t mtlRootLength;
+	uint32_t sourceCount;
+	uint32_t sectionCount;
+};
+
+// File the scene was loaded from, followed by its path
+struct CacheSource {
+	uint64_t size;
+	// Nanoseconds since the epoch
+	int64_t modified;
+	uint64_t hash;
+	uint32_t pathLength;
+	uint32_t padding;
+};
+
+enum SectionId : uint32_t {
+	SectionVertices,
+	SectionVertexData,
+	SectionIndices,
+	SectionTriangles,
+	SectionMeshes,
+	SectionInstances,
+	SectionLights,
+	SectionLightCount,
+	SectionMaterials,
+	SectionMaterialMap,
+	SectionBlasNodes,
+	SectionTlasNodes,
+	SectionTlasOrder,
+	SectionCount,
+};
+
+// [count] elements of [elementSize] bytes at [offset] from the start of the file
+struct CacheSection {
+	uint32_t id;
+	uint32_t elementSize;
+	uint64_t offset;
+	uint64_t count;
+};
+
+// Read only mapping of a whole file, empty if it could not be mapped
+class MappedFile
+{
+public:
+	const uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+
+	MappedFile(const char* filePath)
+	{
+		int file = open(filePath, O_RDONLY);
+		if (file < 0) return;
+
+		struct stat info;
+		if (fstat(file, &info) == 0 && info.st_size > 0)
+		{
+			void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+			if (data != MAP_FAILED)
+			{
+				m_data = (const uint8_t*)data;
+				m_size = info.st_size;
+			}
+		}
+
+		// The mapping stays valid without the descriptor
+		close(file);
+	}
+
+	~MappedFile()
+	{
+		if (m_data) munmap((void*)m_data, m_size);
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Copies [size] bytes at [offset] to [result], false past the end of the file
+	bool read(uint64_t offset, void* result, uint64_t size) const
+	{
+		if (offset > m_size || size > m_size - offset) return false;
+		std::memcpy(result, m_data + offset, size);
+		return true;
+	}
+};
+
+// 64 bit FNV-1a
+static uint64_t hashBytes(const uint8_t* data, size_t size)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= data[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+static uint64_t hashFile(const char* filePath)
+{
+	MappedFile file(filePath);
+	return hashBytes(file.m_data, file.m_size);
+}
+
+// Size and modification time of [filePath], the size is missingSource if it does not exist
+static void statSource(const char* filePath, uint64_t& size, int64_t& modified)
+{
+	struct stat info;
+	if (stat(filePath, &info) != 0)
+	{
+		size = missingSource;
+		modified = 0;
+		return;
+	}
+
+	size = info.st_size;
+	modified = int64_t(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+}
+
+// Whether [filePath] still is the file [source] was recorded from
+// An unchanged size and modification time is trusted, a touched file of the same size is compared by its hash
+static bool isCurrent(const char* filePath, const CacheSource& source)
+{
+	uint64_t size;
+	int64_t modified;
+	statSource(filePath, size, modified);
+
+	if (size != source.size) return false;
+	if (size == missingSource || modified == source.modified) return true;
+	return hashFile(filePath) == source.hash;
+}
+
+// The OBJ file and the MTL files its mtllib statements name, as tinyobj resolves them against [mtlRoot]
+static std::vector<std::string> sceneSources(const char* objFilename, const char* mtlRoot)
+{
+	std::vector<std::string> sources { objFilename };
+
+	std::ifstream file(objFilename);
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream tokens(line);
+		std::string token;
+		if (!(tokens >> token) || token != "mtllib") continue;
+
+		while (tokens >> token)
+		{
+			sources.push_back(std::string(mtlRoot ? mtlRoot : "") + token);
+		}
+	}
+
+	return sources;
+}
+
+static uint64_t alignSection(uint64_t offset)
+{
+	return (offset + sectionAlignment - 1) / sectionAlignment * sectionAlignment;
+}
+
+// Copies the section [id] of [cache] into [data], false if it is missing, out of bounds or of another element size
+template<typename T>
+static bool readSection(const MappedFile& cache, const std::vector<CacheSection>& sections, uint32_t id, std::vector<T>& data)
+{
+	static_assert(std::is_trivially_copyable<T>::value, "Cached scene arrays are copied byte for byte");
+
+	for (const CacheSection& section : sections)
+	{
+		if (section.id != id) continue;
+		if (section.elementSize != sizeof(T) || section.count > cache.m_size / sizeof(T)) return false;
+
+		uint64_t size = section.count * sizeof(T);
+		if (section.offset > cache.m_size || size > cache.m_size - section.offset) return false;
+
+		const T* first = (const T*)(cache.m_data + section.offset);
+		data.assign(first, first + section.count);
+		return true;
+	}
+
+	return false;
+}
+
+std::string sceneCachePath(const char* objFilename)
+{
+	return std::string(objFilename) + ".cache";
+}
+
+Scene* readSceneCache(const char* cachePath, const char* objFilename, const char* mtlRoot)
+{
+	MappedFile cache(cachePath);
+	if (!cache.m_data) return nullptr;
+
+	uint64_t offset = 0;
+	CacheHeader header;
+	if (!cache.read(offset, &header, sizeof(header))) return nullptr;
+	offset += sizeof(header);
+
+	if (std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.version != cacheVersion) return nullptr;
+	if (header.sectionCount > SectionCount) return nullptr;
+
+	// Materials depend on the root the MTL files were found in
+	std::string cachedRoot(header.mtlRootLength, '\0');
+	if (!cache.read(offset, &cachedRoot[0], header.mtlRootLength)) return nullptr;
+	offset += header.mtlRootLength;
+	if (cachedRoot != (mtlRoot ? mtlRoot : "")) return nullptr;
+
+	for (uint32_t i = 0; i < header.sourceCount; ++i)
+	{
+		CacheSource source;
+		if (!cache.read(offset, &source, sizeof(source))) return nullptr;
+		offset += sizeof(source);
+		if (source.pathLength > cache.m_size) return nullptr;
+
+		std::string path(source.pathLength, '\0');
+		if (!cache.read(offset, &path[0], source.pathLength)) return nullptr;
+		offset += source.pathLength;
+
+		// The first source is the OBJ file, which may have been given by another path
+		if (i == 0 && path != objFilename) return nullptr;
+		if (!isCurrent(path.c_str(), source)) return nullptr;
+	}
+
+	std::vector<CacheSection> sections(header.sectionCount);
+	if (!cache.read(offset, sections.data(), sizeof(CacheSection) * sections.size())) return nullptr;
+
+	Scene* scene = new Scene(Scene::Empty());
+	std::vector<glm::uvec4> lightCount;
+	bool valid = readSection(cache, sections, SectionVertices, scene->m_vertices)
+		&& readSection(cache, sections, SectionVertexData, scene->m_vertexData)
+		&& readSection(cache, sections, SectionIndices, scene->m_indices)
+		&& readSection(cache, sections, SectionTriangles, scene->m_triangles)
+		&& readSection(cache, sections, SectionMeshes, scene->m_meshes)
+		&& readSection(cache, sections, SectionInstances, scene->m_instances)
+		&& readSection(cache, sections, SectionLights, scene->m_lights)
+		&& readSection(cache, sections, SectionLightCount, lightCount) && lightCount.size() == 1
+		&& readSection(cache, sections, SectionMaterials, scene->m_materials)
+		&& readSection(cache, sections, SectionMaterialMap, scene->m_materialMap)
+		&& readSection(cache, sections, SectionBlasNodes, scene->m_blasNodes)
+		&& readSection(cache, sections, SectionTlasNodes, scene->m_tlas.m_nodes)
+		&& readSection(cache, sections, SectionTlasOrder, scene->m_tlas.m_order);
+	if (!valid)
+	{
+		delete scene;
+		return nullptr;
+	}
+
+	scene->m_lightCount = lightCount[0];
+	scene->packMaterials();
+	return scene;
+}
+
+bool writeSceneCache(const char* cachePath, const char* objFilename, const char* mtlRoot, const Scene& scene)
+{
+	std::string root = mtlRoot ? mtlRoot : "";
+	std::vector<std::string> sources = sceneSources(objFilename, mtlRoot);
+
+	struct SectionData {
+		uint32_t id;
+		uint32_t elementSize;
+		uint64_t count;
+		const void* data;
+	};
+	auto sectionOf = [](uint32_t id, const auto& data) {
+		return SectionData { id, uint32_t(sizeof(data[0])), data.size(), data.data() };
+	};
+	std::vector<glm::uvec4> lightCount { scene.m_lightCount };
+	std::vector<SectionData> sectionData {
+		sectionOf(SectionVertices, scene.m_vertices),
+		sectionOf(SectionVertexData, scene.m_vertexData),
+		sectionOf(SectionIndices, scene.m_indices),
+		sectionOf(SectionTriangles, scene.m_triangles),
+		sectionOf(SectionMeshes, scene.m_meshes),
+		sectionOf(SectionInstances, scene.m_instances),
+		sectionOf(SectionLights, scene.m_lights),
+		sectionOf(SectionLightCount, lightCount),
+		sectionOf(SectionMaterials, scene.m_materials),
+		sectionOf(SectionMaterialMap, scene.m_materialMap),
+		sectionOf(SectionBlasNodes, scene.m_blasNodes),
+		sectionOf(SectionTlasNodes, scene.m_tlas.m_nodes),
+		sectionOf(SectionTlasOrder, scene.m_tlas.m_order),
+	};
+
+	// Header, MTL root and sources
+	std::vector<uint8_t> head;
+	auto append = [&head](const void* data, size_t size) {
+		head.insert(head.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+	};
+
+	CacheHeader header;
+	std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+	header.version = cacheVersion;
+	header.mtlRootLength = root.size();
+	header.sourceCount = sources.size();
+	header.sectionCount = sectionData.size();
+	append(&header, sizeof(header));
+	append(root.data(), root.size());
+
+	for (const std::string& path : sources)
+	{
+		CacheSource source;
+		statSource(path.c_str(), source.size, source.modified);
+		source.hash = source.size == missingSource ? 0 : hashFile(path.c_str());
+		source.pathLength = path.size();
+		source.padding = 0;
+		append(&source, sizeof(source));
+		append(path.data(), path.size());
+	}
+
+	// Section table, the sections follow it in the same order
+	uint64_t offset = alignSection(head.size() + sizeof(CacheSection) * sectionData.size());
+	for (const SectionData& data : sectionData)
+	{
+		CacheSection section { data.id, data.elementSize, offset, data.count };
+		append(&section, sizeof(section));
+		offset = alignSection(offset + data.count * data.elementSize);
+	}
+
+	// Written to a temporary file first, so an interrupted write never leaves a truncated cache behind
+	std::string temporaryPath = std::string(cachePath) + ".tmp";
+	FILE* file = std::fopen(temporaryPath.c_str(), "wb");
+	if (!file)
+	{
+		printf("Could not open %s for writing\n", temporaryPath.c_str());
+		return false;
+	}
+
+	const uint8_t padding[sectionAlignment] = {};
+	bool written = std::fwrite(head.data(), 1, head.size(), file) == head.size();
+	uint64_t position = head.size();
+	for (const SectionData& data : sectionData)
+	{
+		uint64_t size = data.count * data.elementSize;
+		uint64_t paddingSize = alignSection(position) - position;
+		written = written
+			&& std::fwrite(padding, 1, paddingSize, file) == paddingSize
+			&& std::fwrite(data.data, 1, size, file) == size;
+		position += paddingSize + size;
+	}
+
+	written = std::fclose(file) == 0 && written;
+	if (!written || std::rename(temporaryPath.c_str(), cachePath) != 0)
+	{
+		printf("Could not write %s\n", cachePath);
+		std::remove(temporaryPath.c_str());
+		return false;
+	}
+
+	return true;
+}
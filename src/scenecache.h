@@ -0,0 +1,19 @@
+#pragma once
+
+#include <scene.h>
+
+#include <string>
+
+// Binary copy of a loaded scene, so later runs skip the OBJ parsing and the hierarchy builds
+// The cache lists the OBJ and MTL files it was built from with their size, modification time and hash,
+// and holds every array of the scene as a section, read by mapping the file and copying each section into its vector in one go
+
+// Path of the cache of [objFilename], next to it
+std::string sceneCachePath(const char* objFilename);
+
+// Loads the scene from the cache at [cachePath] if it was written for [objFilename] and [mtlRoot] and none of its sources changed
+// Returns null when the cache is missing, stale or from another version of the format, the scene is only allocated once the cache is current
+Scene* readSceneCache(const char* cachePath, const char* objFilename, const char* mtlRoot);
+
+// Writes [scene], loaded from [objFilename] with the MTL files in [mtlRoot], to the cache at [cachePath]
+bool writeSceneCache(const char* cachePath, const char* objFilename, const char* mtlRoot, const Scene& scene);
@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <iostream>
+#include <sstream>
 
 /// Logs any errors found when compiling a shader
 /// Returns true if no errors were found, otherwise returns false
@@ -47,6 +48,55 @@ char* ShaderProgram::readfile(const char* filename) const
 	return contents;
 }
 
+/// Reads a shader file, replacing each line of the form #include "file" with the contents of that file
+/// Included paths are relative to the including file
+std::string ShaderProgram::readShader(const char* filename, int depth) const
+{
+	const char* contents = depth <= 16 ? readfile(filename) : nullptr;
+	if (!contents)
+	{
+		std::cout << "Could not read shader " << filename << std::endl;
+		return std::string();
+	}
+	DEFER(delete[] contents);
+
+	std::string path = filename;
+	std::string directory = path.substr(0, path.find_last_of('/') + 1);
+
+	std::istringstream input(contents);
+	std::string source;
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(input, line))
+	{
+		++lineNumber;
+
+		size_t directive = line.find_first_not_of(" \t");
+		if (directive == std::string::npos || line.compare(directive, 8, "#include") != 0)
+		{
+			source += line + '\n';
+			continue;
+		}
+
+		size_t open = line.find('"', directive);
+		size_t close = line.find('"', open + 1);
+		if (open == std::string::npos || close == std::string::npos)
+		{
+			source += line + '\n';
+			continue;
+		}
+
+		std::string includePath = directory + line.substr(open + 1, close - open - 1);
+		source += "#line 1\n";
+		source += readShader(includePath.c_str(), depth + 1);
+
+		// Keep error line numbers relative to this file
+		source += "#line " + std::to_string(lineNumber + 1) + '\n';
+	}
+
+	return source;
+}
+
 /// Creates a new GL program given the specified vertex/fragment shader file locations
 ShaderProgram::ShaderProgram(const char* vertFile, const char* fragFile)
 	: m_id(-1u), m_isCompiled(false)
@@ -56,10 +106,10 @@ ShaderProgram::ShaderProgram(const char* vertFile, const char* fragFile)
 	m_id = glCreateProgram();
 
 	// Read the shader files
-	const char* vertShaderCode = readfile(vertFile);
-	DEFER(delete vertShaderCode);
-	const char* fragShaderCode = readfile(fragFile);
-	DEFER(delete fragShaderCode);
+	std::string vertShaderSource = readShader(vertFile);
+	const char* vertShaderCode = vertShaderSource.c_str();
+	std::string fragShaderSource = readShader(fragFile);
+	const char* fragShaderCode = fragShaderSource.c_str();
 
 	// Create the vertex shader
 	vertShader = glCreateShader(GL_VERTEX_SHADER);
@@ -91,6 +141,31 @@ ShaderProgram::ShaderProgram(const char* vertFile, const char* fragFile)
 	m_isCompiled = true;
 }
 
+/// Creates a new GL compute program given the specified compute shader file location
+ShaderProgram::ShaderProgram(const char* compFile)
+	: m_id(-1u), m_isCompiled(false)
+{
+	m_id = glCreateProgram();
+
+	std::string compShaderSource = readShader(compFile);
+	const char* compShaderCode = compShaderSource.c_str();
+
+	GLuint compShader = glCreateShader(GL_COMPUTE_SHADER);
+	glShaderSource(compShader, 1, &compShaderCode, nullptr);
+	glCompileShader(compShader);
+	DEFER(glDeleteShader(compShader));
+
+	if (!logCompileErrors(compShader))
+	{
+		return;
+	}
+
+	glAttachShader(m_id, compShader);
+	glLinkProgram(m_id);
+
+	m_isCompiled = true;
+}
+
 ShaderProgram::~ShaderProgram()
 {
 	glDeleteProgram(m_id);
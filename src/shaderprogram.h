@@ -4,6 +4,8 @@
 #include <gl/gl.h>
 #include <utils.h>
 
+#include <string>
+
 class ShaderProgram
 {
 public:
@@ -14,9 +16,11 @@ private:
 
 	bool logCompileErrors(GLuint shader) const;
 	char* readfile(const char* filename) const;
+	std::string readShader(const char* filename, int depth = 0) const;
 
 public:
 	ShaderProgram(const char* vertFile, const char* fragFile);
+	ShaderProgram(const char* compFile);
 	~ShaderProgram();
 
 	bool isCompiled() const;
@@ -0,0 +1,144 @@
+#version 460
+
+// One iteration of the edge-avoiding A-trous wavelet filter (Dammertz et al. 2010), with the variance guided luminance weight of SVGF (Schied et al. 2017)
+// Illumination is filtered with the albedo divided out so texture and material edges stay sharp, the last iteration multiplies it back
+
+// Output of the previous iteration, illumination with its variance in alpha
+layout(location = 0) uniform sampler2D inTexture;
+// G-buffer
+layout(location = 1) uniform sampler2D albedoTexture;
+layout(location = 2) uniform sampler2D normalTexture;
+layout(location = 3) uniform sampler2D depthTexture;
+// Front accumulation target, read instead of [inTexture] by the first iteration
+layout(location = 4) uniform sampler2D accumTexture;
+layout(location = 5) uniform sampler2D momentTexture;
+layout(location = 6) uniform usampler2D sampleCountTexture;
+
+// Pixels between the taps, doubling every iteration
+layout(location = 7) uniform int stepSize;
+layout(location = 8) uniform bool firstIteration;
+layout(location = 9) uniform bool lastIteration;
+
+layout(location = 0) in vec2 texCoords;
+
+layout(location = 0) out vec4 out_color;
+
+// Edge stopping sensitivities
+#define SIGMA_LUMINANCE 4.f
+#define SIGMA_NORMAL    128.f
+#define SIGMA_DEPTH     1.f
+
+// Below this many samples the variance of a pixel is estimated from its neighbours rather than its own samples
+#define MIN_TEMPORAL_SAMPLES 4u
+
+float luminance(vec3 color)
+{
+    return dot(color, vec3(0.2126f, 0.7152f, 0.0722f));
+}
+
+// Black albedo channels leave the illumination as it is
+vec3 safeAlbedo(ivec2 pixel)
+{
+    vec3 albedo = texelFetch(albedoTexture, pixel, 0).rgb;
+    return mix(vec3(1.f), albedo, greaterThan(albedo, vec3(1e-3f)));
+}
+
+// Illumination and the variance of its luminance
+vec4 fetchIllumination(ivec2 pixel)
+{
+    if (!firstIteration) return texelFetch(inTexture, pixel, 0);
+
+    vec3 albedo = safeAlbedo(pixel);
+    vec3 color = texelFetch(accumTexture, pixel, 0).rgb;
+    float moment = texelFetch(momentTexture, pixel, 0).r;
+    float n = float(texelFetch(sampleCountTexture, pixel, 0).r);
+
+    // Variance of the mean
+    float lum = luminance(color);
+    float variance = n > 1.f ? max(0.f, moment - lum * lum) / (n - 1.f) : lum * lum;
+
+    float albedoLuminance = max(luminance(albedo), 1e-3f);
+    return vec4(color / albedo, variance / (albedoLuminance * albedoLuminance));
+}
+
+// Variance of the illumination's luminance over the 5x5 pixels around [pixel] that lie on the same surface
+// A few samples say little about a pixel's own variance, a black pixel would otherwise never be filtered
+float spatialVariance(ivec2 pixel, vec3 normal, float depth, ivec2 size)
+{
+    float sum = 0.f;
+    float squares = 0.f;
+    float count = 0.f;
+    for (int y = -2; y <= 2; ++y)
+    {
+        for (int x = -2; x <= 2; ++x)
+        {
+            ivec2 tap = pixel + ivec2(x, y);
+            if (any(lessThan(tap, ivec2(0))) || any(greaterThanEqual(tap, size))) continue;
+            if (dot(normal, texelFetch(normalTexture, tap, 0).xyz) < 0.9f) continue;
+            if (abs(depth - texelFetch(depthTexture, tap, 0).r) > 0.05f * depth) continue;
+
+            float lum = luminance(fetchIllumination(tap).rgb);
+            sum += lum;
+            squares += lum * lum;
+            count += 1.f;
+        }
+    }
+
+    // Lights and the background have no normal and keep the center only
+    if (count < 2.f) return 0.f;
+
+    float mean = sum / count;
+    return max(0.f, squares / count - mean * mean);
+}
+
+void main()
+{
+    const float kernel[3] = float[3](3.f / 8.f, 1.f / 4.f, 1.f / 16.f);
+
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 size = textureSize(albedoTexture, 0);
+
+    vec4 center = fetchIllumination(pixel);
+    vec3 normal = texelFetch(normalTexture, pixel, 0).xyz;
+    vec2 depth = texelFetch(depthTexture, pixel, 0).rg;
+    float lum = luminance(center.rgb);
+    if (firstIteration && texelFetch(sampleCountTexture, pixel, 0).r < MIN_TEMPORAL_SAMPLES)
+    {
+        center.a = spatialVariance(pixel, normal, depth.r, size);
+    }
+    float lumScale = 1.f / (SIGMA_LUMINANCE * sqrt(max(center.a, 0.f)) + 1e-6f);
+
+    float centerWeight = kernel[0] * kernel[0];
+    vec3 sum = center.rgb * centerWeight;
+    float varianceSum = center.a * centerWeight * centerWeight;
+    float weightSum = centerWeight;
+
+    for (int y = -2; y <= 2; ++y)
+    {
+        for (int x = -2; x <= 2; ++x)
+        {
+            if (x == 0 && y == 0) continue;
+
+            ivec2 tap = pixel + ivec2(x, y) * stepSize;
+            if (any(lessThan(tap, ivec2(0))) || any(greaterThanEqual(tap, size))) continue;
+
+            vec4 tapIllumination = fetchIllumination(tap);
+            vec3 tapNormal = texelFetch(normalTexture, tap, 0).xyz;
+            float tapDepth = texelFetch(depthTexture, tap, 0).r;
+
+            float normalWeight = pow(max(0.f, dot(normal, tapNormal)), SIGMA_NORMAL);
+            float depthWeight = exp(-abs(depth.r - tapDepth) / (SIGMA_DEPTH * depth.g * length(vec2(x, y) * stepSize) + 1e-3f));
+            float lumWeight = exp(-abs(lum - luminance(tapIllumination.rgb)) * lumScale);
+
+            float weight = kernel[abs(x)] * kernel[abs(y)] * normalWeight * depthWeight * lumWeight;
+            sum += tapIllumination.rgb * weight;
+            varianceSum += tapIllumination.a * weight * weight;
+            weightSum += weight;
+        }
+    }
+
+    vec3 illumination = sum / weightSum;
+    float variance = varianceSum / (weightSum * weightSum);
+
+    out_color = lastIteration ? vec4(illumination * safeAlbedo(pixel), 1.f) : vec4(illumination, variance);
+}
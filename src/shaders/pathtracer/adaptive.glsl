@@ -0,0 +1,39 @@
+// Per-pixel error estimates and the mask of converged pixels used by adaptive sampling
+// Every pixel keeps the running mean of its samples' squared luminance next to the mean radiance, their variance follows
+
+#include "error_estimate.h"
+
+// Samples every pixel takes before its tile's error is trusted
+#define ADAPTIVE_MIN_SAMPLES 16u
+
+// Front target's running mean of the squared luminance
+layout(location = 29) uniform sampler2D momentTexture;
+// Relative standard error of every tile in red, computed from the front target after every pass
+layout(location = 30) uniform sampler2D errorTexture;
+// Tiles whose error is below the threshold stop taking samples, zero samples every pixel
+layout(location = 31) uniform float adaptiveThreshold;
+
+float luminance(vec3 color)
+{
+    return dot(color, vec3(0.2126f, 0.7152f, 0.0722f));
+}
+
+// Standard error of the mean luminance of a pixel relative to the luminance, unknown below two samples
+// Its square estimates the pixel's relative MSE
+float pixelError(vec3 mean, float moment, uint sampleCount)
+{
+    if (sampleCount < 2u) return UNKNOWN_ERROR;
+
+    float n = float(sampleCount);
+    float lum = luminance(mean);
+    float variance = max(0.f, moment - lum * lum) * n / (n - 1.f);
+    return sqrt(variance / n) / (lum + ERROR_LUMINANCE_FLOOR);
+}
+
+// Whether [pixel], having taken [sampleCount] samples, can skip the pass
+bool converged(ivec2 pixel, uint sampleCount)
+{
+    if (adaptiveThreshold <= 0.f || sampleCount < ADAPTIVE_MIN_SAMPLES) return false;
+
+    return texelFetch(errorTexture, pixel / ERROR_TILE_SIZE, 0).r < adaptiveThreshold;
+}
@@ -0,0 +1,529 @@
+// Fresnel, microfacet and BxDF sampling functions
+
+// ====================
+// == BxDF Functions ==
+// ====================
+
+// Fresnel equations
+
+float schlickR0(float eta)
+{
+    float R0 = (eta - 1.f) / (eta + 1.f);
+    return R0 * R0;
+}
+
+float schlickR0(float ior1, float ior2)
+{
+    float R0 = (ior1 - ior2) / (ior1 + ior2);
+    return R0 * R0;
+}
+
+// Cosines of normalized vectors can round past 1, pow() is undefined for a negative base
+float schlickFresnel(float R0, float cosTheta)
+{
+    return R0 + (1.f - R0) * pow(max(0.f, 1.f - cosTheta), 5);
+}
+
+float schlickFresnel(float cosTheta)
+{
+    return schlickFresnel(0.05f, cosTheta);
+}
+
+vec3 schlickFresnel(vec3 R0, float cosTheta)
+{
+    return R0 + (vec3(1.f) - R0) * pow(max(0.f, 1.f - cosTheta), 5);
+}
+
+float fresnelDielectric(float cosThetaIn, float eta)
+{
+    // Flip the orientation if backwards
+    if (cosThetaIn < 0.f)
+    {
+        eta = 1.f / eta;
+        cosThetaIn = -cosThetaIn;
+    }
+
+    // Find the cosine of the transmitted direction according to Snell's law
+    float sin2ThetaIn = 1 - cosThetaIn * cosThetaIn;
+    float sin2ThetaTran = sin2ThetaIn / (eta * eta);
+
+    // Total interanl refraction
+    if (sin2ThetaTran >= 1.f) return 1.f;
+
+    float cosThetaTran = sqrt(1.f - sin2ThetaTran);
+
+    float refPara = (eta * cosThetaIn - cosThetaTran) / (eta * cosThetaIn + cosThetaTran);
+    float refPerp = (cosThetaIn - eta * cosThetaTran) / (cosThetaIn + eta * cosThetaTran);
+
+    return (refPara * refPara + refPerp * refPerp) / 2.f;
+}
+
+float fresnelComplex(float cosThetaIn, vec2 cxEta)
+{
+    vec2 cxCosThetaIn = vec2(max(0.f, cosThetaIn), 0.f);
+
+    // Find the cosine of the transmitted direction according to Snell's law
+    vec2 cxSin2ThetaIn = vec2(1.f - cxCosThetaIn.x * cxCosThetaIn.x, 0.f);
+    vec2 cxSin2ThetaTran = cxDiv(cxSin2ThetaIn, cxMul(cxEta, cxEta));
+
+    vec2 cxCosThetaTran = cxSqrt(vec2(1.f, 0.f) - cxSin2ThetaTran);
+
+    vec2 refPara = cxDiv(cxMul(cxEta, cxCosThetaIn) - cxCosThetaTran, cxMul(cxEta, cxCosThetaIn) + cxCosThetaTran);
+    vec2 refPerp = cxDiv(cxCosThetaIn - cxMul(cxEta, cxCosThetaTran), cxCosThetaIn + cxMul(cxEta, cxCosThetaTran));
+
+    return (dot(refPara, refPara) + dot(refPerp, refPerp)) / 2.f;
+}
+
+vec3 fresnelComplex(float cosThetaIn, vec3 eta, vec3 k)
+{
+    return vec3(
+        fresnelComplex(cosThetaIn, vec2(eta[0], k[0])),
+        fresnelComplex(cosThetaIn, vec2(eta[1], k[1])),
+        fresnelComplex(cosThetaIn, vec2(eta[2], k[2]))
+    );
+}
+
+// Transmission helper functions
+
+bool refract(vec3 inDir, vec3 normal, float eta, out float relativeEta, out vec3 outDir)
+{
+    float cosThetaIn = dot(normal, inDir);
+
+    // Flip the orientation if backwards
+    if (cosThetaIn < 0.f)
+    {
+        eta = 1.f / eta;
+        cosThetaIn = -cosThetaIn;
+        normal = -normal;
+    }
+
+    // Find the transmitted direction according to Snell's law
+    float sin2ThetaIn = 1.f - cosThetaIn * cosThetaIn;
+    float sin2ThetaTran = sin2ThetaIn / (eta * eta);
+
+    // Handle total internal reflection
+    if (sin2ThetaTran >= 1.f)
+    {
+        return false;
+    }
+
+    float cosThetaTran = sqrt(1.f - sin2ThetaTran);
+
+    outDir = -inDir / eta + (cosThetaIn / eta - cosThetaTran) * normal;
+    relativeEta = eta;
+
+    return true;
+}
+
+// Microfacet helper functions
+
+float isotropicRoughness2(vec3 v, vec2 alpha)
+{
+    return
+        alpha.x * alpha.x * cos2Phi(v)
+        + alpha.y * alpha.y * sin2Phi(v);
+}
+
+float isotropicRoughness(vec3 v, vec2 alpha)
+{
+    return sqrt(isotropicRoughness2(v, alpha));
+}
+
+float trowbridgeReitzDistribution(vec3 localMicroNormal, vec2 alpha)
+{
+    float tan2Theta = tan2Theta(localMicroNormal);
+    if (isinf(tan2Theta)) return 0.f;
+
+    float cos2Theta = cos2Theta(localMicroNormal);
+    float cos4Theta = cos2Theta * cos2Theta;
+    float e =
+        (
+          cos2Phi(localMicroNormal) / (alpha.x * alpha.x)
+          + sin2Phi(localMicroNormal) / (alpha.y * alpha.y)
+        ) * tan2Theta;
+
+    return 1.f / (PI * alpha.x * alpha.y * cos4Theta * (1.f + e) * (1.f + e));
+}
+
+float trowbridgeReitzLambda(vec3 v, vec2 alpha)
+{
+    float tan2Theta = tan2Theta(v);
+    if (isinf(tan2Theta)) return 0.f;
+
+    return (sqrt(1.f + isotropicRoughness2(v, alpha) * tan2Theta) - 1.f) * 0.5f;
+}
+
+float trowbridgeReitzMasking(vec3 localOutDir, vec3 localInDir, vec2 alpha)
+{
+    return 1.f / (1.f + trowbridgeReitzLambda(localOutDir, alpha) + trowbridgeReitzLambda(localInDir, alpha));
+}
+
+vec3 trowbridgeReitzSampleNormal(vec3 localOutDir, vec2 xi, vec2 alpha)
+{
+    vec3 hemisphereOutDir = normalize(vec3(alpha.x * localOutDir.x, alpha.y * localOutDir.y, localOutDir.z));
+    if (hemisphereOutDir.z < 0) hemisphereOutDir = -hemisphereOutDir;
+
+    vec3 T1 = (hemisphereOutDir.z < 0.99999f) ? normalize(cross(vec3(0.f, 0.f, 1.f), hemisphereOutDir)) : vec3(1.f, 0.f, 0.f);
+    vec3 T2 = cross(hemisphereOutDir, T1);
+
+    vec2 p = squareToUniformDiskPolar(xi);
+
+    float h = sqrt(1.f - p.x * p.x);
+    p.y = mix((1.f - hemisphereOutDir.z) / 2.f, h, p.y);
+
+    //float s = 0.5f * (1.f + hemisphereOutDir.z);
+    //p.y = (1.f - s) * sqrt(1.f - p.x * p.x) + s * p.y;
+
+    //p.y = mix(sqrt(1.f - p.x * p.x), p.y, 0.5f * (1.f + hemisphereOutDir.z));
+
+    float pz = sqrt(max(0.f, 1.f - dot(p, p)));
+
+    vec3 hemisphereNormal = p.x * T1 + p.y * T2 + pz * hemisphereOutDir;
+    return normalize(vec3(alpha.x * hemisphereNormal.x, alpha.y * hemisphereNormal.y, max(0.000001f, hemisphereNormal.z)));
+}
+
+float trowbridgeReitzDensity(vec3 localOutDir, vec3 localMicroNormal, vec2 alpha)
+{
+    float G1 = 1.f / (1.f + trowbridgeReitzLambda(localOutDir, alpha));
+
+    return G1 * trowbridgeReitzDistribution(localMicroNormal, alpha) * abs(dot(localOutDir, localMicroNormal)) / abs(cosTheta(localOutDir));
+}
+
+// PDF functions
+
+float hemisphereCosinePDF(vec3 hemisphereSample)
+{
+    return hemisphereSample.z * INV_PI;
+}
+
+float trowbridgeReitzPdf(vec3 localOutDir, vec3 localMicroNormal, vec2 alpha)
+{
+    return trowbridgeReitzDensity(localOutDir, localMicroNormal, alpha);
+}
+
+// Attenuation functions
+
+vec3 diffuseAttenuation(Material material)
+{
+    return material.albedo * INV_PI;
+}
+
+vec3 microfacetAttenuation(Material material, vec3 localOutDir, vec3 localInDir, vec2 alpha)
+{
+    float cosThetaOut = abs(cosTheta(localOutDir));
+    float cosThetaIn = abs(cosTheta(localInDir));
+    vec3 localMicroNormal = localOutDir + localInDir;
+
+    if (cosThetaIn <= 0.f || cosThetaOut <= 0.f) return vec3(0.f);
+    if (localMicroNormal.x == 0.f && localMicroNormal.y == 0.f && localMicroNormal.z == 0.f) return vec3(0.f);
+    localMicroNormal = normalize(localMicroNormal);
+
+    vec3 fresnel = schlickFresnel(material.albedo, abs(dot(localOutDir, localMicroNormal)));
+    
+    float distribution = trowbridgeReitzDistribution(localMicroNormal, alpha);
+    float masking = trowbridgeReitzMasking(localOutDir, localInDir, alpha);
+
+    return distribution * masking * fresnel / (4 * cosThetaIn * cosThetaOut);
+}
+
+// BxDF functions
+
+vec3 diffuseBxDF(Intersection intersection, Material material, vec2 xi, vec3 outDir, out vec3 inDir, out float pdf)
+{
+    if (dot(intersection.normal, outDir) < 0.f)
+    {
+        intersection.normal *= -1;
+    }
+
+    // Find the entrance direction
+    vec3 localInDir = squareToHemisphereCosine(xi);
+    inDir = localToWorld(intersection.normal) * localInDir;
+
+    // Compute the PDF
+    pdf = hemisphereCosinePDF(localInDir);
+
+    return diffuseAttenuation(material);
+}
+
+vec3 dielectricBxDF(Intersection intersection, Material material, vec2 xi, vec3 outDir, out vec3 inDir, out float pdf)
+{
+    vec2 roughness = vec2(material.roughness);
+
+    // Find the microfacet normal
+    vec3 localOutDir = worldToLocal(intersection.normal) * outDir;
+    if (localOutDir.z == 0.f) return vec3(0.f);
+    vec3 localMicroNormal = trowbridgeReitzSampleNormal(localOutDir, xi, roughness);
+
+    float reflectance = schlickFresnel(abs(dot(localOutDir, localMicroNormal)));
+    float transmittance = 1.f - reflectance;
+
+    float reflectProb = reflectance;
+    float transmitProb = transmittance * material.transmission;
+    float diffuseProb = transmittance * (1.f - material.transmission);
+
+    // If exiting the surface, only allow transmission
+    if (localOutDir.z < 0.f)
+    {
+        transmitProb = transmittance;
+        diffuseProb = 0.f;
+    }
+
+    float interactionChoice = sample1D();
+    if (interactionChoice <= reflectProb)
+    {
+        // SPECULAR
+
+        // Find the entrance direction
+        vec3 localInDir = reflect(-localOutDir, localMicroNormal);
+        if (localInDir.z * localOutDir.z <= 0.f) return vec3(0.f);
+
+        inDir = localToWorld(intersection.normal) * localInDir;
+
+        // PDF
+        pdf = trowbridgeReitzPdf(localOutDir, localMicroNormal, roughness) / (4.f * dot(localOutDir, localMicroNormal)) * reflectProb;
+
+        float distribution = trowbridgeReitzDistribution(localMicroNormal, roughness);
+        float masking = trowbridgeReitzMasking(localOutDir, localInDir, roughness);
+
+        return vec3(distribution * masking * reflectance / (4 * cosTheta(localInDir) * cosTheta(localOutDir)));
+    }
+    else if (interactionChoice <= reflectProb + transmitProb)
+    {
+        // TRANSMITTANCE
+
+        // Find the entrance direction
+        float relativeEta;
+        vec3 localInDir;
+        bool totalInternalReflection = !refract(localOutDir, localMicroNormal, material.ior, relativeEta, localInDir);
+
+        if (localOutDir.z * localInDir.z > 0.f || localInDir.z == 0.f || totalInternalReflection) return vec3(0.f);
+
+        inDir = localToWorld(intersection.normal) * localInDir;
+
+        // PDF
+        float detDenom = dot(localInDir, localMicroNormal) + dot(localOutDir, localMicroNormal) / relativeEta;
+        float detMicro_detIn = abs(dot(localInDir, localMicroNormal)) / (detDenom * detDenom);
+        pdf = trowbridgeReitzPdf(localOutDir, localMicroNormal, roughness) * detMicro_detIn * transmitProb;
+
+        float distribution = trowbridgeReitzDistribution(localMicroNormal, roughness);
+        float masking = trowbridgeReitzMasking(localOutDir, localInDir, roughness);
+
+        return material.albedo *
+            (distribution * masking * transmittance * dot(localInDir, localMicroNormal) * dot(localOutDir, localMicroNormal) /
+            (cosTheta(localInDir) * cosTheta(localOutDir) * detDenom * detDenom));
+    }
+    else
+    {
+        // DIFFUSE
+
+        vec3 diffuseOut = diffuseBxDF(intersection, material, xi, outDir, inDir, pdf);
+        pdf *= diffuseProb;
+        return diffuseOut;
+    }
+}
+
+vec3 microFacetBxDF(Intersection intersection, Material material, vec2 xi, vec3 outDir, out vec3 inDir, out float pdf)
+{
+    //
+    float angle = 0.f;
+    mat3 anisoRotation = axisAngle(vec3(0.f, 0.f, 1.f), angle * PI / 180.f);
+    mat3 anisoRotationInv = transpose(anisoRotation);
+    //
+
+    if (dot(intersection.normal, outDir) < 0.f)
+    {
+        intersection.normal *= -1;
+    }
+
+    vec2 alpha = material.alpha;
+
+    // Find the entrance direction
+    vec3 localOutDir = worldToLocal(intersection.normal, vec3(0.f, 0.f, 1.f)) * outDir;
+
+    if (localOutDir.z == 0.f) return vec3(0.f);
+
+    //
+    localOutDir = anisoRotation * localOutDir;
+    //
+
+    vec3 localMicroNormal = trowbridgeReitzSampleNormal(localOutDir, xi, alpha);
+    vec3 localInDir = reflect(-localOutDir, localMicroNormal);
+
+    if (localInDir.z * localOutDir.z <= 0.f) return vec3(0.f);
+
+    //
+    inDir = localToWorld(intersection.normal, vec3(0.f, 0.f, 1.f)) * anisoRotationInv * localInDir;
+    //
+    //inDir = localToWorld(intersection.normal) * localInDir;
+
+    // Compute the PDF
+    pdf = trowbridgeReitzPdf(localOutDir, localMicroNormal, alpha) / (4.f * dot(localOutDir, localMicroNormal));
+    return microfacetAttenuation(material, localOutDir, localInDir, alpha);
+}
+
+// BxDF evaluation functions
+// Each returns its BxDF for a given pair of directions, and in [pdf] the density its sampling function above picks [inDir] with
+
+// Microfacet lobes smoother than this are treated as mirrors, lights are not sampled from them
+#define SPECULAR_ALPHA 0.001f
+
+vec3 diffuseEval(Intersection intersection, Material material, vec3 outDir, vec3 inDir, out float pdf)
+{
+    pdf = 0.f;
+    if (dot(intersection.normal, outDir) < 0.f)
+    {
+        intersection.normal *= -1;
+    }
+
+    float cosThetaIn = dot(intersection.normal, inDir);
+    if (cosThetaIn <= 0.f) return vec3(0.f);
+
+    pdf = cosThetaIn * INV_PI;
+    return diffuseAttenuation(material);
+}
+
+// The density of the diffuse part depends on the sampled microfacet, it is approximated with the Fresnel term of the macro surface
+vec3 dielectricEval(Intersection intersection, Material material, vec3 outDir, vec3 inDir, out float pdf)
+{
+    pdf = 0.f;
+    vec2 roughness = max(vec2(material.roughness), vec2(SPECULAR_ALPHA));
+
+    mat3 toLocal = worldToLocal(intersection.normal);
+    vec3 localOutDir = toLocal * outDir;
+    vec3 localInDir = toLocal * inDir;
+    if (localOutDir.z == 0.f || localInDir.z == 0.f) return vec3(0.f);
+
+    bool exiting = localOutDir.z < 0.f;
+
+    if (localInDir.z * localOutDir.z > 0.f)
+    {
+        vec3 value = vec3(0.f);
+
+        // SPECULAR
+
+        vec3 localMicroNormal = normalize(localOutDir + localInDir);
+        if (localMicroNormal.z < 0.f) localMicroNormal = -localMicroNormal;
+
+        float reflectance = schlickFresnel(abs(dot(localOutDir, localMicroNormal)));
+        float reflectPdf = trowbridgeReitzPdf(localOutDir, localMicroNormal, roughness) / (4.f * dot(localOutDir, localMicroNormal)) * reflectance;
+
+        // Reflections sampled with a negative density are dropped by the sampling function
+        if (reflectPdf > 0.f)
+        {
+            float distribution = trowbridgeReitzDistribution(localMicroNormal, roughness);
+            float masking = trowbridgeReitzMasking(localOutDir, localInDir, roughness);
+
+            pdf += reflectPdf;
+            value += vec3(distribution * masking * reflectance / (4 * cosTheta(localInDir) * cosTheta(localOutDir)));
+        }
+
+        // DIFFUSE, only sampled when entering
+
+        if (!exiting && material.transmission < 1.f)
+        {
+            float diffuseProb = (1.f - schlickFresnel(cosTheta(localOutDir))) * (1.f - material.transmission);
+
+            pdf += hemisphereCosinePDF(localInDir) * diffuseProb;
+            value += diffuseAttenuation(material);
+        }
+
+        return value;
+    }
+
+    // TRANSMITTANCE
+
+    // The microfacet normal refracting [outDir] into [inDir], on the side refract() expects for the relative index
+    float relativeEta = exiting ? 1.f / material.ior : material.ior;
+    vec3 localMicroNormal = normalize(localOutDir + localInDir * relativeEta);
+    if (localMicroNormal.z < 0.f) localMicroNormal = -localMicroNormal;
+    if ((dot(localOutDir, localMicroNormal) < 0.f) != exiting) return vec3(0.f);
+
+    float reflectance = schlickFresnel(abs(dot(localOutDir, localMicroNormal)));
+    float transmittance = 1.f - reflectance;
+    float transmitProb = exiting ? transmittance : transmittance * material.transmission;
+    if (transmitProb <= 0.f) return vec3(0.f);
+
+    float detDenom = dot(localInDir, localMicroNormal) + dot(localOutDir, localMicroNormal) / relativeEta;
+    float detMicro_detIn = abs(dot(localInDir, localMicroNormal)) / (detDenom * detDenom);
+    pdf = trowbridgeReitzPdf(localOutDir, localMicroNormal, roughness) * detMicro_detIn * transmitProb;
+
+    float distribution = trowbridgeReitzDistribution(localMicroNormal, roughness);
+    float masking = trowbridgeReitzMasking(localOutDir, localInDir, roughness);
+
+    return material.albedo *
+        (distribution * masking * transmittance * dot(localInDir, localMicroNormal) * dot(localOutDir, localMicroNormal) /
+        (cosTheta(localInDir) * cosTheta(localOutDir) * detDenom * detDenom));
+}
+
+vec3 microFacetEval(Intersection intersection, Material material, vec3 outDir, vec3 inDir, out float pdf)
+{
+    pdf = 0.f;
+    if (dot(intersection.normal, outDir) < 0.f)
+    {
+        intersection.normal *= -1;
+    }
+
+    vec2 alpha = max(material.alpha, vec2(SPECULAR_ALPHA));
+
+    mat3 toLocal = worldToLocal(intersection.normal, vec3(0.f, 0.f, 1.f));
+    vec3 localOutDir = toLocal * outDir;
+    vec3 localInDir = toLocal * inDir;
+    if (localInDir.z * localOutDir.z <= 0.f) return vec3(0.f);
+
+    vec3 localMicroNormal = normalize(localOutDir + localInDir);
+
+    pdf = trowbridgeReitzPdf(localOutDir, localMicroNormal, alpha) / (4.f * dot(localOutDir, localMicroNormal));
+    return microfacetAttenuation(material, localOutDir, localInDir, alpha);
+}
+
+// Generic BxDF sampling function
+
+#define LOBE_METALLIC   0
+#define LOBE_DIELECTRIC 1
+#define LOBE_DIFFUSE    2
+
+// Randomly picks the lobe a material is sampled with
+int chooseLobe(Material material)
+{
+    if (material.metallic >= sample1D()) return LOBE_METALLIC;
+    if ((material.flags & MATERIAL_DIELECTRIC) != 0u) return LOBE_DIELECTRIC;
+    return LOBE_DIFFUSE;
+}
+
+vec3 sampleLobe(int lobe, Intersection intersection, Material material, vec2 xi, vec3 outDir, out vec3 inDir, out float pdf)
+{
+    if (lobe == LOBE_METALLIC)
+    {
+        return microFacetBxDF(intersection, material, xi, outDir, inDir, pdf);
+    }
+
+    if (lobe == LOBE_DIELECTRIC)
+    {
+        return dielectricBxDF(intersection, material, xi, outDir, inDir, pdf);
+    }
+
+    return diffuseBxDF(intersection, material, xi, outDir, inDir, pdf);
+}
+
+vec3 evaluateLobe(int lobe, Intersection intersection, Material material, vec3 outDir, vec3 inDir, out float pdf)
+{
+    if (lobe == LOBE_METALLIC)
+    {
+        return microFacetEval(intersection, material, outDir, inDir, pdf);
+    }
+
+    if (lobe == LOBE_DIELECTRIC)
+    {
+        return dielectricEval(intersection, material, outDir, inDir, pdf);
+    }
+
+    return diffuseEval(intersection, material, outDir, inDir, pdf);
+}
+
+// Whether a lobe scatters enough light off its mirror direction for light sampling to pay off
+bool canSampleLights(int lobe, Material material)
+{
+    if (lobe == LOBE_METALLIC) return max(material.alpha.x, material.alpha.y) >= SPECULAR_ALPHA;
+    if (lobe == LOBE_DIELECTRIC) return material.roughness >= SPECULAR_ALPHA || material.transmission < 1.f;
+    return true;
+}
@@ -0,0 +1,58 @@
+#version 460
+
+#include "adaptive.glsl"
+
+// One workgroup per tile of the error map
+layout(local_size_x = ERROR_TILE_SIZE, local_size_y = ERROR_TILE_SIZE) in;
+
+// Front accumulation target
+layout(location = 4) uniform sampler2D accumTexture;
+layout(location = 21) uniform usampler2D sampleCountTexture;
+
+layout(binding = 0, rg32f) writeonly uniform image2D errorImage;
+
+shared float tileError[ERROR_TILE_SIZE * ERROR_TILE_SIZE];
+shared float tileSquaredError[ERROR_TILE_SIZE * ERROR_TILE_SIZE];
+shared uint tilePixels[ERROR_TILE_SIZE * ERROR_TILE_SIZE];
+
+// Averages the relative error of the pixels of every tile and sums their relative MSE
+// A tile's error is unknown until all its pixels have two samples
+void main()
+{
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 resolution = textureSize(accumTexture, 0);
+    uint local = gl_LocalInvocationIndex;
+
+    bool inside = all(lessThan(pixel, resolution));
+    tileError[local] = 0.f;
+    tileSquaredError[local] = 0.f;
+    tilePixels[local] = 0u;
+    if (inside)
+    {
+        vec3 mean = texelFetch(accumTexture, pixel, 0).rgb;
+        float moment = texelFetch(momentTexture, pixel, 0).r;
+        uint sampleCount = texelFetch(sampleCountTexture, pixel, 0).r;
+        float error = pixelError(mean, moment, sampleCount);
+        tileError[local] = error;
+        tileSquaredError[local] = min(error * error, UNKNOWN_ERROR);
+        tilePixels[local] = 1u;
+    }
+    barrier();
+
+    // Tree reduction over the tile
+    for (uint stride = ERROR_TILE_SIZE * ERROR_TILE_SIZE / 2; stride > 0u; stride /= 2u)
+    {
+        if (local < stride)
+        {
+            tileError[local] += tileError[local + stride];
+            tileSquaredError[local] += tileSquaredError[local + stride];
+            tilePixels[local] += tilePixels[local + stride];
+        }
+        barrier();
+    }
+
+    if (local == 0u)
+    {
+        imageStore(errorImage, ivec2(gl_WorkGroupID.xy), vec4(tileError[0] / float(tilePixels[0]), tileSquaredError[0], 0.f, 0.f));
+    }
+}
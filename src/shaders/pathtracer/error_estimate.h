@@ -0,0 +1,14 @@
+// Constants of the per-pixel error estimates shared by the renderer and CPU path tracer (C++) and adaptive.glsl (GLSL)
+// Keep to preprocessor definitions so it stays valid in both languages
+
+#ifndef ERROR_ESTIMATE_H
+#define ERROR_ESTIMATE_H
+
+// Side of the square tiles of pixels sharing one entry of the error map
+#define ERROR_TILE_SIZE 8
+// Error of the pixels with too few samples to estimate it
+#define UNKNOWN_ERROR 1e30f
+// Keeps the relative error of nearly black pixels from blowing up
+#define ERROR_LUMINANCE_FLOOR 0.01f
+
+#endif
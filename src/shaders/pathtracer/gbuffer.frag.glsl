@@ -0,0 +1,36 @@
+#version 460
+
+#include "scene.glsl"
+#include "sampling.glsl"
+
+layout(location = 0) in vec2 texCoords;
+
+// First hit of the ray through the middle of the pixel's jitter
+layout(location = 0) out vec4 out_albedo;
+layout(location = 1) out vec4 out_normal;
+// Distance along the ray and its largest screen space derivative
+layout(location = 2) out vec2 out_depth;
+layout(location = 3) out vec4 out_position;
+
+// Lights and the background keep their radiance through a white albedo and have no normal
+// The background lies far along the ray
+void main()
+{
+    Ray ray = cameraRay(gl_FragCoord.xy + vec2(0.5f));
+
+    Intersection intersection;
+    bool hit = intersect(ray, intersection);
+    vec3 albedo = vec3(1.f);
+    vec3 normal = vec3(0.f);
+    float depth = hit ? intersection.t : 1e30f;
+    if (hit && intersection.type != LIGHT)
+    {
+        albedo = getMaterial(intersection.material).albedo;
+        normal = intersection.normal;
+    }
+
+    out_albedo = vec4(albedo, 1.f);
+    out_normal = vec4(normal, 0.f);
+    out_depth = vec2(depth, max(abs(dFdx(depth)), abs(dFdy(depth))));
+    out_position = vec4(ray.origin + ray.direction * depth, 1.f);
+}
@@ -0,0 +1,206 @@
+// Light selection and next event estimation with multiple importance sampling
+// Expects scene.glsl, sampling.glsl and bxdf.glsl to be included first
+
+// Below this solid angle spherical rectangle sampling loses precision and lights are sampled by area instead
+#define MIN_SPHERICAL_SOLID_ANGLE 3e-4f
+
+float getLightPower(int index)
+{
+    return texelFetch(lightTex, index * LIGHT_SIZE + LIGHT_RADIANCE).w;
+}
+
+float totalLightPower()
+{
+    float power = 0.f;
+    for (int i = 0; i < int(lightCount[0]); ++i)
+    {
+        power += getLightPower(i);
+    }
+
+    return power;
+}
+
+// Lights are picked proportionally to their power
+float lightSelectionPdf(int index)
+{
+    float power = totalLightPower();
+    return power > 0.f ? getLightPower(index) / power : 0.f;
+}
+
+// Returns -1 when no light emits
+int chooseLight(float xi, out float selectionPdf)
+{
+    selectionPdf = 0.f;
+    float power = totalLightPower();
+    if (power <= 0.f) return -1;
+
+    float target = xi * power;
+    float cumulative = 0.f;
+    int chosen = -1;
+    for (int i = 0; i < int(lightCount[0]); ++i)
+    {
+        float lightPower = getLightPower(i);
+        if (lightPower <= 0.f) continue;
+
+        // Falls back to the last emitting light when rounding leaves the target past the sum
+        chosen = i;
+        cumulative += lightPower;
+        if (target < cumulative) break;
+    }
+
+    selectionPdf = getLightPower(chosen) / power;
+    return chosen;
+}
+
+// A light's rectangle as seen from [origin], for uniform solid angle sampling (Urena et al. 2013)
+// The frame's x and y run along the rectangle's edges, its z points away from [origin]
+struct SphericalRectangle
+{
+    vec3 origin;
+    mat3 frame;
+    // Rectangle corners [x0, y0, x1, y1] in the frame
+    vec4 bounds;
+    float z0;
+    float b0;
+    float b1;
+    float k;
+    float solidAngle;
+};
+
+SphericalRectangle sphericalRectangle(Light light, vec3 origin)
+{
+    SphericalRectangle rect;
+    rect.origin = origin;
+    rect.solidAngle = 0.f;
+
+    vec3 edgeX = vec3(light.transform[0]);
+    vec3 edgeY = vec3(light.transform[1]);
+    float lengthX = length(edgeX);
+    float lengthY = length(edgeY);
+
+    vec3 x = edgeX / lengthX;
+    vec3 y = edgeY / lengthY;
+    vec3 z = cross(x, y);
+
+    vec3 toCorner = vec3(light.transform * vec4(-0.5f, -0.5f, 0.f, 1.f)) - origin;
+    rect.z0 = dot(toCorner, z);
+    if (rect.z0 > 0.f)
+    {
+        z = -z;
+        rect.z0 = -rect.z0;
+    }
+
+    rect.frame = mat3(x, y, z);
+    rect.bounds.xy = vec2(dot(toCorner, x), dot(toCorner, y));
+    rect.bounds.zw = rect.bounds.xy + vec2(lengthX, lengthY);
+
+    // Seen edge-on
+    if (rect.z0 == 0.f) return rect;
+
+    // Normals of the planes through [origin] and each edge
+    vec3 n0 = normalize(vec3(0.f, rect.z0, -rect.bounds.y));
+    vec3 n1 = normalize(vec3(-rect.z0, 0.f, rect.bounds.z));
+    vec3 n2 = normalize(vec3(0.f, -rect.z0, rect.bounds.w));
+    vec3 n3 = normalize(vec3(rect.z0, 0.f, -rect.bounds.x));
+
+    // Interior angles of the spherical rectangle
+    float g0 = acos(clamp(-dot(n0, n1), -1.f, 1.f));
+    float g1 = acos(clamp(-dot(n1, n2), -1.f, 1.f));
+    float g2 = acos(clamp(-dot(n2, n3), -1.f, 1.f));
+    float g3 = acos(clamp(-dot(n3, n0), -1.f, 1.f));
+
+    rect.b0 = n0.z;
+    rect.b1 = n2.z;
+    rect.k = 2.f * PI - g2 - g3;
+    rect.solidAngle = max(0.f, g0 + g1 - rect.k);
+
+    return rect;
+}
+
+vec3 sampleSphericalRectangle(SphericalRectangle rect, vec2 xi)
+{
+    float x0 = rect.bounds.x, y0 = rect.bounds.y, x1 = rect.bounds.z, y1 = rect.bounds.w;
+
+    // Horizontal coordinate from the sub-rectangle area
+    float au = xi.x * rect.solidAngle + rect.k;
+    float fu = (cos(au) * rect.b0 - rect.b1) / sin(au);
+    float cu = clamp((fu > 0.f ? 1.f : -1.f) / sqrt(fu * fu + rect.b0 * rect.b0), -1.f, 1.f);
+    float xu = clamp(-(cu * rect.z0) / max(sqrt(1.f - cu * cu), 1e-7f), x0, x1);
+
+    // Vertical coordinate, uniform in the height of the projected segment
+    float d = sqrt(xu * xu + rect.z0 * rect.z0);
+    float h0 = y0 / sqrt(d * d + y0 * y0);
+    float h1 = y1 / sqrt(d * d + y1 * y1);
+    float hv = mix(h0, h1, xi.y);
+    float hv2 = hv * hv;
+    float yv = hv2 < 1.f - 1e-6f ? hv * d / sqrt(1.f - hv2) : y1;
+
+    return rect.origin + rect.frame * vec3(xu, yv, rect.z0);
+}
+
+// Solid angle density of light sampling from [rect]'s origin picking the point [distance] away along [direction]
+float lightPdf(Light light, SphericalRectangle rect, float selectionPdf, vec3 direction, float distance)
+{
+    float cosThetaLight = -dot(light.normal, direction);
+    if (cosThetaLight <= 0.f) return 0.f;
+
+    if (rect.solidAngle >= MIN_SPHERICAL_SOLID_ANGLE) return selectionPdf / rect.solidAngle;
+
+    return selectionPdf * distance * distance / (light.area * cosThetaLight);
+}
+
+// Power heuristic with an exponent of 2
+float powerHeuristic(float pdf, float otherPdf)
+{
+    if (pdf <= 0.f) return 0.f;
+
+    float ratio = otherPdf / pdf;
+    return 1.f / (1.f + ratio * ratio);
+}
+
+// MIS weight of a light reached through a BxDF sample of density [bxdfPdf]
+// A zero density marks a vertex lights were not sampled from, which keeps the full radiance
+float lightHitWeight(Intersection intersection, Ray ray, float bxdfPdf)
+{
+    if (bxdfPdf <= 0.f) return 1.f;
+
+    Light light = getLight(intersection.index);
+    float pdf = lightPdf(light, sphericalRectangle(light, ray.origin), lightSelectionPdf(intersection.index), ray.direction, intersection.t);
+    return powerHeuristic(bxdfPdf, pdf);
+}
+
+// Samples a point on a light from the surface at [position] and returns the radiance it sends along [outDir]
+// The radiance only counts if nothing blocks [shadowRay] before [maxDistance], a zero [maxDistance] means there is nothing to trace
+vec3 sampleLight(int lobe, Intersection intersection, Material material, vec3 position, vec3 outDir, out Ray shadowRay, out float maxDistance)
+{
+    shadowRay = Ray(position, outDir);
+    maxDistance = 0.f;
+
+    float selectionPdf;
+    int index = chooseLight(sample1D(), selectionPdf);
+    vec2 xi = sample2D();
+    if (index < 0) return vec3(0.f);
+
+    // Lights are unit squares in the xy plane of their transform, sampled by solid angle unless they look tiny
+    Light light = getLight(index);
+    SphericalRectangle rect = sphericalRectangle(light, position);
+    vec3 lightPoint = rect.solidAngle >= MIN_SPHERICAL_SOLID_ANGLE
+        ? sampleSphericalRectangle(rect, xi)
+        : vec3(light.transform * vec4(xi - vec2(0.5f), 0.f, 1.f));
+
+    vec3 toLight = lightPoint - position;
+    float distance = length(toLight);
+    vec3 inDir = toLight / distance;
+
+    float pdf = lightPdf(light, rect, selectionPdf, inDir, distance);
+    if (pdf <= 0.f) return vec3(0.f);
+
+    float bxdfPdf;
+    vec3 bxdf = evaluateLobe(lobe, intersection, material, outDir, inDir, bxdfPdf);
+    if (bxdfPdf <= 0.f) return vec3(0.f);
+
+    shadowRay = Ray(position + inDir * 0.0001f, inDir);
+    maxDistance = distance - 0.0002f;
+
+    return light.radiance * bxdf * abs(dot(intersection.normal, inDir)) / pdf * powerHeuristic(pdf, bxdfPdf);
+}
@@ -0,0 +1,38 @@
+// Packed material record shared by the scene (C++) and the path tracer (GLSL)
+// Keep to preprocessor definitions and the record struct so it stays valid in both languages
+// C++ includes it after glm with the glm namespace in scope
+
+#ifndef MATERIAL_RECORD_H
+#define MATERIAL_RECORD_H
+
+// Bump whenever the record layout changes
+#define MATERIAL_RECORD_VERSION 1
+
+// Shader storage buffer binding of the material records
+#define MATERIAL_BINDING 0
+
+// Lobe flags
+#define MATERIAL_METALLIC     1u
+#define MATERIAL_DIELECTRIC   2u
+#define MATERIAL_TRANSMISSIVE 4u
+#define MATERIAL_ANISOTROPIC  8u
+
+// Layout of MaterialRecord::bits, metallic and transmission as unorms followed by the lobe flags
+#define MATERIAL_METALLIC_OFFSET     0
+#define MATERIAL_TRANSMISSION_OFFSET 12
+#define MATERIAL_FLAGS_OFFSET        24
+#define MATERIAL_UNORM_BITS          12
+#define MATERIAL_UNORM_MAX           4095u
+
+// Two vec4s under std430
+struct MaterialRecord
+{
+    vec3 albedo;
+    float roughness;
+    // Microfacet roughness along the tangent and bitangent
+    vec2 alpha;
+    float ior;
+    uint bits;
+};
+
+#endif
@@ -0,0 +1,46 @@
+#version 460
+
+#include "adaptive.glsl"
+
+#define NOISE_GROUP_SIZE 256
+
+// A single workgroup reduces the whole error map
+layout(local_size_x = NOISE_GROUP_SIZE) in;
+
+// Front accumulation target, for the number of pixels
+layout(location = 4) uniform sampler2D accumTexture;
+
+layout(binding = 0, r32f) writeonly uniform image2D noiseImage;
+
+shared float squaredError[NOISE_GROUP_SIZE];
+
+// Mean relative MSE over the pixels of the image, from the per tile sums of the error map
+void main()
+{
+    ivec2 tiles = textureSize(errorTexture, 0);
+    int tileCount = tiles.x * tiles.y;
+    uint local = gl_LocalInvocationIndex;
+
+    float sum = 0.f;
+    for (int tile = int(local); tile < tileCount; tile += NOISE_GROUP_SIZE)
+    {
+        sum += texelFetch(errorTexture, ivec2(tile % tiles.x, tile / tiles.x), 0).g;
+    }
+    squaredError[local] = sum;
+    barrier();
+
+    for (uint stride = NOISE_GROUP_SIZE / 2; stride > 0u; stride /= 2u)
+    {
+        if (local < stride)
+        {
+            squaredError[local] += squaredError[local + stride];
+        }
+        barrier();
+    }
+
+    if (local == 0u)
+    {
+        ivec2 resolution = textureSize(accumTexture, 0);
+        imageStore(noiseImage, ivec2(0), vec4(squaredError[0] / float(resolution.x * resolution.y)));
+    }
+}
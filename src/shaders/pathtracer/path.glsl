@@ -0,0 +1,107 @@
+// Path tracing loop and accumulation of a pixel, shared by the fragment and tiled path tracers
+// Expects scene.glsl, sampling.glsl, bxdf.glsl, lights.glsl, adaptive.glsl and visibility.glsl to be included first
+
+// Front accumulation target, the updated means and sample count go to the back target
+layout(location = 4) uniform sampler2D accumTexture;
+layout(location = 21) uniform usampler2D sampleCountTexture;
+layout(location = 22) uniform uint samplesPerPass;
+// Segments traced per path at most, and the number after which paths are terminated by Russian roulette
+layout(location = 27) uniform uint maxDepth;
+layout(location = 28) uniform uint rouletteDepth;
+
+// Traces one path through [pixel], [sampleIndex] selects its random sequence
+// Lights are reached both by BxDF sampling and by sampling them at every vertex, the two weighted by MIS
+vec3 tracePath(ivec2 pixel, uint sampleIndex)
+{
+    // Window coordinates of the pixel center, as gl_FragCoord.xy
+    vec2 pixelCenter = vec2(pixel) + vec2(0.5f);
+
+    startSampler(uvec2(pixel), sampleIndex);
+    Ray ray = primaryRay(pixelCenter);
+
+    Intersection intersection;
+
+    vec3 attenuation = vec3(1.f);
+    vec3 radiance = vec3(0.f);
+    // Density of the BxDF sample that led to the current vertex, zero if lights were not sampled at the previous one
+    float bxdfPdf = 0.f;
+    for (uint i = 0u; i < maxDepth; ++i)
+    {
+        bool hit = i == 0u && rasterPrimary ? visibleIntersection(ray, pixel, intersection) : intersect(ray, intersection);
+        if (!hit) break;
+
+        if (intersection.type == LIGHT)
+        {
+            radiance += attenuation * intersection.radiance * lightHitWeight(intersection, ray, bxdfPdf);
+            break;
+        }
+
+        // The last bounce only looks for lights
+        if (i + 1u >= maxDepth) break;
+
+        vec2 xi = sample2D();
+        Material material = getMaterial(intersection.material);
+        int lobe = chooseLobe(material);
+
+        vec3 outDir = -ray.direction;
+        vec3 position = ray.origin + ray.direction * intersection.t;
+        vec3 inDir;
+        float pdf;
+
+        vec3 bxdf = sampleLobe(lobe, intersection, material, xi, outDir, inDir, pdf);
+
+        bxdfPdf = 0.f;
+        if (canSampleLights(lobe, material))
+        {
+            Ray shadowRay;
+            float maxDistance;
+            vec3 lightRadiance = sampleLight(lobe, intersection, material, position, outDir, shadowRay, maxDistance);
+            if (maxDistance > 0.f && !occluded(shadowRay, maxDistance))
+            {
+                radiance += attenuation * lightRadiance;
+            }
+
+            if (pdf > 0.f) evaluateLobe(lobe, intersection, material, outDir, inDir, bxdfPdf);
+        }
+
+        if (pdf <= 0.f) break;
+
+        attenuation *= bxdf * abs(dot(intersection.normal, inDir));
+        attenuation /= pdf;
+
+        if (i + 1u >= rouletteDepth && !russianRoulette(attenuation)) break;
+
+        ray = Ray(position + inDir * 0.0001f, inDir);
+    }
+
+    return radiance;
+}
+
+// Traces the samples of a pass through [pixel] and gets its updated running means and sample count for the back target
+void accumulatePixel(ivec2 pixel, out vec4 color, out uint sampleCount, out float moment)
+{
+    vec3 accumCol = texelFetch(accumTexture, pixel, 0).rgb;
+    sampleCount = texelFetch(sampleCountTexture, pixel, 0).r;
+    moment = texelFetch(momentTexture, pixel, 0).r;
+
+    // Converged pixels carry their accumulation over to the back target
+    if (converged(pixel, sampleCount))
+    {
+        color = vec4(accumCol, 1.f);
+        return;
+    }
+
+    // The pixel's sequence continues where it stopped, converged pixels skipping passes leave no gaps in it
+    vec3 passCol = vec3(0.f);
+    float passSquares = 0.f;
+    for (uint i = 0u; i < samplesPerPass; ++i)
+    {
+        vec3 sampleCol = tracePath(pixel, sampleCount + i);
+        passCol += sampleCol;
+        passSquares += luminance(sampleCol) * luminance(sampleCol);
+    }
+
+    color = vec4((accumCol * sampleCount + passCol) / (sampleCount + samplesPerPass), 1.f);
+    moment = (moment * sampleCount + passSquares) / (sampleCount + samplesPerPass);
+    sampleCount += samplesPerPass;
+}
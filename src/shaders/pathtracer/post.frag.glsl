@@ -1,18 +1,76 @@
 #version 460
 
+#include "adaptive.glsl"
+
 layout(location = 0) uniform sampler2D inTexture;
+// 0 shows the image, 1 the error map
+layout(location = 1) uniform int view;
+// Set when [inTexture] is smaller than the window, while the camera moves
+layout(location = 2) uniform bool upscale;
 
 layout(location = 0) in vec2 texCoords;
 
 layout(location = 0) out vec4 out_color;
 
-void main()
+// Difference of the tonemapped colors of two texels at which their blend weight drops to 1/e while upscaling
+#define UPSCALE_EDGE_SIGMA 0.2f
+
+vec3 tonemap(vec3 color)
 {
-	vec3 color = texture(inTexture, texCoords).rgb;
 	// Reinhard operator
 	color = color / (vec3(1.f) + color);
 	// Gamma correction
-	color = pow(color, vec3(1.f / 2.2f));
+	return pow(color, vec3(1.f / 2.2f));
+}
+
+// Bilinear upscale of [inTexture] that keeps edges, the four texels around the pixel are weighted by how close they are to the nearest one
+vec3 upscaleEdgeAware()
+{
+	ivec2 size = textureSize(inTexture, 0);
+	vec2 position = texCoords * vec2(size) - 0.5f;
+	ivec2 base = ivec2(floor(position));
+	vec2 f = position - vec2(base);
+
+	vec3 nearest = tonemap(texelFetch(inTexture, clamp(ivec2(round(position)), ivec2(0), size - 1), 0).rgb);
+	vec3 color = vec3(0.f);
+	float weightSum = 0.f;
+	for (int i = 0; i < 4; ++i)
+	{
+		ivec2 offset = ivec2(i & 1, i >> 1);
+		vec3 tap = tonemap(texelFetch(inTexture, clamp(base + offset, ivec2(0), size - 1), 0).rgb);
+
+		vec2 bilinear = mix(1.f - f, f, vec2(offset));
+		vec3 difference = (tap - nearest) / UPSCALE_EDGE_SIGMA;
+		float weight = bilinear.x * bilinear.y * exp(-dot(difference, difference));
+		color += tap * weight;
+		weightSum += weight;
+	}
+
+	// The nearest texel always has a bilinear weight of at least 1/4
+	return color / weightSum;
+}
+
+// Blue through green to red as [t] goes from 0 to 1
+vec3 heatMap(float t)
+{
+	return clamp(vec3(1.5f - abs(4.f * t - vec3(3.f, 2.f, 1.f))), 0.f, 1.f);
+}
+
+void main()
+{
+	vec3 color = upscale ? upscaleEdgeAware() : tonemap(texture(inTexture, texCoords).rgb);
+
+	if (view == 1)
+	{
+		// Relative error from 0.1% to 100% on a log scale, over a faint copy of the image
+		ivec2 pixel = ivec2(texCoords * vec2(textureSize(inTexture, 0)));
+		float error = texelFetch(errorTexture, pixel / ERROR_TILE_SIZE, 0).r;
+		vec3 heat = heatMap(clamp((log(error) / log(10.f) + 3.f) / 3.f, 0.f, 1.f));
+		color = mix(heat, vec3(luminance(color)), 0.25f);
+
+		// Tiles adaptive sampling skips
+		if (error < adaptiveThreshold) color *= 0.35f;
+	}
 
 	out_color = vec4(color, 1.f);
-}
\ No newline at end of file
+}
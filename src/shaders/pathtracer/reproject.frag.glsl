@@ -0,0 +1,105 @@
+#version 460
+
+// Carries the accumulation over to a new view of the scene
+// Every pixel's first hit is projected into the previous view and the accumulation is resampled bilinearly there
+// Taps that hit another surface in the previous view are rejected, pixels without any start over
+
+// First hits of the new view
+layout(location = 0) uniform sampler2D positionTexture;
+layout(location = 1) uniform sampler2D normalTexture;
+// First hits of the previous view
+layout(location = 2) uniform sampler2D previousPositionTexture;
+layout(location = 3) uniform sampler2D previousNormalTexture;
+
+// Front accumulation target, taken from the previous view
+layout(location = 4) uniform sampler2D accumTexture;
+layout(location = 21) uniform usampler2D sampleCountTexture;
+layout(location = 29) uniform sampler2D momentTexture;
+
+// Camera of the previous view
+layout(location = 5) uniform vec3 previousEye;
+layout(location = 6) uniform vec3 previousForward;
+layout(location = 7) uniform vec3 previousUp;
+layout(location = 8) uniform vec3 previousRight;
+layout(location = 9) uniform uvec2 resolution;
+
+layout(location = 0) in vec2 texCoords;
+
+layout(location = 0) out vec4 out_color;
+layout(location = 1) out uint out_sampleCount;
+layout(location = 2) out float out_moment;
+
+// Matches sampling.glsl
+const float FOVY = radians(19.5f);
+
+// Distance between the hits of a tap, relative to their distance from the previous eye, beyond which they are different surfaces
+#define POSITION_TOLERANCE 0.02f
+#define MIN_NORMAL_COSINE 0.9f
+// Samples a pixel keeps at most, so view dependent shading and resampling blur fade out
+#define MAX_HISTORY 32.f
+
+// Lights and the background have no normal and only match each other
+bool sameSurface(vec3 position, vec3 normal, ivec2 previousPixel, float distance)
+{
+    vec3 previousPosition = texelFetch(previousPositionTexture, previousPixel, 0).xyz;
+    vec3 previousNormal = texelFetch(previousNormalTexture, previousPixel, 0).xyz;
+
+    bool noNormal = dot(normal, normal) == 0.f;
+    bool previousNoNormal = dot(previousNormal, previousNormal) == 0.f;
+    if (noNormal || previousNoNormal) return noNormal && previousNoNormal;
+
+    return length(previousPosition - position) <= POSITION_TOLERANCE * distance && dot(normal, previousNormal) >= MIN_NORMAL_COSINE;
+}
+
+void main()
+{
+    out_color = vec4(0.f);
+    out_sampleCount = 0u;
+    out_moment = 0.f;
+
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec3 position = texelFetch(positionTexture, pixel, 0).xyz;
+    vec3 normal = texelFetch(normalTexture, pixel, 0).xyz;
+
+    // Inverse of cameraRay() in sampling.glsl for the previous camera
+    vec3 toHit = position - previousEye;
+    float z = dot(toHit, previousForward);
+    if (z <= 0.f) return;
+
+    vec2 size = vec2(resolution);
+    float scale = tan(FOVY * 0.5f);
+    vec2 screenCoords = vec2(dot(toHit, previousRight) / (scale * size.x / size.y), dot(toHit, previousUp) / scale) / z;
+    // The G-buffer traces pixel i through window coordinate i + 1, the middle of its jitter
+    vec2 previousPixel = (screenCoords * 0.5f + 0.5f) * size - 1.f;
+
+    ivec2 base = ivec2(floor(previousPixel));
+    vec2 f = previousPixel - vec2(base);
+    float distance = length(toHit);
+
+    vec3 color = vec3(0.f);
+    float moment = 0.f;
+    float sampleCount = 0.f;
+    float weightSum = 0.f;
+    for (int i = 0; i < 4; ++i)
+    {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 tap = base + offset;
+        if (any(lessThan(tap, ivec2(0))) || any(greaterThanEqual(tap, ivec2(resolution)))) continue;
+
+        vec2 bilinear = mix(1.f - f, f, vec2(offset));
+        float weight = bilinear.x * bilinear.y;
+        if (weight <= 0.f || !sameSurface(position, normal, tap, distance)) continue;
+
+        color += texelFetch(accumTexture, tap, 0).rgb * weight;
+        moment += texelFetch(momentTexture, tap, 0).r * weight;
+        sampleCount += float(texelFetch(sampleCountTexture, tap, 0).r) * weight;
+        weightSum += weight;
+    }
+
+    // Pixels resting on the edge of the surface they hit are too uncertain to keep
+    if (weightSum < 0.25f) return;
+
+    out_color = vec4(color / weightSum, 1.f);
+    out_moment = moment / weightSum;
+    out_sampleCount = uint(min(sampleCount / weightSum, MAX_HISTORY) + 0.5f);
+}
@@ -0,0 +1,333 @@
+// Local shading frames, sample warping, the sampler and camera rays
+
+// =======================================
+// == Coordinate System transformations ==
+// =======================================
+
+// Compute tangent and bitangent
+void coordinateSystem(in vec3 v1, out vec3 v2, out vec3 v3)
+{
+    if (abs(v1.x) > abs(v1.y))
+    {
+        v2 = vec3(-v1.z, 0.f, v1.x) / sqrt(v1.x * v1.x + v1.z * v1.z);
+    }
+    else
+    {
+        v2 = vec3(0.f, v1.z, -v1.y) / sqrt(v1.y * v1.y + v1.z * v1.z);
+    }
+    v3 = cross(v1, v2);
+}
+
+// Local space assumes a normal of (0, 0, 1)
+
+mat3 localToWorld(vec3 normal)
+{
+    vec3 tangent, bitangent;
+    coordinateSystem(normal, tangent, bitangent);
+    return mat3(tangent, bitangent, normal);
+}
+
+mat3 localToWorld(vec3 normal, vec3 tangent)
+{
+    vec3 bitangent = cross(normal, tangent);
+    // Any frame will do for a tangent along the normal
+    if (dot(bitangent, bitangent) < 1e-12f) return localToWorld(normal);
+
+    bitangent = normalize(bitangent);
+    tangent = cross(bitangent, normal);
+    return mat3(tangent, bitangent, normal);
+}
+
+mat3 worldToLocal(vec3 normal, vec3 tangent)
+{
+    return transpose(localToWorld(normal, tangent));
+}
+
+mat3 worldToLocal(vec3 normal)
+{
+    return transpose(localToWorld(normal));
+}
+
+// ========================================
+// == Local space trigonometry functions ==
+// ========================================
+
+float cosTheta(vec3 v)
+{
+    return v.z;
+}
+
+float cos2Theta(vec3 v)
+{
+    return v.z * v.z;
+}
+
+float sin2Theta(vec3 v)
+{
+    return max(0.f, 1.f - cos2Theta(v));
+}
+
+float sinTheta(vec3 v)
+{
+    return sqrt(sin2Theta(v));
+}
+
+float tanTheta(vec3 v)
+{
+    return sinTheta(v) / cosTheta(v);
+}
+
+float tan2Theta(vec3 v)
+{
+    return sin2Theta(v) / cos2Theta(v);
+}
+
+float cosPhi(vec3 v)
+{
+    float sinTheta = sinTheta(v);
+    return (sinTheta == 0) ? 1 : clamp(v.x / sinTheta, -1.f, 1.f);
+}
+
+float sinPhi(vec3 v)
+{
+    float sinTheta = sinTheta(v);
+    return (sinTheta == 0) ? 0 : clamp(v.y / sinTheta, -1.f, 1.f);
+}
+
+float cos2Phi(vec3 v)
+{
+    float cosPhi = cosPhi(v);
+    return cosPhi * cosPhi;
+}
+
+float sin2Phi(vec3 v)
+{
+    float sinPhi = sinPhi(v);
+    return sinPhi * sinPhi;
+}
+
+// ========================
+// == Sampling Functions ==
+// ========================
+
+vec3 squareToDiskConcentric(vec2 xi)
+{
+    vec2 uv = xi * 2.f - vec2(1.f);
+    float x2 = uv.x * uv.x;
+    float y2 = uv.y * uv.y;
+
+    vec2 polar = vec2(0.f);
+    if(x2 > y2)
+    {
+        polar = vec2(uv.x, (PI / 4.f) * uv.y / uv.x);
+    }
+    else if (x2 <= y2 && y2 > 0.f)
+    {
+        polar = vec2(uv.y, (PI / 2.f) - (PI / 4.f) * uv.x / uv.y);
+    }
+
+    return vec3(
+        cos(polar.y) * polar.x,
+        sin(polar.y) * polar.x,
+        0.f
+        );
+}
+
+vec2 squareToUniformDiskPolar(vec2 xi)
+{
+    float r = sqrt(xi.x);
+    float theta = 2 * PI * xi.y;
+    return vec2(r * cos(theta), r * sin(theta));
+}
+
+vec3 squareToHemisphereCosine(vec2 xi)
+{
+    vec3 hemisphereSample = squareToDiskConcentric(xi);
+    hemisphereSample.z = sqrt(max(0.f, 1.f - hemisphereSample.x * hemisphereSample.x - hemisphereSample.y * hemisphereSample.y));
+    return hemisphereSample;
+}
+
+// =======================
+// == Utility Functions ==
+// =======================
+
+// Owen scrambled Sobol sampler (Burley 2020, "Practical Hash-based Owen Scrambling")
+// Every draw takes the next dimension of the path, each dimension shuffles the sample index and scrambles a 2D Sobol point with its own seed
+// Pixels seed their scrambles independently, so their sequences are decorrelated while each stays stratified over its samples
+// In blue noise mode the pixels share one scramble instead and every dimension of a pixel's samples is shifted by its rank in a blue noise tile
+// Each dimension reads the tile at its own toroidal shift, so neighbouring pixels differ in every direction and at every bounce
+// The error then varies with blue noise values, so low sample counts spread it apart rather than in clumps
+
+#define BLUE_NOISE_SIZE 64
+#define BLUE_NOISE_RANK_BITS 12
+
+layout(location = 25) uniform usampler2D blueNoiseTex;
+layout(location = 26) uniform bool blueNoise;
+
+uint samplerSeed;
+uvec2 samplerPixel;
+uint samplerIndex;
+uint samplerDimension;
+
+// PCG hash
+uint hash(uint x)
+{
+    uint state = x * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+uint hashCombine(uint seed, uint value)
+{
+    return seed ^ (value + 0x9e3779b9u + (seed << 6u) + (seed >> 2u));
+}
+
+// Scrambles the bits of [x] so that each one only depends on the seed and the bits above it (Laine-Karras permutation on the reversed bits)
+uint nestedUniformScramble(uint x, uint seed)
+{
+    x = bitfieldReverse(x);
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return bitfieldReverse(x);
+}
+
+// Point [index] of the first two Sobol dimensions, in closed form so no direction numbers are read
+// The first is the van der Corput sequence, the bit reversed index
+// The direction numbers of the second are the rows of Pascal's triangle mod 2, so bit j of its reversed point
+// is the XOR of the index bits k with C(k, j) odd, that is whose set bits include those of j (Lucas)
+uint sobol(uint index, int dimension)
+{
+    if (dimension == 1)
+    {
+        index ^= (index >> 1u) & 0x55555555u;
+        index ^= (index >> 2u) & 0x33333333u;
+        index ^= (index >> 4u) & 0x0f0f0f0fu;
+        index ^= (index >> 8u) & 0x00ff00ffu;
+        index ^= (index >> 16u) & 0x0000ffffu;
+    }
+    return bitfieldReverse(index);
+}
+
+// Starts the sequence of sample [sampleIndex] of [pixel]
+void startSampler(uvec2 pixel, uint sampleIndex)
+{
+    samplerSeed = blueNoise ? 0u : hash(pixel.x ^ hash(pixel.y));
+    samplerPixel = pixel;
+    samplerIndex = sampleIndex;
+    samplerDimension = 0u;
+}
+
+// Seed of the next dimension of the path, shuffling the sample index among the others of the pixel
+uint nextDimension(out uint index)
+{
+    uint seed = hashCombine(samplerSeed, hash(samplerDimension++));
+    index = nestedUniformScramble(samplerIndex, seed);
+    return seed;
+}
+
+// Blue noise shift of the component [component] of the current dimension as 32 bit fixed point, wrapping around [0, 1) through integer overflow
+// Zero unless blue noise is enabled
+uint blueNoiseOffset(uint component)
+{
+    if (!blueNoise) return 0u;
+
+    uint shift = hash(2u * samplerDimension + component);
+    uvec2 texel = (samplerPixel + uvec2(shift, shift >> 16u)) % BLUE_NOISE_SIZE;
+    return texelFetch(blueNoiseTex, ivec2(texel), 0).r << (32 - BLUE_NOISE_RANK_BITS);
+}
+
+// Keeps the 24 bits a float in [0, 1) can hold
+float toUnitFloat(uint x)
+{
+    return float(x >> 8u) * (1.f / 16777216.f);
+}
+
+float sample1D()
+{
+    uint offset = blueNoiseOffset(0u);
+    uint index;
+    uint seed = nextDimension(index);
+    return toUnitFloat(nestedUniformScramble(sobol(index, 0), hashCombine(seed, 0u)) + offset);
+}
+
+vec2 sample2D()
+{
+    uvec2 offset = uvec2(blueNoiseOffset(0u), blueNoiseOffset(1u));
+    uint index;
+    uint seed = nextDimension(index);
+    return vec2(toUnitFloat(nestedUniformScramble(sobol(index, 0), hashCombine(seed, 0u)) + offset.x),
+                toUnitFloat(nestedUniformScramble(sobol(index, 1), hashCombine(seed, 1u)) + offset.y));
+}
+
+// Randomly ends a path with a probability growing as its [throughput] drops, returns false if it ends
+// Survivors are weighted up by the inverse of their survival probability, which keeps the estimate unbiased
+bool russianRoulette(inout vec3 throughput)
+{
+    float survival = min(1.f, max(throughput.r, max(throughput.g, throughput.b)));
+    if (sample1D() >= survival) return false;
+
+    throughput /= survival;
+    return true;
+}
+
+const float FOVY = 19.5f * PI / 180.f;
+// Ray through [windowPosition], in window coordinates
+Ray cameraRay(vec2 windowPosition)
+{
+    vec2 screenCoords = windowPosition / resolution;
+    screenCoords = screenCoords * 2.f - vec2(1.f);
+
+    float aspectRatio = float(resolution.x) / resolution.y;
+    vec3 ref = eye + forward;
+    vec3 V = up * tan(FOVY * 0.5f);
+    vec3 H = right * tan(FOVY * 0.5f) * aspectRatio;
+    vec3 p = ref + H * screenCoords.x + V * screenCoords.y;
+
+    return Ray(eye, normalize(p - eye));
+}
+
+// [pixelCenter] is in window coordinates, as gl_FragCoord.xy, the ray is jittered by the next 2D sample
+Ray raycast(vec2 pixelCenter)
+{
+    return cameraRay(pixelCenter + sample2D());
+}
+
+// Transformation Matrices
+
+mat3 axisAngle(vec3 axis, float radians)
+{
+    float s = sin(radians);
+    float c = cos(radians);
+    float oc = 1.f - c;
+
+    return mat3(
+        oc * axis.x * axis.x + c,          oc * axis.x * axis.y - axis.z * s, oc * axis.z * axis.x + axis.y * s,
+        oc * axis.x * axis.y + axis.z * s, oc * axis.y * axis.y + c,          oc * axis.y * axis.z - axis.x * s,
+        oc * axis.z * axis.x - axis.y * s, oc * axis.y * axis.z + axis.x * s, oc * axis.z * axis.z + c
+        );
+}
+
+// Complex number operations
+
+// From https://gist.github.com/DonKarlssonSan/f87ba5e4e5f1093cb83e39024a6a5e72
+vec2 cxSqrt(vec2 a)
+{
+    float r = length(a);
+    float realPart = sqrt(0.5f * (r + a.x));
+    float imagPart = sqrt(max(0.f, 0.5f * (r - a.x)));
+    if (a.y < 0.f) imagPart = -imagPart;
+    return vec2(realPart, imagPart);
+}
+
+vec2 cxMul(vec2 a, vec2 b)
+{
+    return vec2(a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
+}
+
+vec2 cxDiv(vec2 a, vec2 b)
+{
+    return vec2(((a.x * b.x + a.y * b.y) / (b.x * b.x + b.y * b.y)), ((a.y * b.x - a.x * b.y) / (b.x * b.x + b.y * b.y)));
+}
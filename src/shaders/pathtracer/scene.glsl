@@ -0,0 +1,475 @@
+// Scene data, getters and ray intersection shared by the path tracing shaders
+// Expects #version and is included before sampling.glsl, bxdf.glsl and lights.glsl
+
+#define PI      3.14159265358979323
+#define INV_PI  0.31830988618379067
+#define IOR_AIR 1.0003
+
+// Triangle records [v0, edge1, edge2]
+#define TRIANGLE_SIZE 3
+
+// Vertex attributes
+#define NUM_VERTEX_ATTRIBUTES 2
+#define ATTRIBUTE_NORMAL 0
+#define ATTRIBUTE_TEXTURE_COORDINATE 1
+
+#include "material_record.h"
+
+// Light attributes
+#define LIGHT_RADIANCE      0
+#define LIGHT_TRANSFORM     1
+#define LIGHT_INV_TRANSFORM 5
+#define LIGHT_NORMAL        9
+#define LIGHT_SIZE          10
+
+// Object types
+#define GEOMETRY 0
+#define LIGHT 1
+
+// BVH traversal
+#define BVH_NODE_SIZE 2
+#include "traversal.h"
+
+// Instance attributes
+#define INSTANCE_INV_TRANSFORM 4
+#define INSTANCE_DATA          8
+#define INSTANCE_SIZE          9
+
+layout(location = 0) uniform uint instanceCount;
+layout(location = 1) uniform samplerBuffer indicesTex;
+
+layout(location = 2) uniform samplerBuffer verticesTex;
+layout(location = 3) uniform samplerBuffer vertexDataTex;
+
+layout(location = 6) uniform samplerBuffer lightTex;
+layout(location = 7) uniform uvec4 lightCount;
+
+layout(location = 9) uniform usamplerBuffer materialMapTex;
+
+layout(location = 10) uniform uvec2 resolution;
+layout(location = 11) uniform vec3 eye;
+layout(location = 12) uniform vec3 forward;
+layout(location = 13) uniform vec3 up;
+layout(location = 14) uniform vec3 right;
+
+// Nodes are stored as raw bits, float bounds next to integer indices that would be denormals or NaNs as floats
+layout(location = 15) uniform usamplerBuffer bvhTex;
+layout(location = 16) uniform usamplerBuffer tlasTex;
+// Raw bits like the nodes, the instances end in integer data
+layout(location = 17) uniform usamplerBuffer instanceTex;
+layout(location = 18) uniform samplerBuffer triangleTex;
+
+layout(std430, binding = MATERIAL_BINDING) readonly buffer MaterialBuffer
+{
+    MaterialRecord materials[];
+};
+
+struct Ray
+{
+    vec3 origin;
+    vec3 direction;
+};
+
+struct Intersection
+{
+    float t;
+    vec3 normal;
+    vec3 radiance;
+
+    int type;
+    int index;
+    int instance;
+    int material;
+    // Weights of the second and third triangle vertices
+    vec2 barycentric;
+};
+
+struct Light
+{
+    vec3 radiance;
+    float power;
+    mat4 transform;
+    mat4 invTransform;
+    vec3 normal;
+    float area;
+};
+
+struct Instance
+{
+    mat4 invTransform;
+    int rootNode;
+    int material;
+};
+
+struct BVHNode
+{
+    vec3 min;
+    int leftFirst;
+    vec3 max;
+    int count;
+};
+
+struct Material
+{
+    vec3 albedo;
+    float roughness;
+    vec2 alpha;
+    float metallic;
+    float ior;
+    float transmission;
+    uint flags;
+};
+
+// ==================
+// == Data Getters ==
+// ==================
+
+vec3 getVertexAttribute(int dataIndex, int vertexOffset, int vertexAttribute)
+{
+    return texelFetch(vertexDataTex, (dataIndex * 3 + vertexOffset) * NUM_VERTEX_ATTRIBUTES + vertexAttribute).xyz;
+}
+
+Light getLight(int index)
+{
+    int offset = index * LIGHT_SIZE;
+    vec4 radiancePower = texelFetch(lightTex, offset + LIGHT_RADIANCE);
+    mat4 transform, invTransform;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        transform[i] = texelFetch(lightTex, offset + LIGHT_TRANSFORM + i);
+        invTransform[i] = texelFetch(lightTex, offset + LIGHT_INV_TRANSFORM + i);
+    }
+
+    vec4 normalArea = texelFetch(lightTex, offset + LIGHT_NORMAL);
+
+    return Light(radiancePower.xyz, radiancePower.w, transform, invTransform, normalArea.xyz, normalArea.w);
+}
+
+BVHNode getBVHNode(usamplerBuffer nodeTex, int index)
+{
+    uvec4 minLeftFirst = texelFetch(nodeTex, index * BVH_NODE_SIZE);
+    uvec4 maxCount = texelFetch(nodeTex, index * BVH_NODE_SIZE + 1);
+
+    return BVHNode(uintBitsToFloat(minLeftFirst.xyz), int(minLeftFirst.w), uintBitsToFloat(maxCount.xyz), int(maxCount.w));
+}
+
+Instance getInstance(int index)
+{
+    int offset = index * INSTANCE_SIZE;
+    mat4 invTransform;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        invTransform[i] = uintBitsToFloat(texelFetch(instanceTex, offset + INSTANCE_INV_TRANSFORM + i));
+    }
+
+    // [mesh, rootNode, material, padding]
+    ivec4 data = ivec4(texelFetch(instanceTex, offset + INSTANCE_DATA));
+
+    return Instance(invTransform, data.y, data.z);
+}
+
+int getMaterialIndex(int triangleId)
+{
+    return int(texelFetch(materialMapTex, triangleId)[0]);
+}
+
+Material getMaterial(int index)
+{
+    MaterialRecord record = materials[index];
+
+    float metallic = float(bitfieldExtract(record.bits, MATERIAL_METALLIC_OFFSET, MATERIAL_UNORM_BITS)) / float(MATERIAL_UNORM_MAX);
+    float transmission = float(bitfieldExtract(record.bits, MATERIAL_TRANSMISSION_OFFSET, MATERIAL_UNORM_BITS)) / float(MATERIAL_UNORM_MAX);
+    uint flags = record.bits >> MATERIAL_FLAGS_OFFSET;
+
+    return Material(record.albedo, record.roughness, record.alpha, metallic, record.ior, transmission, flags);
+}
+
+// ============================
+// == Intersection Functions ==
+// ============================
+
+bool rectangleIntersect(Ray ray, mat4 inverseTransform, out float t)
+{
+    // default rectangle
+    // vec3 position = vec3(0.f, 0.f, 0.f);
+    // vec3 normal = vec3(0.f, 0.f, 1.f);
+    float halfLength = 0.5f;
+
+    ray.origin = vec3(inverseTransform * vec4(ray.origin, 1.f));
+    ray.direction = vec3(inverseTransform * vec4(ray.direction, 0.f));
+    float dt = -ray.direction.z;
+
+    // One-sided rectangles only
+    if (dt < 0.f) return false;
+    t = ray.origin.z / dt;
+    if (t < 0.f) return false;
+
+    vec3 p = ray.origin + ray.direction * t;
+
+    return (abs(p.x) <= halfLength && abs(p.y) <= halfLength);
+}
+
+// Returns the entry distance into the box, or infinity on a miss
+float boxIntersect(Ray ray, vec3 invDirection, vec3 boxMin, vec3 boxMax)
+{
+    vec3 t0 = (boxMin - ray.origin) * invDirection;
+    vec3 t1 = (boxMax - ray.origin) * invDirection;
+
+    vec3 tNear = min(t0, t1);
+    vec3 tFar = max(t0, t1);
+
+    float tEnter = max(max(tNear.x, tNear.y), max(tNear.z, 0.f));
+    float tExit = min(min(tFar.x, tFar.y), tFar.z);
+
+    return (tEnter <= tExit) ? tEnter : 1.f / 0.f;
+}
+
+// Two-sided Moller-Trumbore test against a precomputed triangle record
+bool triangleIntersect(Ray ray, int index, out float t, out vec2 barycentric)
+{
+    vec3 v0 = texelFetch(triangleTex, index * TRIANGLE_SIZE + 0).xyz;
+    vec3 e1 = texelFetch(triangleTex, index * TRIANGLE_SIZE + 1).xyz;
+    vec3 e2 = texelFetch(triangleTex, index * TRIANGLE_SIZE + 2).xyz;
+
+    vec3 p = cross(ray.direction, e2);
+    float determinant = dot(e1, p);
+    if (determinant == 0.f) return false;
+    float invDeterminant = 1.f / determinant;
+
+    vec3 s = ray.origin - v0;
+    barycentric.x = dot(s, p) * invDeterminant;
+    if (barycentric.x < 0.f || barycentric.x > 1.f) return false;
+
+    vec3 q = cross(s, e1);
+    barycentric.y = dot(ray.direction, q) * invDeterminant;
+    if (barycentric.y < 0.f || barycentric.x + barycentric.y > 1.f) return false;
+
+    t = dot(e2, q) * invDeterminant;
+    return t >= 0.f;
+}
+
+// Finds the closest triangle of a mesh, with the ray in the mesh's object space
+// With [anyHit] set, stops at the first triangle closer than intersection.t and returns true
+bool intersectMesh(Ray ray, int rootNode, int instance, bool anyHit, inout Intersection intersection)
+{
+    // Avoid 0 * inf in the slab test for axis aligned rays
+    vec3 safeDirection = mix(ray.direction, vec3(1e-20f), lessThan(abs(ray.direction), vec3(1e-20f)));
+    vec3 invDirection = 1.f / safeDirection;
+
+    // Pending nodes and their entry distances
+    int stack[BVH_STACK_SIZE];
+    float stackT[BVH_STACK_SIZE];
+    int stackSize = 0;
+
+    BVHNode node = getBVHNode(bvhTex, rootNode);
+    float tRoot = boxIntersect(ray, invDirection, node.min, node.max);
+    if (tRoot < intersection.t)
+    {
+        stack[stackSize] = rootNode;
+        stackT[stackSize++] = tRoot;
+    }
+
+    while (stackSize > 0)
+    {
+        --stackSize;
+        if (stackT[stackSize] > intersection.t) continue;
+
+        node = getBVHNode(bvhTex, stack[stackSize]);
+
+        if (node.count > 0)
+        {
+            for (int i = node.leftFirst; i < node.leftFirst + node.count; ++i)
+            {
+                float sample_t;
+                vec2 barycentric;
+                if (!triangleIntersect(ray, i, sample_t, barycentric) || sample_t > intersection.t) continue;
+
+                intersection.t = sample_t;
+                intersection.barycentric = barycentric;
+                intersection.index = i;
+                intersection.instance = instance;
+                intersection.type = GEOMETRY;
+
+                if (anyHit) return true;
+            }
+            continue;
+        }
+
+        // Visit the nearer child first, skipping any child beyond the closest hit
+        int near = node.leftFirst;
+        int far = node.leftFirst + 1;
+
+        BVHNode nearNode = getBVHNode(bvhTex, near);
+        BVHNode farNode = getBVHNode(bvhTex, far);
+        float tNear = boxIntersect(ray, invDirection, nearNode.min, nearNode.max);
+        float tFar = boxIntersect(ray, invDirection, farNode.min, farNode.max);
+
+        if (tFar < tNear)
+        {
+            float tSwap = tNear; tNear = tFar; tFar = tSwap;
+            int swap = near; near = far; far = swap;
+        }
+
+        if (tFar < intersection.t && stackSize < BVH_STACK_SIZE)
+        {
+            stack[stackSize] = far;
+            stackT[stackSize++] = tFar;
+        }
+        if (tNear < intersection.t && stackSize < BVH_STACK_SIZE)
+        {
+            stack[stackSize] = near;
+            stackT[stackSize++] = tNear;
+        }
+    }
+
+    return false;
+}
+
+// Finds the closest triangle of any instance, transforming the ray into each instance's object space
+// The object space direction is left unnormalized so distances along it match world space
+// With [anyHit] set, stops at the first triangle closer than intersection.t and returns true
+bool intersectInstances(Ray ray, bool anyHit, inout Intersection intersection)
+{
+    vec3 safeDirection = mix(ray.direction, vec3(1e-20f), lessThan(abs(ray.direction), vec3(1e-20f)));
+    vec3 invDirection = 1.f / safeDirection;
+
+    int stack[TLAS_STACK_SIZE];
+    float stackT[TLAS_STACK_SIZE];
+    int stackSize = 0;
+
+    BVHNode node = getBVHNode(tlasTex, 0);
+    float tRoot = boxIntersect(ray, invDirection, node.min, node.max);
+    if (tRoot < intersection.t)
+    {
+        stack[stackSize] = 0;
+        stackT[stackSize++] = tRoot;
+    }
+
+    while (stackSize > 0)
+    {
+        --stackSize;
+        if (stackT[stackSize] > intersection.t) continue;
+
+        node = getBVHNode(tlasTex, stack[stackSize]);
+
+        if (node.count > 0)
+        {
+            for (int i = node.leftFirst; i < node.leftFirst + node.count; ++i)
+            {
+                Instance instance = getInstance(i);
+                Ray localRay = Ray(
+                    (instance.invTransform * vec4(ray.origin, 1.f)).xyz,
+                    (instance.invTransform * vec4(ray.direction, 0.f)).xyz
+                    );
+
+                if (intersectMesh(localRay, instance.rootNode, i, anyHit, intersection)) return true;
+            }
+            continue;
+        }
+
+        int near = node.leftFirst;
+        int far = node.leftFirst + 1;
+
+        BVHNode nearNode = getBVHNode(tlasTex, near);
+        BVHNode farNode = getBVHNode(tlasTex, far);
+        float tNear = boxIntersect(ray, invDirection, nearNode.min, nearNode.max);
+        float tFar = boxIntersect(ray, invDirection, farNode.min, farNode.max);
+
+        if (tFar < tNear)
+        {
+            float tSwap = tNear; tNear = tFar; tFar = tSwap;
+            int swap = near; near = far; far = swap;
+        }
+
+        if (tFar < intersection.t && stackSize < TLAS_STACK_SIZE)
+        {
+            stack[stackSize] = far;
+            stackT[stackSize++] = tFar;
+        }
+        if (tNear < intersection.t && stackSize < TLAS_STACK_SIZE)
+        {
+            stack[stackSize] = near;
+            stackT[stackSize++] = tNear;
+        }
+    }
+
+    return false;
+}
+
+// Checks for any geometry along the ray closer than [maxDistance]
+// Lights do not occlude, and no shading data is fetched for the blocker
+bool occluded(Ray ray, float maxDistance)
+{
+    if (instanceCount == 0) return false;
+
+    Intersection intersection;
+    intersection.t = maxDistance;
+    intersection.type = -1;
+    intersection.index = -1;
+    intersection.instance = -1;
+
+    return intersectInstances(ray, true, intersection);
+}
+
+// Fetches the shading data of a hit whose type, index, distance and, for geometry, instance and barycentrics are known
+void completeIntersection(inout Intersection intersection)
+{
+    if (intersection.type == GEOMETRY)
+    {
+        vec4 triangle = texelFetch(indicesTex, intersection.index);
+        int dataInd = int(triangle.w);
+
+        Instance instance = getInstance(intersection.instance);
+        vec3 bary = vec3(1.f - intersection.barycentric.x - intersection.barycentric.y, intersection.barycentric);
+
+        vec3 n1 = getVertexAttribute(dataInd, 0, ATTRIBUTE_NORMAL);
+        vec3 n2 = getVertexAttribute(dataInd, 1, ATTRIBUTE_NORMAL);
+        vec3 n3 = getVertexAttribute(dataInd, 2, ATTRIBUTE_NORMAL);
+        vec3 localNormal = bary.x * n1 + bary.y * n2 + bary.z * n3;
+
+        // Normals transform by the inverse transpose
+        intersection.normal = normalize(transpose(mat3(instance.invTransform)) * localNormal);
+        intersection.material = instance.material >= 0 ? instance.material : getMaterialIndex(intersection.index);
+    }
+    else if (intersection.type == LIGHT)
+    {
+        Light light = getLight(intersection.index);
+        intersection.normal = light.normal;
+        intersection.radiance = light.radiance;
+    }
+}
+
+bool intersect(Ray ray, out Intersection intersection)
+{
+    intersection.t = 1.f / 0.f;
+    intersection.type = -1;
+    intersection.index = -1;
+    intersection.instance = -1;
+
+    // Geometry
+    if (instanceCount > 0)
+    {
+        intersectInstances(ray, false, intersection);
+    }
+
+    int lightIndex = 0;
+    for (; lightIndex < lightCount[0]; ++lightIndex)
+    {
+        Light areaLight = getLight(lightIndex);
+
+        float sample_t;
+        if (!rectangleIntersect(ray, areaLight.invTransform, sample_t)) continue;
+        if (sample_t < 0.f || sample_t > intersection.t) continue;
+
+        intersection.t = sample_t;
+        intersection.index = lightIndex;
+        intersection.type = LIGHT;
+    }
+
+    if (intersection.index == -1) return false;
+
+    completeIntersection(intersection);
+    return true;
+}
@@ -0,0 +1,123 @@
+#version 460
+#extension GL_ARB_shader_clock : enable
+
+#include "scene.glsl"
+#include "tiles.h"
+
+layout(local_size_x = TILE_GROUP_SIZE, local_size_y = TILE_GROUP_SIZE) in;
+
+// Side of the tiles in pixels, a multiple of TILE_GROUP_SIZE
+layout(location = 37) uniform uint tileSize;
+// Tiles of the dispatch in the tile order, [first, end)
+layout(location = 38) uniform uvec2 tileRange;
+// Adds the clock cycles every tile took to its time
+layout(location = 39) uniform bool tileProfiling;
+// Tiles a workgroup takes at most in this dispatch, the workgroups together can take every tile of the range
+layout(location = 40) uniform uint tilesPerGroup;
+
+// Back accumulation target, its format is chosen by the renderer
+layout(binding = TILE_ACCUMULATION_IMAGE) writeonly uniform image2D accumImage;
+layout(binding = TILE_SAMPLE_COUNT_IMAGE) writeonly uniform uimage2D sampleCountImage;
+layout(binding = TILE_MOMENT_IMAGE, r32f) writeonly uniform image2D momentImage;
+
+// Tiles handed out so far in this dispatch, and tiles finished so far in this pass, both starting from zero
+layout(std430, binding = TILE_COUNTER_BINDING) coherent buffer TileCounter
+{
+    uint nextTile;
+    uint completedTiles;
+};
+
+// Coordinates of every tile as x | y << 16, in the order they are handed out
+layout(std430, binding = TILE_ORDER_BINDING) readonly buffer TileOrder
+{
+    uint tileOrder[];
+};
+
+// Clock cycles of every tile as 64 bit [low, high], in the tile order
+layout(std430, binding = TILE_TIME_BINDING) buffer TileTimes
+{
+    uvec2 tileTimes[];
+};
+
+#include "sampling.glsl"
+#include "bxdf.glsl"
+#include "lights.glsl"
+#include "adaptive.glsl"
+#include "visibility.glsl"
+#include "path.glsl"
+
+// Tile the workgroup works on, taken by its first invocation
+shared uint tile;
+
+uvec2 readClock()
+{
+#ifdef GL_ARB_shader_clock
+    return clock2x32ARB();
+#else
+    return uvec2(0u);
+#endif
+}
+
+// Adds the cycles from [start] to [end] to the time of [tileIndex]
+void addTileTime(uint tileIndex, uvec2 start, uvec2 end)
+{
+    // A clock running backwards, as it can when the workgroup moved to another core, leaves the time as it is
+    if (end.y < start.y || (end.y == start.y && end.x < start.x)) return;
+
+    uint borrow;
+    uint low = usubBorrow(end.x, start.x, borrow);
+    uint high = end.y - start.y - borrow;
+
+    uint carry;
+    tileTimes[tileIndex].x = uaddCarry(tileTimes[tileIndex].x, low, carry);
+    tileTimes[tileIndex].y += high + carry;
+}
+
+// Persistent workgroups take tiles from the counter until the range of the dispatch is exhausted or they took their share
+// Fast tiles free their workgroup for the next one at once, instead of the slowest tiles of a full-screen draw holding up the rest
+// The share bounds how long any workgroup runs, so no invocation of a large dispatch loops over many tiles
+void main()
+{
+    for (uint taken = 0u; taken < tilesPerGroup; ++taken)
+    {
+        if (gl_LocalInvocationIndex == 0u)
+        {
+            tile = tileRange.x + atomicAdd(nextTile, 1u);
+        }
+        barrier();
+        uint tileIndex = tile;
+        // Every invocation has to read the tile before the next one is taken
+        barrier();
+
+        if (tileIndex >= tileRange.y) break;
+
+        uvec2 start = readClock();
+
+        uvec2 origin = uvec2(tileOrder[tileIndex] & 0xffffu, tileOrder[tileIndex] >> 16) * tileSize;
+        for (uint y = 0u; y < tileSize; y += TILE_GROUP_SIZE)
+        {
+            for (uint x = 0u; x < tileSize; x += TILE_GROUP_SIZE)
+            {
+                ivec2 pixel = ivec2(origin + uvec2(x, y) + gl_LocalInvocationID.xy);
+                if (any(greaterThanEqual(pixel, ivec2(resolution)))) continue;
+
+                vec4 color;
+                uint sampleCount;
+                float moment;
+                accumulatePixel(pixel, color, sampleCount, moment);
+
+                imageStore(accumImage, pixel, color);
+                imageStore(sampleCountImage, pixel, uvec4(sampleCount));
+                imageStore(momentImage, pixel, vec4(moment));
+            }
+        }
+
+        // A tile is done, and takes as long as its slowest invocation, once every invocation got here
+        barrier();
+        if (gl_LocalInvocationIndex == 0u)
+        {
+            if (tileProfiling) addTileTime(tileIndex, start, readClock());
+            atomicAdd(completedTiles, 1u);
+        }
+    }
+}
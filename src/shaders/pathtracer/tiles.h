@@ -0,0 +1,20 @@
+// Tile queue of the tiled path tracer shared by the renderer (C++) and tiled.comp.glsl (GLSL)
+// Keep to preprocessor definitions so it stays valid in both languages
+
+#ifndef TILES_H
+#define TILES_H
+
+// Side of the square workgroups, a tile is covered block by block by the workgroup that took it
+#define TILE_GROUP_SIZE 8
+
+// Shader storage buffer bindings, after the materials and the wavefront path tracer's buffers
+#define TILE_COUNTER_BINDING 6
+#define TILE_ORDER_BINDING   7
+#define TILE_TIME_BINDING    8
+
+// Image units of the back accumulation target
+#define TILE_ACCUMULATION_IMAGE 0
+#define TILE_SAMPLE_COUNT_IMAGE 1
+#define TILE_MOMENT_IMAGE       2
+
+#endif
@@ -0,0 +1,12 @@
+// Traversal stack sizes shared by the scene and CPU path tracer (C++) and scene.glsl (GLSL)
+// Keep to preprocessor definitions so it stays valid in both languages
+
+#ifndef TRAVERSAL_H
+#define TRAVERSAL_H
+
+// Nodes a traversal stack holds, enough for hierarchies of as many levels
+// The scene checks the depth of every hierarchy it builds against them
+#define BVH_STACK_SIZE 64
+#define TLAS_STACK_SIZE 32
+
+#endif
@@ -0,0 +1,18 @@
+#version 460
+
+// Writes [primitive, instance, barycentrics] of the nearest hit of every pixel, zero where nothing was hit
+
+layout(location = 35) uniform int instance;
+
+layout(location = 0) flat in uint primitive;
+layout(location = 1) flat in int frontFacing;
+layout(location = 2) in vec2 barycentric;
+
+layout(location = 0) out uvec4 out_visibility;
+
+void main()
+{
+    if (frontFacing == 0) discard;
+
+    out_visibility = uvec4(primitive, uint(max(instance, 0)), floatBitsToUint(barycentric));
+}
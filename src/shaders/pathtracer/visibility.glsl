@@ -0,0 +1,61 @@
+// Starts camera paths from the hits rasterized into the visibility buffer instead of tracing them
+// Expects scene.glsl and sampling.glsl to be included first
+
+// [primitive, instance, barycentrics] of every pixel written by visibility.frag.glsl
+// Triangles are stored as their index plus one, lights with the top bit set, zero is a miss
+#define VISIBILITY_LIGHT 0x80000000u
+
+// Set when the passes start from the visibility buffer
+layout(location = 33) uniform bool rasterPrimary;
+layout(location = 34) uniform usampler2D visibilityTexture;
+// Offset of the pass' camera rays from the pixel centers, shared by every pixel as the rasterizer samples all of them alike
+layout(location = 32) uniform vec2 primaryJitter;
+
+// Camera ray of [pixel] in this pass, the next 2D sample is consumed either way so the rest of the path keeps its dimensions
+Ray primaryRay(vec2 pixel)
+{
+    Ray ray = raycast(pixel);
+    return rasterPrimary ? cameraRay(pixel + primaryJitter) : ray;
+}
+
+// Rebuilds the first hit of [ray], the camera ray of the pixel, from the visibility buffer
+bool visibleIntersection(Ray ray, ivec2 pixel, out Intersection intersection)
+{
+    intersection.t = 1.f / 0.f;
+    intersection.type = -1;
+    intersection.index = -1;
+    intersection.instance = -1;
+
+    uvec4 visibility = texelFetch(visibilityTexture, pixel, 0);
+    if (visibility.x == 0u) return false;
+
+    if ((visibility.x & VISIBILITY_LIGHT) != 0u)
+    {
+        intersection.type = LIGHT;
+        intersection.index = int(visibility.x & ~VISIBILITY_LIGHT);
+
+        // The rasterizer and the ray can disagree right at the edge of the light
+        if (!rectangleIntersect(ray, getLight(intersection.index).invTransform, intersection.t)) return intersect(ray, intersection);
+    }
+    else
+    {
+        intersection.type = GEOMETRY;
+        intersection.index = int(visibility.x) - 1;
+        intersection.instance = int(visibility.y);
+        intersection.barycentric = uintBitsToFloat(visibility.zw);
+
+        // Distance to the hit in the instance's object space, where the unnormalized direction keeps world distances
+        Instance instance = getInstance(intersection.instance);
+        vec3 origin = (instance.invTransform * vec4(ray.origin, 1.f)).xyz;
+        vec3 direction = (instance.invTransform * vec4(ray.direction, 0.f)).xyz;
+
+        vec3 v0 = texelFetch(triangleTex, intersection.index * TRIANGLE_SIZE + 0).xyz;
+        vec3 e1 = texelFetch(triangleTex, intersection.index * TRIANGLE_SIZE + 1).xyz;
+        vec3 e2 = texelFetch(triangleTex, intersection.index * TRIANGLE_SIZE + 2).xyz;
+        vec3 hit = v0 + e1 * intersection.barycentric.x + e2 * intersection.barycentric.y;
+        intersection.t = dot(hit - origin, direction) / dot(direction, direction);
+    }
+
+    completeIntersection(intersection);
+    return true;
+}
@@ -0,0 +1,82 @@
+#version 460
+
+// Rasterizes the first hits of the camera rays, the projection matches cameraRay() in sampling.glsl
+// Triangles are drawn one instance at a time in object space, lights as two world space triangles each
+
+#define LIGHT_INV_TRANSFORM 5
+#define LIGHT_SIZE          10
+
+// Marks lights in the primitive id, matches visibility.glsl
+#define VISIBILITY_LIGHT 0x80000000u
+
+// Matches sampling.glsl
+const float FOVY = radians(19.5f);
+// Hits closer to the eye are clipped
+#define NEAR_PLANE 1e-4f
+
+layout(location = 6) uniform samplerBuffer lightTex;
+layout(location = 17) uniform usamplerBuffer instanceTex;
+
+layout(location = 10) uniform uvec2 resolution;
+layout(location = 11) uniform vec3 eye;
+layout(location = 12) uniform vec3 forward;
+layout(location = 13) uniform vec3 up;
+layout(location = 14) uniform vec3 right;
+
+// Offset of the pass' camera rays from the pixel centers, in pixels
+layout(location = 32) uniform vec2 primaryJitter;
+// Instance drawn, -1 draws the lights starting at [firstLightVertex]
+layout(location = 35) uniform int instance;
+layout(location = 36) uniform int firstLightVertex;
+
+layout(location = 0) in vec3 position;
+
+layout(location = 0) flat out uint primitive;
+layout(location = 1) flat out int frontFacing;
+layout(location = 2) out vec2 barycentric;
+
+const vec2 corners[3] = vec2[3](vec2(0.f), vec2(1.f, 0.f), vec2(0.f, 1.f));
+
+void main()
+{
+    vec3 world = position;
+    frontFacing = 1;
+    if (instance >= 0)
+    {
+        mat4 transform = mat4(
+            uintBitsToFloat(texelFetch(instanceTex, instance * 9 + 0)),
+            uintBitsToFloat(texelFetch(instanceTex, instance * 9 + 1)),
+            uintBitsToFloat(texelFetch(instanceTex, instance * 9 + 2)),
+            uintBitsToFloat(texelFetch(instanceTex, instance * 9 + 3)));
+        world = vec3(transform * vec4(position, 1.f));
+
+        primitive = uint(gl_VertexID / 3) + 1u;
+        barycentric = corners[gl_VertexID % 3];
+    }
+    else
+    {
+        // Lights only emit towards their local +z, as in rectangleIntersect()
+        int light = (gl_VertexID - firstLightVertex) / 6;
+        mat4 invTransform = mat4(
+            texelFetch(lightTex, light * LIGHT_SIZE + LIGHT_INV_TRANSFORM + 0),
+            texelFetch(lightTex, light * LIGHT_SIZE + LIGHT_INV_TRANSFORM + 1),
+            texelFetch(lightTex, light * LIGHT_SIZE + LIGHT_INV_TRANSFORM + 2),
+            texelFetch(lightTex, light * LIGHT_SIZE + LIGHT_INV_TRANSFORM + 3));
+        frontFacing = (invTransform * vec4(eye, 1.f)).z > 0.f ? 1 : 0;
+
+        primitive = uint(light) | VISIBILITY_LIGHT;
+        barycentric = vec2(0.f);
+    }
+
+    // Screen coordinates of cameraRay() scaled by the depth along [forward]
+    // The jitter shifts the image so the rasterizer samples the pixel centers where the pass' rays go through
+    vec3 toVertex = world - eye;
+    float z = dot(toVertex, forward);
+    float scale = tan(FOVY * 0.5f);
+    vec2 size = vec2(resolution);
+    vec2 screen = vec2(dot(toVertex, right) / (scale * size.x / size.y), dot(toVertex, up) / scale);
+    screen -= primaryJitter * 2.f / size * z;
+
+    // Reversed depth with a [0, 1] clip range, the nearest hit has the largest depth
+    gl_Position = vec4(screen, NEAR_PLANE, z);
+}
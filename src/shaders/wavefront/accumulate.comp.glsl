@@ -0,0 +1,48 @@
+#version 460
+
+#include "../pathtracer/scene.glsl"
+#include "../pathtracer/sampling.glsl"
+#include "../pathtracer/adaptive.glsl"
+#include "wavefront.glsl"
+
+// Front accumulation target
+layout(location = 4) uniform sampler2D accumTexture;
+layout(location = 21) uniform usampler2D sampleCountTexture;
+
+// Back accumulation target, its format is chosen by the renderer
+layout(binding = ACCUMULATION_IMAGE) writeonly uniform image2D accumImage;
+layout(binding = SAMPLE_COUNT_IMAGE) writeonly uniform uimage2D sampleCountImage;
+layout(binding = MOMENT_IMAGE, r32f) writeonly uniform image2D momentImage;
+
+// Blends the radiance each path gathered over the pass into the running means of its pixel
+void main()
+{
+    uint path = gl_GlobalInvocationID.x;
+    if (path >= pathCount()) return;
+
+    ivec2 pixel = ivec2(path % resolution.x, path / resolution.x);
+
+    vec3 accumCol = texelFetch(accumTexture, pixel, 0).rgb;
+    uint sampleCount = texelFetch(sampleCountTexture, pixel, 0).r;
+    float moment = texelFetch(momentTexture, pixel, 0).r;
+
+    // Converged pixels traced nothing this pass and carry their accumulation over to the back target
+    if (converged(pixel, sampleCount))
+    {
+        imageStore(accumImage, pixel, vec4(accumCol, 1.f));
+        imageStore(sampleCountImage, pixel, uvec4(sampleCount));
+        imageStore(momentImage, pixel, vec4(moment));
+        return;
+    }
+
+    // The last sample of the pass is still in the path's radiance
+    vec3 radiance = paths[path].radiance;
+    vec3 passCol = paths[path].passRadiance + radiance;
+    float passSquares = paths[path].passSquares + luminance(radiance) * luminance(radiance);
+
+    vec3 col = (accumCol * sampleCount + passCol) / (sampleCount + samplesPerPass);
+
+    imageStore(accumImage, pixel, vec4(col, 1.f));
+    imageStore(sampleCountImage, pixel, uvec4(sampleCount + samplesPerPass));
+    imageStore(momentImage, pixel, vec4((moment * sampleCount + passSquares) / (sampleCount + samplesPerPass)));
+}
@@ -0,0 +1,17 @@
+#version 460
+
+#include "../pathtracer/scene.glsl"
+#include "../pathtracer/sampling.glsl"
+#include "wavefront.glsl"
+
+// Traces the queued shadow rays and adds the contribution of each unoccluded connection to its path
+void main()
+{
+    uint path;
+    if (!popPath(QUEUE_SHADOW, path)) return;
+
+    ShadowRay shadowRay = shadowRays[path];
+    if (occluded(Ray(shadowRay.origin, shadowRay.direction), shadowRay.maxDistance)) return;
+
+    paths[path].radiance += shadowRay.contribution;
+}
@@ -0,0 +1,38 @@
+#version 460
+
+#include "../pathtracer/scene.glsl"
+#include "../pathtracer/sampling.glsl"
+#include "../pathtracer/bxdf.glsl"
+#include "../pathtracer/lights.glsl"
+#include "wavefront.glsl"
+
+// Traces the extension ray of every live path
+// Paths hitting a light gather its MIS weighted radiance and end, paths hitting geometry are sorted into the queue of the lobe they sample
+void main()
+{
+    uint path;
+    if (!popPath(QUEUE_EXTEND + int(bounce & 1u), path)) return;
+
+    PathState state = paths[path];
+
+    Ray ray = Ray(state.origin, state.direction);
+    Intersection intersection;
+    if (!intersect(ray, intersection)) return;
+
+    if (intersection.type == LIGHT)
+    {
+        paths[path].radiance += state.throughput * intersection.radiance * lightHitWeight(intersection, ray, state.bxdfPdf);
+        return;
+    }
+
+    // The last bounce only looks for lights
+    if (bounce + 1u >= maxDepth) return;
+
+    loadSampler(path);
+    vec2 xi = sample2D();
+    int lobe = chooseLobe(getMaterial(intersection.material));
+    storeSampler(path);
+
+    hits[path] = HitRecord(intersection.normal, intersection.t, xi, intersection.material, lobe);
+    pushPath(QUEUE_SHADE + lobe, path);
+}
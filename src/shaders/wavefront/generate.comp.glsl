@@ -0,0 +1,39 @@
+#version 460
+
+#include "../pathtracer/scene.glsl"
+#include "../pathtracer/sampling.glsl"
+#include "../pathtracer/adaptive.glsl"
+#include "wavefront.glsl"
+
+// Front accumulation target
+layout(location = 21) uniform usampler2D sampleCountTexture;
+
+// Starts the next sample of the pass with one camera ray per pixel that has not converged
+// Invocations run in pixel order, so the primary rays a workgroup pushes to the extension queue stay mostly coherent
+void main()
+{
+    uint path = gl_GlobalInvocationID.x;
+    if (path >= pathCount()) return;
+
+    uvec2 pixel = uvec2(path % resolution.x, path / resolution.x);
+    uint sampleCount = texelFetch(sampleCountTexture, ivec2(pixel), 0).r;
+    if (converged(ivec2(pixel), sampleCount)) return;
+
+    // Same sequence as the fragment path tracer, whose gl_FragCoord.xy is the pixel center
+    uint sampleIndex = sampleCount + passSample;
+    startSampler(pixel, sampleIndex);
+    Ray ray = raycast(vec2(pixel) + vec2(0.5f));
+
+    // Radiance is summed over the samples of a pass, the previous sample is folded in once it is finished
+    vec3 passRadiance = vec3(0.f);
+    float passSquares = 0.f;
+    if (passSample > 0u)
+    {
+        vec3 radiance = paths[path].radiance;
+        passRadiance = paths[path].passRadiance + radiance;
+        passSquares = paths[path].passSquares + luminance(radiance) * luminance(radiance);
+    }
+
+    paths[path] = PathState(ray.origin, sampleIndex, ray.direction, samplerDimension, vec3(1.f), 0.f, vec3(0.f), 0.f, passRadiance, passSquares);
+    pushPath(QUEUE_EXTEND, path);
+}
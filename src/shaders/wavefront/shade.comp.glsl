@@ -0,0 +1,65 @@
+#version 460
+
+#include "../pathtracer/scene.glsl"
+#include "../pathtracer/sampling.glsl"
+#include "../pathtracer/bxdf.glsl"
+#include "../pathtracer/lights.glsl"
+#include "wavefront.glsl"
+
+// Dispatched once per lobe, so every invocation of a dispatch runs the same BxDF
+layout(location = 20) uniform int lobe;
+
+// Samples the BxDF at each hit of one lobe's queue and queues the continuing paths for the next bounce
+// Lights are sampled from every hit the lobe allows it, queueing a shadow ray for the connect stage
+// Paths whose sample has no density are dropped, compacting the next extension queue
+void main()
+{
+    uint path;
+    if (!popPath(QUEUE_SHADE + lobe, path)) return;
+
+    PathState state = paths[path];
+    HitRecord hit = hits[path];
+
+    Intersection intersection;
+    intersection.t = hit.t;
+    intersection.normal = hit.normal;
+    intersection.type = GEOMETRY;
+    intersection.material = hit.material;
+
+    loadSampler(path);
+
+    Material material = getMaterial(hit.material);
+    vec3 outDir = -state.direction;
+    vec3 position = state.origin + state.direction * hit.t;
+    vec3 inDir;
+    float pdf;
+    vec3 bxdf = sampleLobe(lobe, intersection, material, hit.xi, outDir, inDir, pdf);
+
+    state.bxdfPdf = 0.f;
+    if (canSampleLights(lobe, material))
+    {
+        Ray shadowRay;
+        float maxDistance;
+        vec3 lightRadiance = sampleLight(lobe, intersection, material, position, outDir, shadowRay, maxDistance);
+        if (maxDistance > 0.f)
+        {
+            shadowRays[path] = ShadowRay(shadowRay.origin, maxDistance, shadowRay.direction, 0u, state.throughput * lightRadiance, 0.f);
+            pushPath(QUEUE_SHADOW, path);
+        }
+
+        if (pdf > 0.f) evaluateLobe(lobe, intersection, material, outDir, inDir, state.bxdfPdf);
+    }
+
+    if (pdf <= 0.f) return;
+
+    state.throughput *= bxdf * abs(dot(hit.normal, inDir));
+    state.throughput /= pdf;
+    if (bounce + 1u >= rouletteDepth && !russianRoulette(state.throughput)) return;
+
+    state.origin = position + inDir * 0.0001f;
+    state.direction = inDir;
+    state.sampleDimension = samplerDimension;
+
+    paths[path] = state;
+    pushPath(QUEUE_EXTEND + int((bounce + 1u) & 1u), path);
+}
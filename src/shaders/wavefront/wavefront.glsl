@@ -0,0 +1,80 @@
+// Buffers and queue helpers shared by the wavefront stages
+// Expects scene.glsl and sampling.glsl to be included first
+
+#include "wavefront_records.h"
+
+layout(local_size_x = WAVEFRONT_GROUP_SIZE) in;
+
+layout(location = 19) uniform uint bounce;
+layout(location = 22) uniform uint samplesPerPass;
+// Sample of the pass being traced, the samples of a pass are traced one after the other
+layout(location = 23) uniform uint passSample;
+// Segments traced per path at most, and the number after which paths are terminated by Russian roulette
+layout(location = 27) uniform uint maxDepth;
+layout(location = 28) uniform uint rouletteDepth;
+
+layout(std430, binding = PATH_BINDING) buffer PathBuffer
+{
+    PathState paths[];
+};
+
+layout(std430, binding = HIT_BINDING) buffer HitBuffer
+{
+    HitRecord hits[];
+};
+
+layout(std430, binding = SHADOW_RAY_BINDING) buffer ShadowRayBuffer
+{
+    ShadowRay shadowRays[];
+};
+
+layout(std430, binding = QUEUE_COUNTER_BINDING) buffer QueueCounterBuffer
+{
+    QueueCounter counters[];
+};
+
+// Each queue holds up to one entry per path
+layout(std430, binding = QUEUE_ITEM_BINDING) buffer QueueItemBuffer
+{
+    uint queueItems[];
+};
+
+// One path is traced per pixel
+uint pathCount()
+{
+    return resolution.x * resolution.y;
+}
+
+// Appends a path to a queue, adding a workgroup to the queue's indirect dispatch for every WAVEFRONT_GROUP_SIZE paths
+void pushPath(int queue, uint path)
+{
+    uint slot = atomicAdd(counters[queue].count, 1u);
+    if (slot % WAVEFRONT_GROUP_SIZE == 0u)
+    {
+        atomicAdd(counters[queue].groupsX, 1u);
+    }
+
+    queueItems[queue * pathCount() + slot] = path;
+}
+
+// Gets the path of this invocation from a queue, returns false past the end of the queue
+bool popPath(int queue, out uint path)
+{
+    uint slot = gl_GlobalInvocationID.x;
+    if (slot >= counters[queue].count) return false;
+
+    path = queueItems[queue * pathCount() + slot];
+    return true;
+}
+
+// Resumes the sampler of a path, whose pixel is its index
+void loadSampler(uint path)
+{
+    startSampler(uvec2(path % resolution.x, path / resolution.x), paths[path].sampleIndex);
+    samplerDimension = paths[path].sampleDimension;
+}
+
+void storeSampler(uint path)
+{
+    paths[path].sampleDimension = samplerDimension;
+}
@@ -0,0 +1,81 @@
+// Path, hit and queue records of the wavefront path tracer shared by the renderer (C++) and its stages (GLSL)
+// Keep to preprocessor definitions and record structs so it stays valid in both languages
+// C++ includes it after glm with the glm namespace in scope
+
+#ifndef WAVEFRONT_RECORDS_H
+#define WAVEFRONT_RECORDS_H
+
+// Threads per workgroup of every stage
+#define WAVEFRONT_GROUP_SIZE 64
+
+// Shader storage buffer bindings, binding 0 holds the materials
+#define PATH_BINDING          1
+#define HIT_BINDING           2
+#define SHADOW_RAY_BINDING    3
+#define QUEUE_COUNTER_BINDING 4
+#define QUEUE_ITEM_BINDING    5
+
+// Image units of the back accumulation target
+#define ACCUMULATION_IMAGE 0
+#define SAMPLE_COUNT_IMAGE 1
+#define MOMENT_IMAGE       2
+
+// Queues of path indices, the extension rays ping-pong between two queues across bounces
+#define QUEUE_EXTEND      0
+#define QUEUE_SHADE       2
+#define SHADE_QUEUE_COUNT 3
+#define QUEUE_SHADOW      5
+#define QUEUE_COUNT       6
+
+// Indirect dispatch arguments of a queue followed by its length
+struct QueueCounter
+{
+    uint groupsX;
+    uint groupsY;
+    uint groupsZ;
+    uint count;
+};
+
+// State of the path traced for one pixel
+struct PathState
+{
+    vec3 origin;
+    // Sample being traced and the next dimension it draws
+    uint sampleIndex;
+    vec3 direction;
+    uint sampleDimension;
+    // Product of the BxDF weights along the path
+    vec3 throughput;
+    // Density of the BxDF sample the current ray was traced with, zero if lights were not sampled at its origin
+    float bxdfPdf;
+    // Radiance gathered during the current sample
+    vec3 radiance;
+    float padding1;
+    // Sums over the finished samples of the pass of the radiance and of its squared luminance
+    vec3 passRadiance;
+    float passSquares;
+};
+
+// Closest hit of a path's extension ray
+struct HitRecord
+{
+    vec3 normal;
+    float t;
+    // BxDF sample drawn when the lobe was chosen
+    vec2 xi;
+    int material;
+    int lobe;
+};
+
+// Deferred light connection written by next event estimation, the contribution is added to the path if nothing lies in between
+struct ShadowRay
+{
+    vec3 origin;
+    float maxDistance;
+    vec3 direction;
+    uint padding;
+    vec3 contribution;
+    float padding1;
+};
+
+#endif
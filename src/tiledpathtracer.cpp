@@ -0,0 +1,301 @@
+#include <tiledpathtracer.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+static bool hasExtension(const char* name)
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; ++i)
+	{
+		if (std::strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), name) == 0) return true;
+	}
+
+	return false;
+}
+
+// Point [d] along the Hilbert curve through a square of [side] cells, [side] a power of two
+static glm::uvec2 hilbertPoint(uint32_t side, uint32_t d)
+{
+	glm::uvec2 point(0);
+	for (uint32_t s = 1; s < side; s *= 2)
+	{
+		uint32_t rx = 1 & (d / 2);
+		uint32_t ry = 1 & (d ^ rx);
+
+		// Rotates the quadrant so the sub-curves join up
+		if (ry == 0)
+		{
+			if (rx == 1) point = glm::uvec2(s - 1) - point;
+			std::swap(point.x, point.y);
+		}
+
+		point += glm::uvec2(s * rx, s * ry);
+		d /= 4;
+	}
+
+	return point;
+}
+
+// Every other bit of [value] packed into the low half
+static uint32_t compactBits(uint32_t value)
+{
+	value &= 0x55555555;
+	value = (value | (value >> 1)) & 0x33333333;
+	value = (value | (value >> 2)) & 0x0f0f0f0f;
+	value = (value | (value >> 4)) & 0x00ff00ff;
+	value = (value | (value >> 8)) & 0x0000ffff;
+	return value;
+}
+
+// Coordinates of [tiles] as x | y << 16 in [order]
+// The curves run over the smallest power of two square covering the tiles and skip the cells outside of them
+static std::vector<uint32_t> tileOrder(const glm::uvec2& tiles, TiledPathTracer::Order order)
+{
+	std::vector<uint32_t> result;
+	result.reserve(tiles.x * tiles.y);
+
+	uint32_t side = 1;
+	while (side < std::max(tiles.x, tiles.y)) side *= 2;
+
+	if (order == TiledPathTracer::Order::Scanline)
+	{
+		for (uint32_t y = 0; y < tiles.y; ++y)
+		{
+			for (uint32_t x = 0; x < tiles.x; ++x)
+			{
+				result.push_back(x | y << 16);
+			}
+		}
+		return result;
+	}
+
+	for (uint32_t d = 0; d < side * side; ++d)
+	{
+		glm::uvec2 tile = order == TiledPathTracer::Order::Morton
+			? glm::uvec2(compactBits(d), compactBits(d >> 1))
+			: hilbertPoint(side, d);
+
+		if (tile.x < tiles.x && tile.y < tiles.y)
+		{
+			result.push_back(tile.x | tile.y << 16);
+		}
+	}
+
+	return result;
+}
+
+TiledPathTracer::TiledPathTracer()
+	: m_program("src/shaders/pathtracer/tiled.comp.glsl"),
+	  m_checkFence(0), m_checkTiles(0), m_lossReported(false),
+	  m_tileSize(defaultTileSize), m_order(Order::Hilbert), m_tilesPerDispatch(defaultTilesPerDispatch), m_profiling(false), m_tiles(0)
+{
+	glGenBuffers(1, &m_counterBuffer);
+	glGenBuffers(1, &m_orderBuffer);
+	glGenBuffers(1, &m_timeBuffer);
+	glGenBuffers(1, &m_checkBuffer);
+
+	// [next tile of the dispatch, completed tiles of the pass]
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_counterBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * sizeof(uint32_t), nullptr, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_checkBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, sizeof(uint32_t), nullptr, GL_STREAM_READ);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+TiledPathTracer::~TiledPathTracer()
+{
+	if (m_checkFence) glDeleteSync(m_checkFence);
+
+	glDeleteBuffers(1, &m_counterBuffer);
+	glDeleteBuffers(1, &m_orderBuffer);
+	glDeleteBuffers(1, &m_timeBuffer);
+	glDeleteBuffers(1, &m_checkBuffer);
+}
+
+bool TiledPathTracer::isCompiled() const
+{
+	return m_program.isCompiled();
+}
+
+void TiledPathTracer::setTileSize(uint tileSize)
+{
+	tileSize = std::max(tileSize, 1u);
+	m_tileSize = (tileSize + TILE_GROUP_SIZE - 1) / TILE_GROUP_SIZE * TILE_GROUP_SIZE;
+	m_tiles = glm::uvec2(0);
+}
+
+uint TiledPathTracer::getTileSize() const
+{
+	return m_tileSize;
+}
+
+void TiledPathTracer::setOrder(Order order)
+{
+	m_order = order;
+	m_tiles = glm::uvec2(0);
+}
+
+TiledPathTracer::Order TiledPathTracer::getOrder() const
+{
+	return m_order;
+}
+
+void TiledPathTracer::setTilesPerDispatch(uint tiles)
+{
+	m_tilesPerDispatch = tiles;
+}
+
+uint TiledPathTracer::getTilesPerDispatch() const
+{
+	return m_tilesPerDispatch;
+}
+
+bool TiledPathTracer::canProfile()
+{
+	return hasExtension("GL_ARB_shader_clock");
+}
+
+void TiledPathTracer::setProfiling(bool enabled)
+{
+	// Forces the times to be cleared before the next pass
+	if (enabled && !m_profiling)
+	{
+		m_tiles = glm::uvec2(0);
+	}
+	m_profiling = enabled;
+}
+
+bool TiledPathTracer::getProfiling() const
+{
+	return m_profiling;
+}
+
+glm::uvec2 TiledPathTracer::getTileCount() const
+{
+	return m_tiles;
+}
+
+std::vector<uint64_t> TiledPathTracer::getTileTimes() const
+{
+	if (!m_profiling || m_tileOrder.empty()) return std::vector<uint64_t>();
+
+	std::vector<glm::uvec2> times(m_tileOrder.size());
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_timeBuffer);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(glm::uvec2) * times.size(), times.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	// The buffer follows the tile order
+	std::vector<uint64_t> result(m_tiles.x * m_tiles.y);
+	for (size_t i = 0; i < m_tileOrder.size(); ++i)
+	{
+		uint32_t x = m_tileOrder[i] & 0xffff;
+		uint32_t y = m_tileOrder[i] >> 16;
+		result[y * m_tiles.x + x] = uint64_t(times[i].y) << 32 | times[i].x;
+	}
+
+	return result;
+}
+
+// Rebuilds the tile order and clears the tile times when the tiles covering [resolution] changed
+void TiledPathTracer::updateTiles(const glm::uvec2& resolution)
+{
+	glm::uvec2 tiles = (resolution + glm::uvec2(m_tileSize - 1)) / glm::uvec2(m_tileSize);
+	if (tiles == m_tiles) return;
+
+	m_tiles = tiles;
+	m_tileOrder = tileOrder(tiles, m_order);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_orderBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(uint32_t) * m_tileOrder.size(), m_tileOrder.data(), GL_STATIC_DRAW);
+
+	std::vector<glm::uvec2> times(m_tileOrder.size(), glm::uvec2(0));
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_timeBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::uvec2) * times.size(), times.data(), GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+// Reports a pass that completed fewer tiles than it handed out, once the GPU got past its copy of the count
+// A pass still in flight is left for a later call, and no other pass is checked meanwhile
+void TiledPathTracer::checkPass()
+{
+	if (!m_checkFence || glClientWaitSync(m_checkFence, 0, 0) == GL_TIMEOUT_EXPIRED) return;
+
+	glDeleteSync(m_checkFence);
+	m_checkFence = 0;
+
+	uint32_t completed = 0;
+	glBindBuffer(GL_COPY_READ_BUFFER, m_checkBuffer);
+	glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(uint32_t), &completed);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+	if (completed != m_checkTiles && !m_lossReported)
+	{
+		printf("The tiled path tracer completed %u of %u tiles of a pass, the driver may have stopped long dispatches, try a smaller --tile-batch\n", completed, m_checkTiles);
+		m_lossReported = true;
+	}
+}
+
+void TiledPathTracer::trace(const glm::uvec2& resolution, const AccumulationBuffer& accumulation)
+{
+	checkPass();
+	updateTiles(resolution);
+
+	const AccumulationBuffer::Target& back = accumulation.getBack();
+	glBindImageTexture(TILE_ACCUMULATION_IMAGE, back.colorTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, accumulation.getInternalFormat());
+	glBindImageTexture(TILE_SAMPLE_COUNT_IMAGE, back.sampleCountTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32UI);
+	glBindImageTexture(TILE_MOMENT_IMAGE, back.momentTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TILE_COUNTER_BINDING, m_counterBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TILE_ORDER_BINDING, m_orderBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TILE_TIME_BINDING, m_timeBuffer);
+
+	glUseProgram(m_program.m_id);
+	glUniform1ui(glGetUniformLocation(m_program.m_id, "tileSize"), m_tileSize);
+	glUniform1i(glGetUniformLocation(m_program.m_id, "tileProfiling"), m_profiling);
+
+	uint tileCount = m_tileOrder.size();
+	uint tilesPerDispatch = m_tilesPerDispatch > 0 ? m_tilesPerDispatch : tileCount;
+	for (uint first = 0; first < tileCount; first += tilesPerDispatch)
+	{
+		glm::uvec2 range(first, std::min(first + tilesPerDispatch, tileCount));
+		uint groups = std::min(range.y - range.x, maxResidentGroups);
+		uint tilesPerGroup = (range.y - range.x + groups - 1) / groups;
+
+		// The counter of the previous dispatch has to be left by its workgroups before it starts over
+		// The first dispatch of the pass also clears the completed tiles
+		uint32_t zeros[2] = {0, 0};
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_counterBuffer);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, (first == 0 ? 2 : 1) * sizeof(uint32_t), zeros);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		glUniform2uiv(glGetUniformLocation(m_program.m_id, "tileRange"), 1, &range[0]);
+		glUniform1ui(glGetUniformLocation(m_program.m_id, "tilesPerGroup"), tilesPerGroup);
+		glDispatchCompute(groups, 1, 1);
+	}
+
+	// Copies the completed tiles for checkPass(), unless an earlier pass is still being checked
+	if (!m_checkFence)
+	{
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+		glBindBuffer(GL_COPY_READ_BUFFER, m_counterBuffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, m_checkBuffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, sizeof(uint32_t), 0, sizeof(uint32_t));
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		m_checkFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_checkTiles = tileCount;
+	}
+
+	// The accumulation is sampled by the post pass next, and may be cleared, uploaded to or rendered to by the other backends
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+	glUseProgram(0);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <error_handling.h>
+#include <gl/gl.h>
+#include <utils.h>
+
+#include <shaderprogram.h>
+#include <accumulationbuffer.h>
+#include <shaders/pathtracer/tiles.h>
+
+#include <vector>
+
+// Compute path tracer working through the image in square tiles, with the same paths as the fragment path tracer
+// A fixed number of persistent workgroups take tiles from an atomic counter in a configurable order until none are left
+// The passes are split into dispatches of a bounded number of tiles, so none runs long enough to trip a driver watchdog
+// Every workgroup counts the tiles it finished, a pass that left tiles out is reported once its count can be read without stalling
+class TiledPathTracer
+{
+public:
+	// Order the tiles are handed out in, the space filling curves keep consecutive tiles close for the caches
+	enum class Order {
+		Scanline,
+		Morton,
+		Hilbert,
+	};
+
+	static constexpr uint defaultTileSize = 32;
+	// Workgroups launched at most per dispatch, enough to fill current GPUs, those finding no tile left return at once
+	static constexpr uint maxResidentGroups = 1024;
+	// Keeps every workgroup to at most four tiles per dispatch, a 4K image at the default tile size takes two dispatches
+	static constexpr uint defaultTilesPerDispatch = 4 * maxResidentGroups;
+
+	ShaderProgram m_program;
+
+private:
+	GLuint m_counterBuffer, m_orderBuffer, m_timeBuffer;
+	// Tiles the last checked pass completed, copied from the counter buffer so reading it waits for nothing else
+	GLuint m_checkBuffer;
+	// Signalled once the copy to the check buffer is done, zero while no check is pending
+	GLsync m_checkFence;
+	uint m_checkTiles;
+	bool m_lossReported;
+
+	uint m_tileSize;
+	Order m_order;
+	// Tiles of every dispatch, zero traces the whole pass in one dispatch
+	uint m_tilesPerDispatch;
+	bool m_profiling;
+
+	// Tiles the order buffer was built for
+	glm::uvec2 m_tiles;
+	std::vector<uint32_t> m_tileOrder;
+
+	void updateTiles(const glm::uvec2& resolution);
+	void checkPass();
+
+public:
+	TiledPathTracer();
+	~TiledPathTracer();
+
+	TiledPathTracer(const TiledPathTracer&) = delete;
+	TiledPathTracer& operator=(const TiledPathTracer&) = delete;
+
+	bool isCompiled() const;
+
+	// Rounded up to a multiple of TILE_GROUP_SIZE
+	void setTileSize(uint tileSize);
+	uint getTileSize() const;
+	void setOrder(Order order);
+	Order getOrder() const;
+	void setTilesPerDispatch(uint tiles);
+	uint getTilesPerDispatch() const;
+
+	// Whether the GPU can read its clock from shaders, which profiling needs
+	static bool canProfile();
+	// Records the clock cycles of every tile, the times add up over the passes until profiling is enabled again or the tiles change
+	void setProfiling(bool enabled);
+	bool getProfiling() const;
+	// Tiles along each axis of the last pass
+	glm::uvec2 getTileCount() const;
+	// Clock cycles of every tile, rows from the bottom, waits for the passes writing them
+	// Cycles are only comparable between tiles of the same GPU, empty unless profiling
+	std::vector<uint64_t> getTileTimes() const;
+
+	// Traces the samples of a pass over [resolution] pixels, the samplesPerPass uniform of the program holds their number
+	// Reads the front target of [accumulation] through the accumulation texture units and writes its back target
+	void trace(const glm::uvec2& resolution, const AccumulationBuffer& accumulation);
+};
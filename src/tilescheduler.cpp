@@ -0,0 +1,128 @@
+#include <tilescheduler.h>
+
+#include <algorithm>
+
+TileScheduler::TileScheduler(unsigned threadCount)
+	: m_task(nullptr), m_batch(0), m_activeWorkers(0), m_stop(false)
+{
+	if (threadCount == 0)
+	{
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	for (unsigned i = 0; i < threadCount; ++i)
+	{
+		m_workers.push_back(std::make_unique<Worker>());
+	}
+
+	for (unsigned i = 0; i < threadCount; ++i)
+	{
+		m_threads.emplace_back(&TileScheduler::work, this, i);
+	}
+}
+
+TileScheduler::~TileScheduler()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+
+	for (std::thread& thread : m_threads)
+	{
+		thread.join();
+	}
+}
+
+void TileScheduler::run(uint32_t taskCount, const std::function<void(uint32_t)>& task)
+{
+	if (taskCount == 0) return;
+
+	// Hand each worker a contiguous range so neighbouring tasks run on the same thread
+	unsigned workerCount = m_workers.size();
+	for (unsigned i = 0; i < workerCount; ++i)
+	{
+		uint32_t first = uint64_t(taskCount) * i / workerCount;
+		uint32_t last = uint64_t(taskCount) * (i + 1) / workerCount;
+
+		std::lock_guard<std::mutex> lock(m_workers[i]->mutex);
+		for (uint32_t t = first; t < last; ++t)
+		{
+			m_workers[i]->tasks.push_back(t);
+		}
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_task = &task;
+	m_activeWorkers = workerCount;
+	++m_batch;
+	m_wake.notify_all();
+
+	// Every worker has to leave the batch before [task] goes out of scope
+	m_done.wait(lock, [this] { return m_activeWorkers == 0; });
+	m_task = nullptr;
+}
+
+unsigned TileScheduler::getThreadCount() const
+{
+	return m_threads.size();
+}
+
+void TileScheduler::work(unsigned index)
+{
+	uint64_t batch = 0;
+	while (true)
+	{
+		const std::function<void(uint32_t)>* task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [&] { return m_stop || m_batch != batch; });
+			if (m_stop) return;
+
+			batch = m_batch;
+			task = m_task;
+		}
+
+		uint32_t taskIndex;
+		while (pop(index, taskIndex) || steal(index, taskIndex))
+		{
+			(*task)(taskIndex);
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (--m_activeWorkers == 0)
+		{
+			m_done.notify_all();
+		}
+	}
+}
+
+// Takes the next task of the worker's own range
+bool TileScheduler::pop(unsigned index, uint32_t& task)
+{
+	Worker& worker = *m_workers[index];
+	std::lock_guard<std::mutex> lock(worker.mutex);
+	if (worker.tasks.empty()) return false;
+
+	task = worker.tasks.front();
+	worker.tasks.pop_front();
+	return true;
+}
+
+// Takes the last task of another worker's range, furthest from where its owner is working
+bool TileScheduler::steal(unsigned index, uint32_t& task)
+{
+	for (unsigned offset = 1; offset < m_workers.size(); ++offset)
+	{
+		Worker& victim = *m_workers[(index + offset) % m_workers.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (victim.tasks.empty()) continue;
+
+		task = victim.tasks.back();
+		victim.tasks.pop_back();
+		return true;
+	}
+
+	return false;
+}
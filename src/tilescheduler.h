@@ -0,0 +1,50 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Pool of persistent worker threads running batches of independent tasks
+// Each worker starts on a contiguous range of the batch and steals from the others once its own range is exhausted
+class TileScheduler
+{
+public:
+	// Zero threads uses one per hardware thread
+	TileScheduler(unsigned threadCount = 0);
+	~TileScheduler();
+
+	TileScheduler(const TileScheduler&) = delete;
+	TileScheduler& operator=(const TileScheduler&) = delete;
+
+	// Calls [task] once for every index in [0, taskCount) and returns when all calls are done
+	void run(uint32_t taskCount, const std::function<void(uint32_t)>& task);
+
+	unsigned getThreadCount() const;
+
+private:
+	struct Worker {
+		std::mutex mutex;
+		std::deque<uint32_t> tasks;
+	};
+
+	std::vector<std::unique_ptr<Worker>> m_workers;
+	std::vector<std::thread> m_threads;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+
+	const std::function<void(uint32_t)>* m_task;
+	uint64_t m_batch;
+	unsigned m_activeWorkers;
+	bool m_stop;
+
+	void work(unsigned index);
+	bool pop(unsigned index, uint32_t& task);
+	bool steal(unsigned index, uint32_t& task);
+};
@@ -0,0 +1,141 @@
+#include <visibilitybuffer.h>
+
+static float radicalInverse(uint base, uint index)
+{
+	float inverseBase = 1.f / base;
+	float digitWeight = inverseBase;
+	float result = 0.f;
+	for (; index > 0; index /= base)
+	{
+		result += (index % base) * digitWeight;
+		digitWeight *= inverseBase;
+	}
+
+	return result;
+}
+
+VisibilityBuffer::VisibilityBuffer(const Scene* scene, const glm::uvec2& resolution)
+	: m_program("src/shaders/pathtracer/visibility.vert.glsl", "src/shaders/pathtracer/visibility.frag.glsl"),
+	  m_scene(scene), m_resolution(resolution)
+{
+	std::vector<glm::vec3> vertices;
+	vertices.reserve(scene->m_triangles.size() * 3 + scene->m_lights.size() * 6);
+	for (const Scene::TriangleRecord& triangle : scene->m_triangles)
+	{
+		vertices.push_back(triangle.v0);
+		vertices.push_back(triangle.v0 + triangle.edge1);
+		vertices.push_back(triangle.v0 + triangle.edge2);
+	}
+
+	// Lights are unit squares in the xy plane of their transform
+	m_firstLightVertex = vertices.size();
+	const glm::vec2 corners[6] = {{-0.5f, -0.5f}, {0.5f, -0.5f}, {0.5f, 0.5f}, {-0.5f, -0.5f}, {0.5f, 0.5f}, {-0.5f, 0.5f}};
+	for (const Scene::Light& light : scene->m_lights)
+	{
+		for (const glm::vec2& corner : corners)
+		{
+			vertices.push_back(glm::vec3(light.transform * glm::vec4(corner, 0.f, 1.f)));
+		}
+	}
+
+	// Buffer storage cannot be empty
+	if (vertices.empty()) vertices.push_back(glm::vec3(0.f));
+
+	m_vertexBuffer.init(vertices.data(), sizeof(glm::vec3) * vertices.size());
+	m_vertexArray.init({gl::BindingDesc {&m_vertexBuffer, 3, gl::BindingType::Float, gl::BindingStep::PerVertex}});
+
+	allocate();
+}
+
+VisibilityBuffer::~VisibilityBuffer()
+{
+	release();
+	m_vertexArray.cleanUp();
+	m_vertexBuffer.cleanUp();
+}
+
+void VisibilityBuffer::allocate()
+{
+	m_visibilityTexture.init(glm::ivec2(m_resolution), GL_RGBA32UI);
+	m_depthTexture.init(glm::ivec2(m_resolution), GL_DEPTH_COMPONENT32F);
+
+	std::vector<gl::Texture*> colorAttachments {&m_visibilityTexture};
+	m_framebuffer.init(colorAttachments, &m_depthTexture);
+}
+
+void VisibilityBuffer::release()
+{
+	m_framebuffer.cleanUp();
+	m_visibilityTexture.cleanUp();
+	m_depthTexture.cleanUp();
+}
+
+bool VisibilityBuffer::isCompiled() const
+{
+	return m_program.isCompiled();
+}
+
+void VisibilityBuffer::resize(const glm::uvec2& resolution)
+{
+	release();
+	m_resolution = resolution;
+	allocate();
+}
+
+void VisibilityBuffer::draw(const glm::uvec2& resolution, const glm::vec2& jitter)
+{
+	GLint framebuffer, vertexArray;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vertexArray);
+
+	m_framebuffer.bind();
+	glViewport(0, 0, resolution.x, resolution.y);
+
+	GLuint miss[4] = {0, 0, 0, 0};
+	glClearBufferuiv(GL_COLOR, 0, miss);
+	float farDepth = 0.f;
+	glClearBufferfv(GL_DEPTH, 0, &farDepth);
+
+	// Reversed depth, visibility.vert.glsl writes the depth as the near plane over the distance along the view axis
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_GREATER);
+	glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+
+	glUseProgram(m_program.m_id);
+	glUniform2fv(glGetUniformLocation(m_program.m_id, "primaryJitter"), 1, &jitter[0]);
+	m_vertexArray.bind();
+
+	GLint instanceLocation = glGetUniformLocation(m_program.m_id, "instance");
+	for (size_t i = 0; i < m_scene->m_instances.size(); ++i)
+	{
+		const Scene::Mesh& mesh = m_scene->m_meshes[m_scene->m_instances[i].mesh];
+		glUniform1i(instanceLocation, int(i));
+		glDrawArrays(GL_TRIANGLES, 3 * mesh.triangleOffset, 3 * mesh.triangleCount);
+	}
+
+	if (!m_scene->m_lights.empty())
+	{
+		glUniform1i(instanceLocation, -1);
+		glUniform1i(glGetUniformLocation(m_program.m_id, "firstLightVertex"), m_firstLightVertex);
+		glDrawArrays(GL_TRIANGLES, m_firstLightVertex, 6 * m_scene->m_lights.size());
+	}
+
+	glClipControl(GL_LOWER_LEFT, GL_NEGATIVE_ONE_TO_ONE);
+	glDepthFunc(GL_LESS);
+	glDisable(GL_DEPTH_TEST);
+
+	glBindVertexArray(vertexArray);
+	glUseProgram(0);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+}
+
+GLuint VisibilityBuffer::getTexture() const
+{
+	return m_visibilityTexture.getID();
+}
+
+glm::vec2 VisibilityBuffer::jitter(uint index)
+{
+	// The first point of the sequence is the origin, it is skipped
+	return glm::vec2(radicalInverse(2, index + 1), radicalInverse(3, index + 1));
+}
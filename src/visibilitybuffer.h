@@ -0,0 +1,54 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <error_handling.h>
+#include <gl/gl.h>
+#include <utils.h>
+
+#include <scene.h>
+#include <shaderprogram.h>
+
+// Rasterized first hit of the camera ray through every pixel, so the fragment path tracer starts its paths without tracing them
+// Every pixel's ray goes through the same offset from its center, each sample of a pass is drawn with its own offset
+class VisibilityBuffer
+{
+public:
+	ShaderProgram m_program;
+
+private:
+	const Scene* m_scene;
+	glm::uvec2 m_resolution;
+
+	// Object space corners of every triangle, parallel to the index list, followed by the world space corners of every light
+	gl::Buffer m_vertexBuffer;
+	gl::VertexArray m_vertexArray;
+	GLint m_firstLightVertex;
+
+	// [primitive, instance, barycentrics] of every pixel as RGBA32UI, see visibility.glsl
+	gl::Texture m_visibilityTexture;
+	gl::Texture m_depthTexture;
+	gl::Framebuffer m_framebuffer;
+
+	void allocate();
+	void release();
+
+public:
+	VisibilityBuffer(const Scene* scene, const glm::uvec2& resolution);
+	~VisibilityBuffer();
+
+	VisibilityBuffer(const VisibilityBuffer&) = delete;
+	VisibilityBuffer& operator=(const VisibilityBuffer&) = delete;
+
+	bool isCompiled() const;
+
+	void resize(const glm::uvec2& resolution);
+
+	// Rasterizes the lower left [resolution] pixels for the camera rays offset by [jitter] pixels from the pixel centers
+	// The scene textures and the program's camera uniforms must be set, the framebuffer binding is left as it was
+	void draw(const glm::uvec2& resolution, const glm::vec2& jitter);
+
+	GLuint getTexture() const;
+
+	// Offset in [0, 1)^2 of the camera rays of the [index]th sample since the accumulation restarted, from the Halton sequence
+	static glm::vec2 jitter(uint index);
+};
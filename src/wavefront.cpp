@@ -0,0 +1,175 @@
+#include <wavefront.h>
+
+static_assert(sizeof(QueueCounter) == sizeof(glm::uvec4), "Queue counters must match the std430 layout");
+static_assert(sizeof(PathState) == 5 * sizeof(glm::vec4), "Path states must match the std430 layout");
+static_assert(sizeof(HitRecord) == 2 * sizeof(glm::vec4), "Hit records must match the std430 layout");
+static_assert(sizeof(ShadowRay) == 3 * sizeof(glm::vec4), "Shadow rays must match the std430 layout");
+
+// Makes the queues and path data written by one stage visible to the next, including its indirect dispatch
+#define STAGE_BARRIER (GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT)
+
+Wavefront::Wavefront(const glm::uvec2& resolution)
+	: m_generateProgram("src/shaders/wavefront/generate.comp.glsl"),
+	  m_extendProgram("src/shaders/wavefront/extend.comp.glsl"),
+	  m_shadeProgram("src/shaders/wavefront/shade.comp.glsl"),
+	  m_connectProgram("src/shaders/wavefront/connect.comp.glsl"),
+	  m_accumulateProgram("src/shaders/wavefront/accumulate.comp.glsl"),
+	  m_pathCount(0)
+{
+	glGenBuffers(1, &m_pathBuffer);
+	glGenBuffers(1, &m_hitBuffer);
+	glGenBuffers(1, &m_shadowRayBuffer);
+	glGenBuffers(1, &m_queueCounterBuffer);
+	glGenBuffers(1, &m_queueItemBuffer);
+
+	allocate(resolution);
+}
+
+Wavefront::~Wavefront()
+{
+	glDeleteBuffers(1, &m_pathBuffer);
+	glDeleteBuffers(1, &m_hitBuffer);
+	glDeleteBuffers(1, &m_shadowRayBuffer);
+	glDeleteBuffers(1, &m_queueCounterBuffer);
+	glDeleteBuffers(1, &m_queueItemBuffer);
+}
+
+// Sizes the path data and queues for one path per pixel
+void Wavefront::allocate(const glm::uvec2& resolution)
+{
+	m_pathCount = resolution.x * resolution.y;
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_pathBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(PathState) * m_pathCount, nullptr, GL_DYNAMIC_COPY);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PATH_BINDING, m_pathBuffer);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_hitBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(HitRecord) * m_pathCount, nullptr, GL_DYNAMIC_COPY);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, HIT_BINDING, m_hitBuffer);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_shadowRayBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(ShadowRay) * m_pathCount, nullptr, GL_DYNAMIC_COPY);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SHADOW_RAY_BINDING, m_shadowRayBuffer);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_queueCounterBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(QueueCounter) * QUEUE_COUNT, nullptr, GL_DYNAMIC_COPY);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, QUEUE_COUNTER_BINDING, m_queueCounterBuffer);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_queueItemBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(uint32_t) * m_pathCount * QUEUE_COUNT, nullptr, GL_DYNAMIC_COPY);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, QUEUE_ITEM_BINDING, m_queueItemBuffer);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+// Empties [count] queues starting at [first], leaving an indirect dispatch of no workgroups
+void Wavefront::resetQueues(int first, int count) const
+{
+	std::vector<QueueCounter> counters(count, QueueCounter { 0, 1, 1, 0 });
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_queueCounterBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(QueueCounter) * first, sizeof(QueueCounter) * count, counters.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+// Waits for the stages writing the queue
+uint Wavefront::getQueueLength(int queue) const
+{
+	QueueCounter counter;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_queueCounterBuffer);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(QueueCounter) * queue, sizeof(QueueCounter), &counter);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	return counter.count;
+}
+
+bool Wavefront::isCompiled() const
+{
+	for (const ShaderProgram* program : getPrograms())
+	{
+		if (!program->isCompiled()) return false;
+	}
+
+	return true;
+}
+
+// Gets every stage program, for setting the scene and camera uniforms they share with the fragment path tracer
+std::vector<const ShaderProgram*> Wavefront::getPrograms() const
+{
+	return { &m_generateProgram, &m_extendProgram, &m_shadeProgram, &m_connectProgram, &m_accumulateProgram };
+}
+
+void Wavefront::resize(const glm::uvec2& resolution)
+{
+	allocate(resolution);
+}
+
+// Traces the samples of a pass and blends them into the accumulation
+void Wavefront::trace(uint samplesPerPass, uint maxDepth, const AccumulationBuffer& accumulation)
+{
+	GLuint pathGroups = (m_pathCount + WAVEFRONT_GROUP_SIZE - 1) / WAVEFRONT_GROUP_SIZE;
+
+	for (uint passSample = 0; passSample < samplesPerPass; ++passSample)
+	{
+		// Generate, the paths of the pixels that have not converged start in the first extension queue
+		resetQueues(QUEUE_EXTEND, 1);
+
+		glUseProgram(m_generateProgram.m_id);
+		glUniform1ui(glGetUniformLocation(m_generateProgram.m_id, "passSample"), passSample);
+		glDispatchCompute(pathGroups, 1, 1);
+		glMemoryBarrier(STAGE_BARRIER);
+
+		// Bounces, only the paths still alive are dispatched
+		glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, m_queueCounterBuffer);
+		for (uint bounce = 0; bounce < maxDepth; ++bounce)
+		{
+			int extendQueue = QUEUE_EXTEND + (bounce & 1);
+			int nextExtendQueue = QUEUE_EXTEND + ((bounce + 1) & 1);
+
+			resetQueues(nextExtendQueue, 1);
+			resetQueues(QUEUE_SHADE, SHADE_QUEUE_COUNT);
+			resetQueues(QUEUE_SHADOW, 1);
+
+			glUseProgram(m_extendProgram.m_id);
+			glUniform1ui(glGetUniformLocation(m_extendProgram.m_id, "bounce"), bounce);
+			glDispatchComputeIndirect(sizeof(QueueCounter) * extendQueue);
+			glMemoryBarrier(STAGE_BARRIER);
+
+			// The last extension only looks for lights
+			if (bounce + 1 == maxDepth) break;
+
+			// Each lobe queue is shaded by its own dispatch so a workgroup never mixes BxDFs
+			glUseProgram(m_shadeProgram.m_id);
+			glUniform1ui(glGetUniformLocation(m_shadeProgram.m_id, "bounce"), bounce);
+			for (int lobe = 0; lobe < SHADE_QUEUE_COUNT; ++lobe)
+			{
+				glUniform1i(glGetUniformLocation(m_shadeProgram.m_id, "lobe"), lobe);
+				glDispatchComputeIndirect(sizeof(QueueCounter) * (QUEUE_SHADE + lobe));
+			}
+			glMemoryBarrier(STAGE_BARRIER);
+
+			glUseProgram(m_connectProgram.m_id);
+			glDispatchComputeIndirect(sizeof(QueueCounter) * QUEUE_SHADOW);
+			glMemoryBarrier(STAGE_BARRIER);
+
+			// Russian roulette leaves most bounces up to the maximum depth empty, every few bounces the CPU waits to see if any path is left
+			if ((bounce + 1) % liveCheckInterval == 0 && getQueueLength(nextExtendQueue) == 0) break;
+		}
+		glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+	}
+
+	// Accumulate
+	const AccumulationBuffer::Target& back = accumulation.getBack();
+	glBindImageTexture(ACCUMULATION_IMAGE, back.colorTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, accumulation.getInternalFormat());
+	glBindImageTexture(SAMPLE_COUNT_IMAGE, back.sampleCountTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32UI);
+	glBindImageTexture(MOMENT_IMAGE, back.momentTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+	glUseProgram(m_accumulateProgram.m_id);
+	glUniform1ui(glGetUniformLocation(m_accumulateProgram.m_id, "samplesPerPass"), samplesPerPass);
+	glDispatchCompute(pathGroups, 1, 1);
+
+	// The accumulation is sampled by the post pass next, and may be cleared, uploaded to or rendered to by the other backends
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+
+	glUseProgram(0);
+}
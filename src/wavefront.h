@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <error_handling.h>
+#include <gl/gl.h>
+#include <utils.h>
+
+#include <shaderprogram.h>
+#include <accumulationbuffer.h>
+#include <shaders/wavefront/wavefront_records.h>
+
+#include <vector>
+
+// Wavefront path tracer, each sample runs as a sequence of compute stages over queues of live paths
+// generate, then extend, shade per lobe and connect shadow rays for every bounce, then accumulate
+// The stages read the scene through the same textures and uniforms as the fragment path tracer
+class Wavefront
+{
+public:
+	ShaderProgram m_generateProgram;
+	ShaderProgram m_extendProgram;
+	ShaderProgram m_shadeProgram;
+	ShaderProgram m_connectProgram;
+	ShaderProgram m_accumulateProgram;
+
+private:
+	GLuint m_pathBuffer, m_hitBuffer, m_shadowRayBuffer, m_queueCounterBuffer, m_queueItemBuffer;
+
+	uint32_t m_pathCount;
+
+	// Bounces between reading back whether any path is still alive
+	static constexpr uint liveCheckInterval = 4;
+
+	void allocate(const glm::uvec2& resolution);
+	void resetQueues(int first, int count) const;
+	uint getQueueLength(int queue) const;
+
+public:
+	Wavefront(const glm::uvec2& resolution);
+	~Wavefront();
+
+	bool isCompiled() const;
+	std::vector<const ShaderProgram*> getPrograms() const;
+
+	void resize(const glm::uvec2& resolution);
+	// Traces [samplesPerPass] samples for every pixel that has not converged, [maxDepth] matches the stages' uniform
+	// Reads the front target of [accumulation] through the accumulation texture units and writes its back target
+	void trace(uint samplesPerPass, uint maxDepth, const AccumulationBuffer& accumulation);
+};